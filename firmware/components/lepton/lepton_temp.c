@@ -0,0 +1,106 @@
+/*
+ * Lepton temperature conversion
+ *
+ * Converts Lepton TLinear readings to C or F and formats them for display.  These
+ * functions do not access the Lepton so they build and can be tested on a host.
+ *
+ * Copyright 2020, 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "lepton_temp.h"
+
+
+
+//
+// Lepton Temperature API
+//
+
+/**
+ * Convert a temperature reading from the lepton (in units of K * 100) to C
+ */
+float lepton_kelvin_to_C(uint32_t k, float lep_res)
+{
+	return (((float) k) * lep_res) - 273.15;
+}
+
+
+/**
+ * Convert a TLinear reading from the lepton to C or F using only integer arithmetic
+ *   k is the reading in units of K * 100 (high_res) or K * 10
+ *   unit_C selects C instead of F
+ *   decimals is the number of decimal places (0 - 2) in the result
+ * Returns the temperature * 10^decimals rounded half away from zero
+ */
+int32_t lepton_kelvin_to_temp(uint32_t k, bool high_res, bool unit_C, int decimals)
+{
+	static const int32_t div[3] = {100, 10, 1};
+	int32_t t, d;
+	
+	if (decimals < 0) decimals = 0;
+	if (decimals > 2) decimals = 2;
+	
+	// C * 100
+	t = (int32_t) (high_res ? k : k * 10) - 27315;
+	d = div[decimals];
+	
+	if (!unit_C) {
+		// F * 500 so the result is only rounded once
+		t = t * 9 + 16000;
+		d = d * 5;
+	}
+	
+	return (t >= 0) ? (t + d/2) / d : -((d/2 - t) / d);
+}
+
+
+/**
+ * Format a temperature from lepton_kelvin_to_temp() without using sprintf
+ *   t is the temperature * 10^decimals
+ *   s must hold LEP_TEMP_STR_LEN characters
+ * Returns the string length
+ */
+int lepton_temp_to_str(int32_t t, int decimals, char* s)
+{
+	char buf[LEP_TEMP_STR_LEN];
+	char* bufP = buf + LEP_TEMP_STR_LEN;
+	char* sP = s;
+	uint32_t u;
+	int n = 0;
+	
+	if (t < 0) {
+		*sP++ = '-';
+		// Negated unsigned so INT32_MIN does not overflow
+		u = 0 - (uint32_t) t;
+	} else {
+		u = (uint32_t) t;
+	}
+	
+	// Digits are generated least significant first
+	do {
+		*--bufP = '0' + (u % 10);
+		u /= 10;
+		if (++n == decimals) *--bufP = '.';
+	} while ((u != 0) || (n <= decimals));
+	
+	while (bufP < (buf + LEP_TEMP_STR_LEN)) {
+		*sP++ = *bufP++;
+	}
+	*sP = 0;
+	
+	return sP - s;
+}
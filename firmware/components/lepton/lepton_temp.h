@@ -0,0 +1,48 @@
+/*
+ * Lepton temperature conversion
+ *
+ * Converts Lepton TLinear readings to C or F and formats them for display.  These
+ * functions do not access the Lepton so they build and can be tested on a host.
+ *
+ * Copyright 2020, 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LEPTON_TEMP_H
+#define LEPTON_TEMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Lepton Temperature Constants
+//
+
+// Temperature string buffer length for lepton_temp_to_str() (including terminator)
+#define LEP_TEMP_STR_LEN       13
+
+
+
+//
+// Lepton Temperature API
+//
+float lepton_kelvin_to_C(uint32_t k, float lep_res);
+int32_t lepton_kelvin_to_temp(uint32_t k, bool high_res, bool unit_C, int decimals);
+int lepton_temp_to_str(int32_t t, int decimals, char* s);
+
+#endif /* LEPTON_TEMP_H */
@@ -286,12 +286,3 @@ uint32_t lepton_get_tel_status(uint16_t* tel_buf)
 {
 	return (tel_buf[LEP_TEL_STATUS_HIGH] << 16) | tel_buf[LEP_TEL_STATUS_LOW];
 }
-
-
-/**
- * Convert a temperature reading from the lepton (in units of K * 100) to C
- */
-float lepton_kelvin_to_C(uint32_t k, float lep_res)
-{
-	return (((float) k) * lep_res) - 273.15;
-}
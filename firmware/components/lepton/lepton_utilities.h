@@ -162,8 +162,6 @@ void lepton_emissivity(uint16_t e);
 
 uint32_t lepton_get_tel_status(uint16_t* tel_buf);
 
-float lepton_kelvin_to_C(uint32_t k, float lep_res);
-
 #define lepton_get_lep_st()   (&lep_st)
 
 #endif /* LEPTON_UTILITIES_H */
\ No newline at end of file
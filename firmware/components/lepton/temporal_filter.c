@@ -0,0 +1,204 @@
+/*
+ * Lepton temporal noise filter
+ *
+ * Per-pixel recursive (IIR) filter run on each lepton frame before it is handed to
+ * the rest of the system.  Each output pixel is the previous output moved part of the
+ * way towards the new pixel.  The part depends on how far the pixel moved: pixels
+ * within the noise level are heavily filtered, pixels that change by more than twice
+ * the noise level are passed through so moving objects don't leave trails.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "temporal_filter.h"
+#include "vospi.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#ifdef TFILTER_STATS
+#include "sdkconfig.h"
+#include "soc/cpu.h"
+#endif
+
+
+
+//
+// Temporal Filter Variables
+//
+static const char* TAG = "tfilter";
+
+// Filtered image with tf_frac_bits of extra resolution so small steps towards the new
+// pixel aren't lost to rounding (internal RAM since it is read and written every pixel)
+static uint16_t* tf_histP = NULL;
+static bool tf_primed = false;
+static int tf_frac_bits;
+static int32_t tf_max_in;                        // Largest pixel that fits with the fraction bits
+
+// Weight (of 256) of the new pixel indexed by its difference from the filtered pixel
+// in lepton counts.  Pixels that differ by tf_pass_diff or more are passed through.
+static uint16_t tf_weight[2*TFILTER_MAX_NOISE];
+static uint32_t tf_pass_diff;
+
+#ifdef TFILTER_STATS
+static uint32_t tf_stat_frames;
+static uint32_t tf_stat_cycles;
+#endif
+
+
+
+//
+// Temporal Filter Forward Declarations for internal functions
+//
+static void tfilter_run(uint16_t* buf);
+
+
+
+//
+// Temporal Filter API
+//
+
+/**
+ * Allocate the filter history and compute the blend weights.  May be called again
+ * to change the parameters.
+ *   strength is the weight (of 256) of a new pixel within the noise level of the filtered
+ *     pixel.  Smaller values filter more (64 averages roughly the last 7 frames).
+ *   noise is the frame to frame pixel difference (lepton counts) considered noise.  The
+ *     weight ramps up to 256 between noise and 2 * noise.
+ *   frac_bits is the number of extra bits of resolution kept in the history.  Pixels
+ *     are limited to 16 - frac_bits bits (e.g. 8 for 8-bit AGC data, 0 for radiometric).
+ * Returns false if the history could not be allocated.
+ */
+bool tfilter_init(uint16_t strength, uint16_t noise, int frac_bits)
+{
+	uint32_t d;
+	
+	if (tf_histP == NULL) {
+		tf_histP = (uint16_t*) heap_caps_malloc(LEP_NUM_PIXELS*sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+		if (tf_histP == NULL) {
+			ESP_LOGE(TAG, "failed to allocate filter history");
+			return false;
+		}
+	}
+	
+	if (strength < 1) strength = 1;
+	if (strength > 256) strength = 256;
+	if (noise < 1) noise = 1;
+	if (noise > TFILTER_MAX_NOISE) noise = TFILTER_MAX_NOISE;
+	if (frac_bits < 0) frac_bits = 0;
+	if (frac_bits > 8) frac_bits = 8;
+	
+	tf_frac_bits = frac_bits;
+	tf_max_in = 0xFFFF >> frac_bits;
+	tf_pass_diff = 2 * noise;
+	for (d=0; d<tf_pass_diff; d++) {
+		if (d <= noise) {
+			tf_weight[d] = strength;
+		} else {
+			tf_weight[d] = strength + ((d - noise) * (256 - strength)) / noise;
+		}
+	}
+	
+	tf_primed = false;
+	
+	return true;
+}
+
+
+/**
+ * Start over with the next frame (e.g. after the lepton has been reset)
+ */
+void tfilter_reset()
+{
+	tf_primed = false;
+}
+
+
+/**
+ * Filter a lepton frame in place.  The first frame after tfilter_init() or
+ * tfilter_reset() is passed through and starts the history.
+ *   buf points to LEP_NUM_PIXELS pixels
+ */
+void tfilter_frame(uint16_t* buf)
+{
+#ifdef TFILTER_STATS
+	uint32_t t;
+#endif
+	
+	if (tf_histP == NULL) return;
+	
+#ifdef TFILTER_STATS
+	t = esp_cpu_get_ccount();
+#endif
+	tfilter_run(buf);
+#ifdef TFILTER_STATS
+	tf_stat_cycles += esp_cpu_get_ccount() - t;
+	if (++tf_stat_frames == TFILTER_STATS_FRAMES) {
+		ESP_LOGI(TAG, "Filter: %u cycles (%u uS)", tf_stat_cycles / tf_stat_frames,
+		         tf_stat_cycles / tf_stat_frames / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+		tf_stat_frames = 0;
+		tf_stat_cycles = 0;
+	}
+#endif
+}
+
+
+
+//
+// Temporal Filter internal functions
+//
+
+/**
+ * Blend a frame into the history and replace it with the rounded result
+ */
+static void tfilter_run(uint16_t* buf)
+{
+	uint16_t* hP = tf_histP;
+	const uint16_t* bufEndP = buf + LEP_NUM_PIXELS;
+	const int fb = tf_frac_bits;
+	const int32_t half = (1 << fb) >> 1;
+	int32_t d, h, x;
+	uint32_t ad;
+	
+	if (!tf_primed) {
+		while (buf < bufEndP) {
+			x = *buf++;
+			if (x > tf_max_in) x = tf_max_in;
+			*hP++ = x << fb;
+		}
+		tf_primed = true;
+		return;
+	}
+	
+	while (buf < bufEndP) {
+		x = *buf;
+		if (x > tf_max_in) x = tf_max_in;
+		x <<= fb;
+		h = *hP;
+		d = x - h;
+		ad = ((d < 0) ? -d : d) >> fb;
+		if (ad >= tf_pass_diff) {
+			// Motion
+			h = x;
+		} else {
+			// Rounded step of weight/256 of the difference (arithmetic shift for negative steps)
+			h += (d * tf_weight[ad] + 128) >> 8;
+		}
+		*hP++ = h;
+		*buf++ = (h + half) >> fb;
+	}
+}
+
@@ -0,0 +1,55 @@
+/*
+ * Lepton temporal noise filter
+ *
+ * Per-pixel recursive (IIR) filter run on each lepton frame before it is handed to
+ * the rest of the system.  Each output pixel is the previous output moved part of the
+ * way towards the new pixel.  The part depends on how far the pixel moved: pixels
+ * within the noise level are heavily filtered, pixels that change by more than twice
+ * the noise level are passed through so moving objects don't leave trails.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TEMPORAL_FILTER_H
+#define TEMPORAL_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Temporal Filter Constants
+//
+
+// Largest noise level (lepton counts) supported
+#define TFILTER_MAX_NOISE 255
+
+// Uncomment to log the average time to filter a frame every TFILTER_STATS_FRAMES frames
+//#define TFILTER_STATS
+#define TFILTER_STATS_FRAMES 100
+
+
+
+//
+// Temporal Filter API
+//
+bool tfilter_init(uint16_t strength, uint16_t noise, int frac_bits);
+void tfilter_reset();
+void tfilter_frame(uint16_t* buf);
+
+#endif /* TEMPORAL_FILTER_H */
@@ -36,6 +36,27 @@
 #include "driver/spi_master.h"
 #include "system_config.h"
 #include "vospi.h"
+#include "temporal_filter.h"
+
+
+
+//
+// VoSPI Typedefs
+//
+
+// Statistics of one segment's image pixels, accumulated as its packets are copied
+typedef struct {
+	uint64_t pkts;               // Mask of the packet lines included
+	bool rescan;                 // A packet was included twice so compute from the image
+	uint16_t min_val;
+	uint16_t max_val;
+	int min_i;                   // Pixel offsets in the frame
+	int max_i;
+	uint32_t sum;
+	uint32_t below;              // Pixels outside the histogram bins
+	uint32_t above;
+	uint16_t hist[LEP_HIST_BINS];
+} seg_stats_t;
 
 
 
@@ -53,8 +74,25 @@ static spi_transaction_t lep_spi_trans;
 // Pointer to allocated array to store one Lepton packet (DMA capable)
 static uint8_t* lepPacketP;
 
-// Lepton Frame buffer (16-bit values)
-static uint16_t lepBuffer[LEP_NUM_PIXELS];
+// Packet being parsed (in lepPacketP or the segment buffer)
+static uint8_t* curPacketP;
+
+#ifdef VOSPI_SEGMENT_READ
+// Segment read transaction and its allocated buffer for a whole segment's packets
+// (DMA capable), with the next unparsed packet in it
+static spi_transaction_t lep_seg_trans;
+static uint8_t* lepSegmentP;
+static uint8_t* segPktP;
+static int segPktsLeft = 0;
+#endif
+
+// Pointer to allocated Lepton Frame buffer being acquired (16-bit values).  It is
+// exchanged with a system buffer's image by vospi_get_frame() so is allocated like
+// them in the external RAM.
+static uint16_t* lepBufferP;
+
+// Per-segment image statistics (min/max, sum and histogram)
+static seg_stats_t segStats[4];
 
 // Lepton Telemetry buffer (16-bit values)
 static uint16_t lepTelem[LEP_TEL_WORDS];
@@ -65,6 +103,26 @@ static int curLinesPerSeg = LEP_NOTEL_PKTS_PER_SEG;
 static int curWordsPerSeg = LEP_NOTEL_WORDS_PER_SEG;
 static bool validSegmentRegion = false;
 static bool includeTelemetry = false;
+static bool includeHistogram = false;
+static bool includeFilter = false;
+
+// VSYNC times of the current frame's first and last segments
+static int64_t frameVsync1Usec;
+static int64_t frameVsync4Usec;
+
+// Histogram binning, set from the previous frame's range
+static uint16_t histMinVal = 0;
+static uint16_t histRange = 0xFFFF;
+static uint32_t histScale = (LEP_HIST_BINS << 16) / 0x10000;
+
+#ifdef VOSPI_STATS
+// Segment timing accumulated over VOSPI_STATS_SEGMENTS segments
+static uint32_t statSegments;
+static uint32_t statSegmentUsec;     // In vospi_transfer_segment()
+static uint32_t statBlockedUsec;     // Blocked waiting for segment reads (CPU free)
+static uint32_t statPolledPkts;      // Packets read one at a time
+static int32_t statMaxUsec;          // Longest from VSYNC to the end of vospi_transfer_segment()
+#endif
 
 
 
@@ -73,8 +131,19 @@ static bool includeTelemetry = false;
 // VoSPI Forward Declarations for internal functions
 //
 static bool transfer_packet(uint8_t* line, uint8_t* seg);
+static void poll_packet();
+#ifdef VOSPI_SEGMENT_READ
+static void read_segment();
+#endif
+#ifdef VOSPI_STATS
+static void update_stats(int64_t startUsec, uint64_t vsyncDetectedUsec);
+#endif
 static void copy_packet_to_lepton_buffer(uint8_t line);
 static void copy_packet_to_telem_buffer(uint8_t line);
+static void seg_stats_clear(int seg);
+static void seg_stats_scan(int seg);
+static int seg_num_pixels(int seg);
+static void set_hist_binning(uint16_t* hist, uint16_t min, uint16_t max, uint32_t below, uint32_t above);
 
 
 
@@ -111,13 +180,31 @@ int vospi_init(int csn_pin)
 			ESP_LOGE(TAG, "failed to allocate lepton DMA packet buffer");
 			ret = ESP_FAIL;
 		}
+		lepBufferP = (uint16_t*) heap_caps_calloc(LEP_NUM_PIXELS, sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+		if (lepBufferP == NULL) {
+			ESP_LOGE(TAG, "failed to allocate lepton frame buffer");
+			ret = ESP_FAIL;
+		}
+#ifdef VOSPI_SEGMENT_READ
+		// Large enough for a segment with telemetry
+		lepSegmentP = (uint8_t*) heap_caps_malloc(LEP_TEL_PKTS_PER_SEG*LEP_PKT_LENGTH, MALLOC_CAP_DMA);
+		if (lepSegmentP == NULL) {
+			ESP_LOGE(TAG, "failed to allocate lepton DMA segment buffer");
+			ret = ESP_FAIL;
+		}
+#endif
 	}
 	
-	// Setup our SPI transaction
+	// Setup our SPI transactions
 	memset(&lep_spi_trans, 0, sizeof(spi_transaction_t));
 	lep_spi_trans.tx_buffer = NULL;
 	lep_spi_trans.rx_buffer = lepPacketP;
 	lep_spi_trans.rxlength = LEP_PKT_LENGTH*8;
+#ifdef VOSPI_SEGMENT_READ
+	memset(&lep_seg_trans, 0, sizeof(spi_transaction_t));
+	lep_seg_trans.tx_buffer = NULL;
+	lep_seg_trans.rx_buffer = lepSegmentP;
+#endif
 
 	return ret;
 }
@@ -125,7 +212,9 @@ int vospi_init(int csn_pin)
 
 /**
  * Attempt to read a complete segment from the Lepton
- *  - Data loaded into lepBuffer
+ *  - Data loaded into lepBufferP with the image statistics accumulated per segment
+ *  - With VOSPI_SEGMENT_READ the segment's packets are read at once and then parsed
+ *    from memory, followed by packets read one at a time if the segment isn't done
  *  - Returns true when last successful segment read, false otherwise
  */
 bool vospi_transfer_segment(uint64_t vsyncDetectedUsec)
@@ -135,9 +224,16 @@ bool vospi_transfer_segment(uint64_t vsyncDetectedUsec)
 	bool done = false;
 	bool beforeValidData = true;
 	bool success = false;
+#ifdef VOSPI_STATS
+	int64_t startUsec = esp_timer_get_time();
+#endif
 
 	prevLine = 255;
 
+#ifdef VOSPI_SEGMENT_READ
+	read_segment();
+#endif
+
 	while (!done) {
 		if (transfer_packet(&line, &segment)) {
 			// Saw a valid packet
@@ -176,10 +272,14 @@ bool vospi_transfer_segment(uint64_t vsyncDetectedUsec)
 					if (validSegmentRegion) {
 						if (curSegment < 4) {
 							// Setup to get next segment
+							if (curSegment == 1) {
+								frameVsync1Usec = vsyncDetectedUsec;
+							}
 							curSegment++;
 						} else {
 							// Got frame
 							success = true;
+							frameVsync4Usec = vsyncDetectedUsec;
 
 							// Setup to get the next frame
 							curSegment = 1;
@@ -195,6 +295,13 @@ bool vospi_transfer_segment(uint64_t vsyncDetectedUsec)
       		done = true;
     	}
 	}
+#ifdef VOSPI_SEGMENT_READ
+	// Drop anything left from the segment read
+	segPktsLeft = 0;
+#endif
+#ifdef VOSPI_STATS
+	update_stats(startUsec, vsyncDetectedUsec);
+#endif
 	
   	return success;
 }
@@ -202,37 +309,90 @@ bool vospi_transfer_segment(uint64_t vsyncDetectedUsec)
 
 /**
  * Load the a system buffer from our buffers for another task
+ *  - Optionally runs the temporal noise filter on the image first so the min/max
+ *    values and histogram are of the filtered image.
+ *  - The min/max values, mean and optional histogram are combined from the statistics
+ *    accumulated while the segments were copied.  The histogram bins are set from the
+ *    previous frame (see set_hist_binning()) so they are known during acquisition.
+ *    Pixels outside them are counted in the end bins.  Segments whose statistics don't
+ *    match the image (filtered, or packets missed or read twice) are scanned instead.
+ *  - The image is handed over by exchanging it with the system buffer's (which becomes
+ *    the next acquisition buffer) instead of being copied.  The caller must own the
+ *    system buffer (no other task may be using it).
  */
 void vospi_get_frame(lep_buffer_t* sys_bufP)
 {
-	uint16_t* sptr = sys_bufP->lep_bufferP;
-	uint16_t* lptr = &lepBuffer[0];
+	seg_stats_t* s;
+	uint16_t* sptr;
+	uint16_t* lptr;
+	uint16_t* hist = sys_bufP->lep_hist;
 	uint16_t min = 0xFFFF;
-	uint16_t* min_lepP = lptr;
+	int min_i = 0;
 	uint16_t max = 0x0000;
-	uint16_t* max_lepP = lptr;
-	uint16_t t16;
-
-	// Load lepton image data
-	while (lptr < &lepBuffer[LEP_NUM_PIXELS]) {
-		t16 = *lptr;
-		if (t16 < min) {
-			min = t16;
-			min_lepP = lptr;
+	int max_i = 0;
+	uint32_t sum = 0;
+	uint32_t below = 0;
+	uint32_t above = 0;
+	int i, seg;
+
+	if (includeFilter) {
+		tfilter_frame(lepBufferP);
+	}
+
+	if (includeHistogram) {
+		memset(hist, 0, LEP_HIST_BINS*sizeof(uint16_t));
+	}
+
+	// Combine the segment statistics (in image order so the first of equal min or
+	// max pixels is used)
+	for (seg=0; seg<4; seg++) {
+		s = &segStats[seg];
+		if (includeFilter || s->rescan || (s->pkts != ((uint64_t) 1 << (seg_num_pixels(seg) / (LEP_WIDTH/2))) - 1)) {
+			seg_stats_scan(seg);
+		}
+		if (s->min_val < min) {
+			min = s->min_val;
+			min_i = s->min_i;
 		}
-		if (t16 > max) {
-			max = t16;
-			max_lepP = lptr;
+		if (s->max_val > max) {
+			max = s->max_val;
+			max_i = s->max_i;
 		}
-		lptr++;
-		*sptr++ = t16;
+		sum += s->sum;
+		if (includeHistogram) {
+			for (i=0; i<LEP_HIST_BINS; i++) {
+				hist[i] += s->hist[i];
+			}
+			below += s->below;
+			above += s->above;
+		}
+
+		// The next frame's packets go into a different buffer
+		s->pkts = 0;
 	}
 	sys_bufP->lep_min_val = min;
-	sys_bufP->lep_min_x = (min_lepP - &lepBuffer[0]) % LEP_WIDTH;
-	sys_bufP->lep_min_y = (min_lepP - &lepBuffer[0]) / LEP_WIDTH;
+	sys_bufP->lep_min_x = min_i % LEP_WIDTH;
+	sys_bufP->lep_min_y = min_i / LEP_WIDTH;
 	sys_bufP->lep_max_val = max;
-	sys_bufP->lep_max_x = (max_lepP - &lepBuffer[0]) % LEP_WIDTH;
-	sys_bufP->lep_max_y = (max_lepP - &lepBuffer[0]) / LEP_WIDTH;
+	sys_bufP->lep_max_x = max_i % LEP_WIDTH;
+	sys_bufP->lep_max_y = max_i / LEP_WIDTH;
+	sys_bufP->lep_mean_val = (sum + LEP_NUM_PIXELS/2) / LEP_NUM_PIXELS;
+	sys_bufP->lep_stamps.vsync1_usec = frameVsync1Usec;
+	sys_bufP->lep_stamps.vsync4_usec = frameVsync4Usec;
+
+	// Hand over the image
+	lptr = sys_bufP->lep_bufferP;
+	sys_bufP->lep_bufferP = lepBufferP;
+	lepBufferP = lptr;
+	
+	// Optionally note the histogram binning and setup the next frame's from this one
+	sys_bufP->hist_valid = includeHistogram;
+	if (includeHistogram) {
+		sys_bufP->lep_hist_min_val = histMinVal;
+		sys_bufP->lep_hist_range = histRange;
+		sys_bufP->lep_hist_scale = histScale;
+		set_hist_binning(hist, min, max, below, above);
+	}
 	
 	// Optionally load telemetry
 	sys_bufP->telem_valid = includeTelemetry;
@@ -258,6 +418,28 @@ void vospi_include_telem(bool en)
 }
 
 
+/**
+ * Configure the pipeline to build an image histogram for each frame or not.
+ */
+void vospi_include_hist(bool en)
+{
+	includeHistogram = en;
+}
+
+
+/**
+ * Configure the pipeline to run the temporal noise filter on each frame or not.
+ * The filter must have been setup with tfilter_init().
+ */
+void vospi_include_filter(bool en)
+{
+	if (en && !includeFilter) {
+		tfilter_reset();
+	}
+	includeFilter = en;
+}
+
+
 
 //
 // VoSPI Forward Declarations for internal functions
@@ -273,25 +455,33 @@ void vospi_include_telem(bool en)
 static bool transfer_packet(uint8_t* line, uint8_t* seg)
 {
 	bool valid = false;
-	esp_err_t ret;
 
 	// *seg will be set if possible
 	*seg = 0;
 
 	// Get a packet
-	ret = spi_device_polling_transmit(spi, &lep_spi_trans);
-	//ret = spi_device_transmit(spi, &lep_spi_trans);
-	ESP_ERROR_CHECK(ret);
+#ifdef VOSPI_SEGMENT_READ
+	if (segPktsLeft > 0) {
+		// Next packet from the segment read
+		curPacketP = segPktP;
+		segPktP += LEP_PKT_LENGTH;
+		segPktsLeft--;
+	} else {
+		poll_packet();
+	}
+#else
+	poll_packet();
+#endif
   
 	// Repeat as long as the frame is not valid, equals sync
-	if ((*lepPacketP & 0x0F) == 0x0F) {
+	if ((*curPacketP & 0x0F) == 0x0F) {
 		valid = false;
 	} else {
-		*line = *(lepPacketP + 1);
+		*line = *(curPacketP + 1);
 
 		// Get segment when possible
 		if (*line == 20) {
-			*seg = (*lepPacketP >> 4);
+			*seg = (*curPacketP >> 4);
 		}
 
 		valid = true;
@@ -302,40 +492,250 @@ static bool transfer_packet(uint8_t* line, uint8_t* seg)
 
 
 /**
- * Copy the lepton packet to the raw lepton frame
+ * Read one packet from the lepton into lepPacketP
+ */
+static void poll_packet()
+{
+	esp_err_t ret;
+
+	ret = spi_device_polling_transmit(spi, &lep_spi_trans);
+	ESP_ERROR_CHECK(ret);
+	curPacketP = lepPacketP;
+#ifdef VOSPI_STATS
+	statPolledPkts++;
+#endif
+}
+
+
+#ifdef VOSPI_SEGMENT_READ
+/**
+ * Read a segment's worth of packets from the lepton into lepSegmentP.  The task
+ * blocks while the transfer runs.
+ */
+static void read_segment()
+{
+	esp_err_t ret;
+#ifdef VOSPI_STATS
+	int64_t t = esp_timer_get_time();
+#endif
+
+	lep_seg_trans.rxlength = curLinesPerSeg*LEP_PKT_LENGTH*8;
+	ret = spi_device_transmit(spi, &lep_seg_trans);
+	ESP_ERROR_CHECK(ret);
+	segPktP = lepSegmentP;
+	segPktsLeft = curLinesPerSeg;
+#ifdef VOSPI_STATS
+	statBlockedUsec += (uint32_t) (esp_timer_get_time() - t);
+#endif
+}
+#endif
+
+
+/**
+ * Add a pixel to a segment's statistics
+ *   i is the pixel's offset in the frame
+ */
+static inline void seg_stats_pixel(seg_stats_t* s, uint16_t v, int i)
+{
+	uint32_t d;
+
+	if (v < s->min_val) {
+		s->min_val = v;
+		s->min_i = i;
+	}
+	if (v > s->max_val) {
+		s->max_val = v;
+		s->max_i = i;
+	}
+	s->sum += v;
+	if (includeHistogram) {
+		if (v < histMinVal) {
+			d = 0;
+			s->below++;
+		} else if ((d = v - histMinVal) > histRange) {
+			d = histRange;
+			s->above++;
+		}
+		s->hist[(d * histScale) >> 16]++;
+	}
+}
+
+
+/**
+ * Copy the current lepton packet to the raw lepton frame and add it to the segment's
+ * statistics.  The packet's big-endian pixels are swapped two at a time with word
+ * loads and stores (the packet data and image lines are word aligned).
  *   - line specifies packet line number
  */
 static void copy_packet_to_lepton_buffer(uint8_t line)
 {
-	uint8_t* lepPopPtr = lepPacketP + 4;
-	uint16_t* acqPushPtr = &lepBuffer[((curSegment-1) * curWordsPerSeg) + (line * (LEP_WIDTH/2))];
-	uint16_t t;
+	seg_stats_t* s = &segStats[curSegment-1];
+	int i = ((curSegment-1) * curWordsPerSeg) + (line * (LEP_WIDTH/2));
+	const int iEnd = i + (LEP_WIDTH/2);
+	uint32_t* lepPopPtr = (uint32_t*) (curPacketP + 4);
+	uint32_t* acqPushPtr = (uint32_t*) &lepBufferP[i];
+	uint64_t lineMask = (uint64_t) 1 << line;
+	uint32_t t;
+
+	// The first packet starts the segment's statistics over.  A packet already
+	// included (the segment was restarted part way) means they no longer match.
+	if (line == 0) {
+		seg_stats_clear(curSegment-1);
+	} else if ((s->pkts & lineMask) != 0) {
+		s->rescan = true;
+	}
+	s->pkts |= lineMask;
 
-	while (lepPopPtr <= (lepPacketP + (LEP_PKT_LENGTH-1))) {
-		t = *lepPopPtr++ << 8;
-		t |= *lepPopPtr++;
+	while (i < iEnd) {
+		t = *lepPopPtr++;
+		t = ((t & 0x00FF00FF) << 8) | ((t >> 8) & 0x00FF00FF);
 		*acqPushPtr++ = t;
+		seg_stats_pixel(s, t & 0xFFFF, i++);
+		seg_stats_pixel(s, t >> 16, i++);
 	}
 }
 
 
 /**
- * Copy the lepton packet to the telemetry buffer
+ * Copy the current lepton packet to the telemetry buffer
  *   - line specifies packet line number (only 0-2 are valid, do not call with line 3)
  */
 static void copy_packet_to_telem_buffer(uint8_t line)
 {
-	uint8_t* lepPopPtr = lepPacketP + 4;
-	uint16_t* telPushPtr = &lepTelem[line * (LEP_WIDTH/2)];
-	uint16_t t;
+	uint32_t* lepPopPtr = (uint32_t*) (curPacketP + 4);
+	uint32_t* telPushPtr = (uint32_t*) &lepTelem[line * (LEP_WIDTH/2)];
+	uint32_t t;
+	int i;
 	
 	if (line > 2) return;
 	
-	while (lepPopPtr <= (lepPacketP + (LEP_PKT_LENGTH-1))) {
-		t = *lepPopPtr++ << 8;
-		t |= *lepPopPtr++;
-		*telPushPtr++ = t;
+	for (i=0; i<(LEP_WIDTH/4); i++) {
+		t = *lepPopPtr++;
+		*telPushPtr++ = ((t & 0x00FF00FF) << 8) | ((t >> 8) & 0x00FF00FF);
+	}
+}
+
+
+/**
+ * Reset a segment's statistics
+ *   seg is the segment index (0-3)
+ */
+static void seg_stats_clear(int seg)
+{
+	seg_stats_t* s = &segStats[seg];
+
+	s->pkts = 0;
+	s->rescan = false;
+	s->min_val = 0xFFFF;
+	s->max_val = 0x0000;
+	s->min_i = seg * curWordsPerSeg;
+	s->max_i = seg * curWordsPerSeg;
+	s->sum = 0;
+	s->below = 0;
+	s->above = 0;
+	memset(s->hist, 0, LEP_HIST_BINS*sizeof(uint16_t));
+}
+
+
+/**
+ * Compute a segment's statistics from the image
+ *   seg is the segment index (0-3)
+ */
+static void seg_stats_scan(int seg)
+{
+	seg_stats_t* s = &segStats[seg];
+	int i = seg * curWordsPerSeg;
+	const int iEnd = i + seg_num_pixels(seg);
+
+	seg_stats_clear(seg);
+	while (i < iEnd) {
+		seg_stats_pixel(s, lepBufferP[i], i);
+		i++;
+	}
+}
+
+
+/**
+ * Return the number of image pixels in a segment (the last segment is short when
+ * it contains the telemetry packets)
+ *   seg is the segment index (0-3)
+ */
+static int seg_num_pixels(int seg)
+{
+	return (seg < 3) ? curWordsPerSeg : LEP_NUM_PIXELS - 3*curWordsPerSeg;
+}
+
+
+/**
+ * Setup the histogram bins for the next frame to span this frame's range without
+ * the SYS_HEQ_CLIP_LIMIT outliers at each end so a few hot or cold pixels don't
+ * squeeze the rest of the image into a few bins.  The range grows to the image
+ * min or max when more than twice that many pixels fell outside the current bins
+ * (the margin keeps outliers from making the range alternate between frames).
+ *   below and above are the counts of pixels outside the current bins
+ */
+static void set_hist_binning(uint16_t* hist, uint16_t min, uint16_t max, uint32_t below, uint32_t above)
+{
+	uint32_t cum;
+	uint32_t t32;
+	int i;
+	
+	if (below <= 2*SYS_HEQ_CLIP_LIMIT) {
+		cum = 0;
+		for (i=0; i<LEP_HIST_BINS-1; i++) {
+			cum += hist[i];
+			if (cum > SYS_HEQ_CLIP_LIMIT) break;
+		}
+		
+		// First value in bin i
+		t32 = histMinVal + (((uint32_t) i << 16) + histScale - 1) / histScale;
+		if (t32 > min) min = t32;
 	}
+	
+	if (above <= 2*SYS_HEQ_CLIP_LIMIT) {
+		cum = 0;
+		for (i=LEP_HIST_BINS-1; i>0; i--) {
+			cum += hist[i];
+			if (cum > SYS_HEQ_CLIP_LIMIT) break;
+		}
+		
+		// Last value in bin i
+		t32 = histMinVal + (((uint32_t) (i+1) << 16) + histScale - 1) / histScale - 1;
+		if (t32 < max) max = t32;
+	}
+	if (max < min) max = min;
+	
+	histMinVal = min;
+	histRange = max - min;
+	histScale = (LEP_HIST_BINS << 16) / ((uint32_t) histRange + 1);
 }
 
 
+#ifdef VOSPI_STATS
+/**
+ * Accumulate the time for a segment and log the averages every VOSPI_STATS_SEGMENTS
+ * segments.  CPU time excludes the time blocked in segment reads.  The margin is
+ * how much sooner than LEP_MAX_FRAME_XFER_WAIT_USEC after VSYNC the slowest segment
+ * finished.
+ */
+static void update_stats(int64_t startUsec, uint64_t vsyncDetectedUsec)
+{
+	int64_t t = esp_timer_get_time();
+
+	statSegmentUsec += (uint32_t) (t - startUsec);
+	if ((int32_t) (t - vsyncDetectedUsec) > statMaxUsec) {
+		statMaxUsec = (int32_t) (t - vsyncDetectedUsec);
+	}
+
+	if (++statSegments == VOSPI_STATS_SEGMENTS) {
+		ESP_LOGI(TAG, "Segment: %u uS (CPU %u uS), %u packets polled, max %d uS after VSYNC (margin %d uS)",
+		         statSegmentUsec / statSegments, (statSegmentUsec - statBlockedUsec) / statSegments,
+		         statPolledPkts / statSegments, statMaxUsec, LEP_MAX_FRAME_XFER_WAIT_USEC - statMaxUsec);
+		statSegments = 0;
+		statSegmentUsec = 0;
+		statBlockedUsec = 0;
+		statPolledPkts = 0;
+		statMaxUsec = 0;
+	}
+}
+#endif
@@ -59,6 +59,24 @@
 #define LEP_TEL_WORDS_PER_SEG    (LEP_TEL_PKTS_PER_SEG * LEP_WIDTH / 2)
 #define LEP_NOTEL_WORDS_PER_SEG  (LEP_NOTEL_PKTS_PER_SEG * LEP_WIDTH / 2)
 
+// Uncomment to read each segment's packets with one DMA transaction into a segment
+// buffer (the task blocks while the SPI peripheral runs) and parse them afterwards
+// instead of one polled transaction per packet.  Packets the segment read didn't get
+// (e.g. it started with discard packets) are still read one at a time.
+//#define VOSPI_SEGMENT_READ
+
+// Largest SPI transaction, used to setup the SPI bus
+#ifdef VOSPI_SEGMENT_READ
+#define VOSPI_MAX_TRANSFER_SZ (LEP_TEL_PKTS_PER_SEG * LEP_PKT_LENGTH)
+#else
+#define VOSPI_MAX_TRANSFER_SZ LEP_PKT_LENGTH
+#endif
+
+// Uncomment to log the average segment transfer and parse times and the worst case
+// margin against LEP_MAX_FRAME_XFER_WAIT_USEC every VOSPI_STATS_SEGMENTS segments
+//#define VOSPI_STATS
+#define VOSPI_STATS_SEGMENTS 400
+
 /* Lepton frame error return */
 enum LeptonReadError {
   NONE, DISCARD, SEGMENT_ERROR, ROW_ERROR, SEGMENT_INVALID
@@ -73,5 +91,7 @@ int vospi_init(int csn_pin);
 bool vospi_transfer_segment(uint64_t vsyncDetectedUsec);
 void vospi_get_frame(lep_buffer_t* sys_bufP);
 void vospi_include_telem(bool en);
+void vospi_include_hist(bool en);
+void vospi_include_filter(bool en);
 
 #endif /* VOSPI_H */
@@ -0,0 +1,199 @@
+/*
+ * Lepton VSYNC timing
+ *
+ * Keeps the timestamps of the most recent Lepton VSYNC edges (recorded by the VSYNC
+ * interrupt handler) and the delay until the task reading segments ran, and computes
+ * period and jitter statistics from them.  Timestamps are passed in so the logic does
+ * not depend on the hardware and can be driven by a simulated VSYNC source.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "vsync_timing.h"
+
+
+
+//
+// VSYNC Timing Variables
+//
+
+// Edge timestamp ring written by the interrupt handler.  vsync_edges is the total
+// count so the newest timestamp is at (vsync_edges - 1) % VSYNC_TS_LEN.
+static volatile int64_t vsync_ts[VSYNC_TS_LEN];
+static volatile uint32_t vsync_edges;
+
+// Task wake delay accumulated since the last vsync_timing_get_stats()
+static uint32_t vsync_wakes;
+static int64_t vsync_wake_sum;
+static int32_t vsync_wake_max;
+static uint32_t vsync_late;
+
+
+
+//
+// VSYNC Timing Forward Declarations for internal functions
+//
+static uint32_t isqrt(uint64_t v);
+
+
+
+//
+// VSYNC Timing API
+//
+
+/**
+ * Clear the edge history and statistics
+ */
+void vsync_timing_reset()
+{
+	vsync_edges = 0;
+	vsync_wakes = 0;
+	vsync_wake_sum = 0;
+	vsync_wake_max = 0;
+	vsync_late = 0;
+}
+
+
+/**
+ * Record a VSYNC edge.  Called from the VSYNC interrupt handler.
+ *   t_usec is the time of the edge
+ */
+void IRAM_ATTR vsync_timing_edge(int64_t t_usec)
+{
+	vsync_ts[vsync_edges & (VSYNC_TS_LEN-1)] = t_usec;
+	vsync_edges++;
+}
+
+
+/**
+ * Return the time of the most recent edge (0 if none)
+ */
+int64_t vsync_timing_last_edge()
+{
+	uint32_t n = vsync_edges;
+	
+	return (n == 0) ? 0 : vsync_ts[(n - 1) & (VSYNC_TS_LEN-1)];
+}
+
+
+/**
+ * Note that the task woke for an edge.
+ *   edge_usec is the time of the edge
+ *   now_usec is the time the task ran
+ * Returns true if the edge is recent enough to start a segment read
+ */
+bool vsync_timing_wake(int64_t edge_usec, int64_t now_usec)
+{
+	int32_t d = (int32_t) (now_usec - edge_usec);
+	
+	vsync_wakes++;
+	vsync_wake_sum += d;
+	if (d > vsync_wake_max) vsync_wake_max = d;
+	
+	if (d > VSYNC_MAX_WAKE_USEC) {
+		vsync_late++;
+		return false;
+	}
+	return true;
+}
+
+
+/**
+ * Compute the period statistics from the edges in the ring and the wake statistics
+ * since the last call (which are then cleared).
+ *   nominal_usec is the expected VSYNC period used to detect missed edges
+ *   stats is filled in
+ */
+void vsync_timing_get_stats(int32_t nominal_usec, vsync_stats_t* stats)
+{
+	uint32_t n = vsync_edges;
+	uint32_t i, first;
+	int64_t sum = 0;
+	int64_t sum_sq = 0;
+	int64_t var;
+	int32_t p, d;
+	
+	stats->edges = n;
+	stats->num_periods = 0;
+	stats->period_avg_usec = 0;
+	stats->period_min_usec = 0;
+	stats->period_max_usec = 0;
+	stats->jitter_usec = 0;
+	stats->missed = 0;
+	
+	// Periods between the edges still in the ring in one pass since the interrupt
+	// handler may add edges.  Sums are of the difference from nominal to keep them small.
+	first = (n > VSYNC_TS_LEN) ? n - VSYNC_TS_LEN : 0;
+	for (i=first+1; i<n; i++) {
+		p = (int32_t) (vsync_ts[i & (VSYNC_TS_LEN-1)] - vsync_ts[(i-1) & (VSYNC_TS_LEN-1)]);
+		if (p > (nominal_usec + nominal_usec/2)) {
+			// Lost edges don't count towards the jitter
+			stats->missed++;
+			continue;
+		}
+		if ((stats->num_periods == 0) || (p < stats->period_min_usec)) stats->period_min_usec = p;
+		if ((stats->num_periods == 0) || (p > stats->period_max_usec)) stats->period_max_usec = p;
+		d = p - nominal_usec;
+		sum += d;
+		sum_sq += (int64_t) d * d;
+		stats->num_periods++;
+	}
+	
+	if (stats->num_periods != 0) {
+		stats->period_avg_usec = nominal_usec + (int32_t) (sum / stats->num_periods);
+		var = (sum_sq - (sum * sum) / stats->num_periods) / stats->num_periods;
+		stats->jitter_usec = (var > 0) ? isqrt((uint64_t) var) : 0;
+	}
+	
+	stats->wakes = vsync_wakes;
+	stats->wake_avg_usec = (vsync_wakes == 0) ? 0 : (int32_t) (vsync_wake_sum / vsync_wakes);
+	stats->wake_max_usec = vsync_wake_max;
+	stats->late = vsync_late;
+	vsync_wakes = 0;
+	vsync_wake_sum = 0;
+	vsync_wake_max = 0;
+	vsync_late = 0;
+}
+
+
+
+//
+// VSYNC Timing internal functions
+//
+
+/**
+ * Integer square root (largest r with r * r <= v)
+ */
+static uint32_t isqrt(uint64_t v)
+{
+	uint64_t r = 0;
+	uint64_t b = (uint64_t) 1 << 62;
+	
+	while (b > v) b >>= 2;
+	while (b != 0) {
+		if (v >= r + b) {
+			v -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+	
+	return (uint32_t) r;
+}
@@ -0,0 +1,76 @@
+/*
+ * Lepton VSYNC timing
+ *
+ * Keeps the timestamps of the most recent Lepton VSYNC edges (recorded by the VSYNC
+ * interrupt handler) and the delay until the task reading segments ran, and computes
+ * period and jitter statistics from them.  Timestamps are passed in so the logic does
+ * not depend on the hardware and can be driven by a simulated VSYNC source.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef VSYNC_TIMING_H
+#define VSYNC_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_attr.h"
+
+
+//
+// VSYNC Timing Constants
+//
+
+// Number of edge timestamps kept (power of 2)
+#define VSYNC_TS_LEN 64
+
+// An edge is only used to start a segment read if the task sees it within this
+// time (uSec) so the read has most of the segment period to complete
+#define VSYNC_MAX_WAKE_USEC 1000
+
+
+
+//
+// VSYNC Timing Typedefs
+//
+typedef struct {
+	uint32_t edges;              // Edges seen since vsync_timing_reset()
+	int num_periods;             // Periods in the statistics (up to VSYNC_TS_LEN - 1)
+	int32_t period_avg_usec;
+	int32_t period_min_usec;
+	int32_t period_max_usec;
+	int32_t jitter_usec;         // Standard deviation of the period
+	uint32_t missed;             // Periods longer than 1.5 nominal periods (edges lost)
+	uint32_t wakes;              // Edges the task woke for since the last statistics
+	int32_t wake_avg_usec;       // Delay from the edge until the task ran
+	int32_t wake_max_usec;
+	uint32_t late;               // Edges seen by the task after VSYNC_MAX_WAKE_USEC
+} vsync_stats_t;
+
+
+
+//
+// VSYNC Timing API
+//
+void vsync_timing_reset();
+void IRAM_ATTR vsync_timing_edge(int64_t t_usec);
+int64_t vsync_timing_last_edge();
+bool vsync_timing_wake(int64_t edge_usec, int64_t now_usec);
+void vsync_timing_get_stats(int32_t nominal_usec, vsync_stats_t* stats);
+
+#endif /* VSYNC_TIMING_H */
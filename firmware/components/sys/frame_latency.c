@@ -0,0 +1,187 @@
+/*
+ * Frame latency statistics
+ *
+ * Collects the time each lepton frame spends in the stages from the VSYNC of its
+ * first segment until the first video field showing it into histograms that can be
+ * read (and restarted) by a monitoring task.  Frames are recorded by vid_task from
+ * the timestamps carried with them in lep_buffer_t.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "frame_latency.h"
+#include <string.h>
+
+
+
+//
+// Frame Latency Variables
+//
+static frame_latency_stats_t lat_stats;
+
+// Set by the reader, the recording task clears the statistics before the next frame
+static volatile bool lat_reset = true;
+
+static const char* lat_stage_names[LAT_NUM_STAGES] = {
+	"acquire", "handoff", "queue", "render", "scanout", "total"
+};
+
+
+
+//
+// Frame Latency Forward Declarations for internal functions
+//
+static void check_reset();
+static void add_sample(int stage, int64_t start_usec, int64_t end_usec);
+
+
+
+//
+// Frame Latency API
+//
+
+/**
+ * Add a frame shown on the display to the statistics.  Called by the one task
+ * displaying frames.
+ *   stamps has all timestamps set
+ */
+void frame_latency_record(const frame_stamps_t* stamps)
+{
+	check_reset();
+
+	add_sample(LAT_ACQUIRE, stamps->vsync1_usec, stamps->vsync4_usec);
+	add_sample(LAT_HANDOFF, stamps->vsync4_usec, stamps->handoff_usec);
+	add_sample(LAT_QUEUE, stamps->handoff_usec, stamps->render_start_usec);
+	add_sample(LAT_RENDER, stamps->render_start_usec, stamps->render_end_usec);
+	add_sample(LAT_SCANOUT, stamps->render_end_usec, stamps->scanout_usec);
+	add_sample(LAT_TOTAL, stamps->vsync1_usec, stamps->scanout_usec);
+
+	lat_stats.frames++;
+	if ((stamps->scanout_usec - stamps->vsync1_usec) > LAT_LATE_USEC) {
+		lat_stats.late++;
+	}
+}
+
+
+/**
+ * Count a frame that was rendered but replaced by a newer one before it was shown.
+ * Called by the task displaying frames.
+ */
+void frame_latency_not_shown()
+{
+	check_reset();
+
+	lat_stats.not_shown++;
+}
+
+
+/**
+ * Get the statistics since the last reset.  The copy is not atomic so a frame being
+ * recorded at the same time may be in some histograms and not others.
+ *   stats is filled in (may be NULL)
+ *   reset starts new statistics with the next frame
+ */
+void frame_latency_get_stats(frame_latency_stats_t* stats, bool reset)
+{
+	if (stats != NULL) {
+		memcpy(stats, &lat_stats, sizeof(frame_latency_stats_t));
+	}
+
+	if (reset) {
+		lat_reset = true;
+	}
+}
+
+
+/**
+ * Return a percentile from a histogram of frame_latency_stats_t
+ *   per_mille is the percentile in 0.1% units (e.g. 500 for p50, 990 for p99)
+ * Returns the upper edge of the bucket holding the percentile in uSec, 0 if the
+ * histogram is empty
+ */
+uint32_t frame_latency_percentile_usec(const uint32_t* buckets, uint32_t per_mille)
+{
+	uint64_t total = 0;
+	uint64_t rank;
+	uint64_t count = 0;
+	int i;
+
+	for (i=0; i<LAT_BUCKETS; i++) {
+		total += buckets[i];
+	}
+	if (total == 0) {
+		return 0;
+	}
+
+	// Smallest bucket with at least per_mille of the samples at or below it
+	rank = (total * per_mille + 999) / 1000;
+	for (i=0; i<LAT_BUCKETS-1; i++) {
+		count += buckets[i];
+		if (count >= rank) break;
+	}
+
+	return (i+1) * LAT_BUCKET_USEC;
+}
+
+
+/**
+ * Return the short name of a stage for logging
+ */
+const char* frame_latency_stage_name(int stage)
+{
+	return ((stage >= 0) && (stage < LAT_NUM_STAGES)) ? lat_stage_names[stage] : "?";
+}
+
+
+
+//
+// Frame Latency internal functions
+//
+
+/**
+ * Clear the statistics if the reader asked for it
+ */
+static void check_reset()
+{
+	if (lat_reset) {
+		memset(&lat_stats, 0, sizeof(frame_latency_stats_t));
+		lat_reset = false;
+	}
+}
+
+
+/**
+ * Add one stage's duration to its histogram (durations from out of order timestamps
+ * count as 0)
+ */
+static void add_sample(int stage, int64_t start_usec, int64_t end_usec)
+{
+	int64_t d = end_usec - start_usec;
+	uint32_t b;
+
+	if (d < 0) d = 0;
+	if (d > UINT32_MAX) d = UINT32_MAX;
+
+	b = (uint32_t) d / LAT_BUCKET_USEC;
+	if (b >= LAT_BUCKETS) b = LAT_BUCKETS - 1;
+	lat_stats.hist[stage][b]++;
+
+	if ((uint32_t) d > lat_stats.max_usec[stage]) {
+		lat_stats.max_usec[stage] = (uint32_t) d;
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Frame latency statistics
+ *
+ * Collects the time each lepton frame spends in the stages from the VSYNC of its
+ * first segment until the first video field showing it into histograms that can be
+ * read (and restarted) by a monitoring task.  Frames are recorded by vid_task from
+ * the timestamps carried with them in lep_buffer_t.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef FRAME_LATENCY_H
+#define FRAME_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Frame Latency Constants
+//
+
+// Histogram buckets (the last bucket also holds everything above it)
+#define LAT_BUCKETS     128
+#define LAT_BUCKET_USEC 1000
+
+// Frames shown more than this long after their first segment's VSYNC are late
+#define LAT_LATE_USEC   100000
+
+// Stages
+#define LAT_ACQUIRE     0            // Segment 1 VSYNC to segment 4 VSYNC
+#define LAT_HANDOFF     1            // Segment 4 VSYNC to hand-off to vid_task
+#define LAT_QUEUE       2            // Hand-off to render start
+#define LAT_RENDER      3            // Render start to render end
+#define LAT_SCANOUT     4            // Render end to the start of the first field showing it
+#define LAT_TOTAL       5            // Segment 1 VSYNC to the start of the first field showing it
+#define LAT_NUM_STAGES  6
+
+
+
+//
+// Frame Latency Typedefs
+//
+
+// Timestamps (esp_timer uSec) of a frame
+typedef struct {
+	int64_t vsync1_usec;         // VSYNC starting segment 1
+	int64_t vsync4_usec;         // VSYNC starting segment 4
+	int64_t handoff_usec;        // Made available to vid_task
+	int64_t render_start_usec;
+	int64_t render_end_usec;
+	int64_t scanout_usec;        // Start of the first field showing the frame
+} frame_stamps_t;
+
+typedef struct {
+	uint32_t hist[LAT_NUM_STAGES][LAT_BUCKETS];
+	uint32_t max_usec[LAT_NUM_STAGES];
+	uint32_t frames;             // Frames recorded
+	uint32_t late;               // Frames with a total latency over LAT_LATE_USEC
+	uint32_t not_shown;          // Frames rendered but replaced before being shown
+} frame_latency_stats_t;
+
+
+
+//
+// Frame Latency API
+//
+void frame_latency_record(const frame_stamps_t* stamps);
+void frame_latency_not_shown();
+void frame_latency_get_stats(frame_latency_stats_t* stats, bool reset);
+uint32_t frame_latency_percentile_usec(const uint32_t* buckets, uint32_t per_mille);
+const char* frame_latency_stage_name(int stage);
+
+#endif /* FRAME_LATENCY_H */
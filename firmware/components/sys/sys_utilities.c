@@ -33,7 +33,6 @@
 #include "ps_utilities.h"
 #include "sys_utilities.h"
 #include "i2c.h"
-#include "render.h"
 #include "vospi.h"
 #include <string.h>
 
@@ -68,8 +67,8 @@ TaskHandle_t task_handle_mon;
 //
 
 // Shared memory data structures
-lep_buffer_t vid_lep_buffer[2];   // Ping-pong buffer loaded by lep_task for vid_task
-uint8_t* rend_fbP[2];      // Ping-pong rendering buffers for vid_task
+lep_buffer_t vid_lep_buffer[TBUF_NUM_BUFFERS];   // Loaded by lep_task for vid_task
+tbuf_t vid_lep_tbuf;                             // Ownership of vid_lep_buffer
 
 
 
@@ -99,7 +98,7 @@ bool system_esp_io_init()
 	spi_buscfg.miso_io_num=BRD_LEP_MISO_IO;
 	spi_buscfg.mosi_io_num=-1;
 	spi_buscfg.sclk_io_num=BRD_LEP_SCK_IO;
-	spi_buscfg.max_transfer_sz=LEP_PKT_LENGTH;
+	spi_buscfg.max_transfer_sz=VOSPI_MAX_TRANSFER_SZ;
 	spi_buscfg.quadwp_io_num=-1;
 	spi_buscfg.quadhd_io_num=-1;
 	
@@ -143,51 +142,22 @@ bool system_buffer_init()
 {
 	ESP_LOGI(TAG, "Buffer Allocation");
 	
-	// Allocate the LEP/RSP task lepton frame and telemetry ping-pong buffers
-	vid_lep_buffer[0].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
-	if (vid_lep_buffer[0].lep_bufferP == NULL) {
-		ESP_LOGE(TAG, "malloc VID lepton shared image buffer 0 failed");
-		return false;
-	}
-	vid_lep_buffer[0].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
-	if (vid_lep_buffer[0].lep_telemP == NULL) {
-		ESP_LOGE(TAG, "malloc VID lepton shared telemetry buffer 0 failed");
-		return false;
-	}
-	vid_lep_buffer[1].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
-	if (vid_lep_buffer[1].lep_bufferP == NULL) {
-		ESP_LOGE(TAG, "malloc VID lepton shared image buffer 1 failed");
-		return false;
-	}
-	vid_lep_buffer[1].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
-	if (vid_lep_buffer[1].lep_telemP == NULL) {
-		ESP_LOGE(TAG, "malloc VID lepton shared telemetry buffer 1 failed");
-		return false;
-	}
-	
-	// Create the ping-pong buffer access mutexes
-	vid_lep_buffer[0].lep_mutex = xSemaphoreCreateMutex();
-	if (vid_lep_buffer[0].lep_mutex == NULL) {
-		ESP_LOGE(TAG, "create VID lepton mutex 0 failed");
-		return false;
-	}
-	vid_lep_buffer[1].lep_mutex = xSemaphoreCreateMutex();
-	if (vid_lep_buffer[1].lep_mutex == NULL) {
-		ESP_LOGE(TAG, "create VID lepton mutex 1 failed");
-		return false;
+	// Allocate the LEP/VID task lepton frame and telemetry triple buffers
+	for (int i=0; i<TBUF_NUM_BUFFERS; i++) {
+		vid_lep_buffer[i].lep_bufferP = heap_caps_malloc(LEP_NUM_PIXELS*2, MALLOC_CAP_SPIRAM);
+		if (vid_lep_buffer[i].lep_bufferP == NULL) {
+			ESP_LOGE(TAG, "malloc VID lepton shared image buffer %d failed", i);
+			return false;
+		}
+		vid_lep_buffer[i].lep_telemP = heap_caps_malloc(LEP_TEL_WORDS*2, MALLOC_CAP_SPIRAM);
+		if (vid_lep_buffer[i].lep_telemP == NULL) {
+			ESP_LOGE(TAG, "malloc VID lepton shared telemetry buffer %d failed", i);
+			return false;
+		}
 	}
 	
-	// Create the ping-pong rendering buffers
-	rend_fbP[0] = heap_caps_malloc(IMG_BUF_WIDTH*IMG_BUF_HEIGHT, MALLOC_CAP_SPIRAM);
-	if (rend_fbP[0] == NULL) {
-		ESP_LOGE(TAG, "create rendering buffer 0 failed");
-		return false;
-	}
-	rend_fbP[1] = heap_caps_malloc(IMG_BUF_WIDTH*IMG_BUF_HEIGHT, MALLOC_CAP_SPIRAM);
-	if (rend_fbP[1] == NULL) {
-		ESP_LOGE(TAG, "create rendering buffer 1 failed");
-		return false;
-	}
+	// The buffers are exchanged between lep_task and vid_task without locks
+	tbuf_init(&vid_lep_tbuf);
 	
 	return true;
 }
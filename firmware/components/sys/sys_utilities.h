@@ -29,6 +29,8 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "system_config.h"
+#include "frame_latency.h"
+#include "triple_buffer.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -42,6 +44,9 @@
 #define SYS_GAIN_LOW  1
 #define SYS_GAIN_AUTO 2
 
+// Number of bins in the optional lepton image histogram
+#define LEP_HIST_BINS 256
+
 
 
 //
@@ -55,9 +60,15 @@ typedef struct {
 	uint16_t lep_max_val;
 	uint16_t lep_max_x;
 	uint16_t lep_max_y;
-	uint16_t* lep_bufferP;
+	uint16_t lep_mean_val;
+	uint16_t* lep_bufferP;       // Exchanged with the vospi acquisition buffer each frame
 	uint16_t* lep_telemP;
-	SemaphoreHandle_t lep_mutex;
+	bool hist_valid;
+	uint16_t lep_hist_min_val;   // Pixel value at the start of bin 0
+	uint16_t lep_hist_range;     // Pixel values min_val + range and above are in the last bin
+	uint32_t lep_hist_scale;     // bin = ((v - min_val) * scale) >> 16
+	uint16_t lep_hist[LEP_HIST_BINS];
+	frame_stamps_t lep_stamps;   // Acquisition times set by lep_task, display times by vid_task
 } lep_buffer_t;
 
 
@@ -86,8 +97,8 @@ extern TaskHandle_t task_handle_mon;
 //
 
 // Shared memory data structures
-extern lep_buffer_t vid_lep_buffer[2];   // Ping-pong buffer loaded by lep_task for vid_task
-extern uint8_t* rend_fbP[2];      // Ping-pong rendering buffers for vid_task
+extern lep_buffer_t vid_lep_buffer[TBUF_NUM_BUFFERS];   // Loaded by lep_task for vid_task
+extern tbuf_t vid_lep_tbuf;                              // Ownership of vid_lep_buffer
 
 
 
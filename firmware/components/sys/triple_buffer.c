@@ -0,0 +1,122 @@
+/*
+ * Triple buffer index exchange
+ *
+ * Lock-free exchange of frames between one producer and one consumer task using
+ * three buffers.  The producer owns one buffer to fill, the consumer owns one to read
+ * and the third holds the newest complete frame between them.  Publishing or taking a
+ * frame atomically exchanges the caller's buffer index with the middle one so neither
+ * side ever blocks or sees a buffer the other is using.  The consumer always gets the
+ * newest frame; frames replaced before they were taken are counted as dropped.
+ *
+ * Only uses C11 atomics so can be built and tested on a host.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "triple_buffer.h"
+
+
+
+//
+// Triple Buffer API
+//
+
+/**
+ * Setup the buffer ownership (producer 0, middle 1, consumer 2) and clear the counts.
+ * Must be called before either task uses the buffers.
+ */
+void tbuf_init(tbuf_t* tb)
+{
+	tb->back = 0;
+	atomic_init(&tb->middle, 1);
+	tb->front = 2;
+	atomic_init(&tb->produced, 0);
+	atomic_init(&tb->consumed, 0);
+	atomic_init(&tb->dropped, 0);
+}
+
+
+/**
+ * Return the index of the buffer the producer fills (only valid in the producer)
+ */
+int tbuf_producer_index(const tbuf_t* tb)
+{
+	return tb->back;
+}
+
+
+/**
+ * Make the producer's buffer the newest frame and give the producer the middle
+ * buffer to fill next.  Called by the producer.
+ */
+void tbuf_publish(tbuf_t* tb)
+{
+	unsigned int prev;
+
+	// Release the frame's contents to the consumer and acquire the buffer it last released
+	prev = atomic_exchange_explicit(&tb->middle, (unsigned int) tb->back | TBUF_FRESH, memory_order_acq_rel);
+	tb->back = prev & ~TBUF_FRESH;
+
+	atomic_fetch_add_explicit(&tb->produced, 1, memory_order_relaxed);
+	if ((prev & TBUF_FRESH) != 0) {
+		atomic_fetch_add_explicit(&tb->dropped, 1, memory_order_relaxed);
+	}
+}
+
+
+/**
+ * Take the newest frame if there is one the consumer hasn't seen.  Called by the
+ * consumer.  The frame is then at tbuf_consumer_index() until the next successful call.
+ * Returns false if there is no new frame (the consumer keeps its current buffer).
+ */
+bool tbuf_consume(tbuf_t* tb)
+{
+	unsigned int prev;
+
+	// Only the consumer clears TBUF_FRESH so a fresh frame can't go away before the exchange
+	if ((atomic_load_explicit(&tb->middle, memory_order_relaxed) & TBUF_FRESH) == 0) {
+		return false;
+	}
+
+	prev = atomic_exchange_explicit(&tb->middle, (unsigned int) tb->front, memory_order_acq_rel);
+	tb->front = prev & ~TBUF_FRESH;
+
+	atomic_fetch_add_explicit(&tb->consumed, 1, memory_order_relaxed);
+
+	return true;
+}
+
+
+/**
+ * Return the index of the buffer the consumer reads (only valid in the consumer)
+ */
+int tbuf_consumer_index(const tbuf_t* tb)
+{
+	return tb->front;
+}
+
+
+/**
+ * Get the frame counts.  May be called from any task.
+ */
+void tbuf_get_counts(tbuf_t* tb, tbuf_counts_t* counts)
+{
+	counts->produced = atomic_load_explicit(&tb->produced, memory_order_relaxed);
+	counts->consumed = atomic_load_explicit(&tb->consumed, memory_order_relaxed);
+	counts->dropped = atomic_load_explicit(&tb->dropped, memory_order_relaxed);
+}
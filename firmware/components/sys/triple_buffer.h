@@ -0,0 +1,81 @@
+/*
+ * Triple buffer index exchange
+ *
+ * Lock-free exchange of frames between one producer and one consumer task using
+ * three buffers.  The producer owns one buffer to fill, the consumer owns one to read
+ * and the third holds the newest complete frame between them.  Publishing or taking a
+ * frame atomically exchanges the caller's buffer index with the middle one so neither
+ * side ever blocks or sees a buffer the other is using.  The consumer always gets the
+ * newest frame; frames replaced before they were taken are counted as dropped.
+ *
+ * Only uses C11 atomics so can be built and tested on a host.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Triple Buffer Constants
+//
+
+// Number of buffers managed
+#define TBUF_NUM_BUFFERS 3
+
+// Set in the middle index when it holds a frame the consumer hasn't taken
+#define TBUF_FRESH       0x80
+
+
+
+//
+// Triple Buffer Typedefs
+//
+typedef struct {
+	atomic_uint middle;          // Buffer between the tasks (with TBUF_FRESH)
+	int back;                    // Buffer owned by the producer
+	int front;                   // Buffer owned by the consumer
+	atomic_uint produced;
+	atomic_uint consumed;
+	atomic_uint dropped;         // Replaced by a newer frame before being taken
+} tbuf_t;
+
+typedef struct {
+	uint32_t produced;
+	uint32_t consumed;
+	uint32_t dropped;
+} tbuf_counts_t;
+
+
+
+//
+// Triple Buffer API
+//
+void tbuf_init(tbuf_t* tb);
+int tbuf_producer_index(const tbuf_t* tb);
+void tbuf_publish(tbuf_t* tb);
+bool tbuf_consume(tbuf_t* tb);
+int tbuf_consumer_index(const tbuf_t* tb);
+void tbuf_get_counts(tbuf_t* tb, tbuf_counts_t* counts);
+
+#endif /* TRIPLE_BUFFER_H */
@@ -21,82 +21,473 @@
  */
 #include <math.h>
 #include <string.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#if defined(RENDER_BENCHMARK) || defined(RENDER_STRIP_STATS)
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "soc/cpu.h"
+#endif
 #include "render.h"
 #include "font.h"
 #include "digits8x16.h"
 #include "font7x10.h"
+#include "lepton_temp.h"
 #include "lepton_utilities.h"
 #include "sys_utilities.h"
 
 
 
+//
+// Constants
+//
+#define RENDER_NUM_STRIPS (LEP_HEIGHT / RENDER_STRIP_LINES)
+
+#if (RENDER_NUM_STRIPS * RENDER_STRIP_LINES) != LEP_HEIGHT
+#error "RENDER_STRIP_LINES must evenly divide LEP_HEIGHT"
+#endif
+
+#ifdef SYS_HEQ_CLAHE
+#define CLAHE_TILE_W      (LEP_WIDTH / SYS_CLAHE_TILES_X)
+#define CLAHE_TILE_H      (LEP_HEIGHT / SYS_CLAHE_TILES_Y)
+#define CLAHE_TILE_PIXELS (CLAHE_TILE_W * CLAHE_TILE_H)
+
+#if ((CLAHE_TILE_W * SYS_CLAHE_TILES_X) != LEP_WIDTH) || ((CLAHE_TILE_H * SYS_CLAHE_TILES_Y) != LEP_HEIGHT)
+#error "SYS_CLAHE_TILES_X and SYS_CLAHE_TILES_Y must evenly divide the lepton image"
+#endif
+#endif
+
+
+
+//
+// Typedefs
+//
+
+// Per-frame constants to scale radiometric data to 8-bits without a divide per pixel.
+// (v - min_val) * 255 / diff is computed as the upper 32 bits of
+// ((v - min_val) << pre_shift) * recip, exact for every diff up to 65535.
+// Histogram equalization uses min_val with the lepton buffer's histogram binning
+// to index lut.
+typedef struct {
+	uint16_t min_val;
+	uint32_t diff;
+	uint32_t recip;
+	int pre_shift;
+	uint16_t hist_range;
+	uint32_t hist_scale;
+	const uint8_t* lut;
+} render_norm_t;
+
+// Row stage: converts lepton line y into 8-bit values for the interpolator
+typedef void (*render_row_func_t)(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n);
+
+// Specialized renderer for one palette, display mode and data type combination
+typedef void (*render_variant_func_t)(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+
+// Scaler taps for one output column or row: lepton pixels and their weights (sum 256)
+typedef struct {
+	uint8_t idx[4];
+	int16_t w[4];
+} render_scale_tap_t;
+
+// Overlay display list element: a filled rectangle or a sprite of pixels.  Sprite pixels
+// with the value RENDER_OVERLAY_CLEAR are transparent.
+typedef struct {
+	int16_t x;
+	int16_t y;
+	int16_t w;
+	int16_t h;
+	uint8_t c;                // Rectangle fill value
+	const uint8_t* pixP;      // Sprite pixels (w*h) or NULL for a rectangle
+} render_ovl_elem_t;
+
+typedef struct {
+	int num_elems;
+	int pool_used;
+	render_ovl_elem_t elem[RENDER_OVERLAY_MAX_ELEMENTS];
+	uint8_t pool[RENDER_OVERLAY_POOL_BYTES];
+} render_ovl_list_t;
+
+// Font expanded to one byte per pixel (TEXT_COLOR or TEXT_BG_COLOR).  Each glyph is
+// font_Height rows of cell_w bytes including the spacing column after it.
+typedef struct {
+	const Font_TypeDef* font;
+	int cell_w;
+	uint8_t* pixP;
+} render_atlas_t;
+
+// Rendered text box (text on a one pixel TEXT_BG_COLOR border) kept until the text changes
+typedef struct {
+	const Font_TypeDef* font;
+	char str[RENDER_TEXT_MAX_CHARS+1];
+	int16_t w;
+	int16_t h;
+	uint32_t last_use;
+	uint8_t pix[RENDER_TEXT_CACHE_BYTES];
+} render_text_cache_t;
+
+// Drawing target for the draw functions (a sprite at x0, y0 in the display image)
+typedef struct {
+	uint8_t* buf;
+	int16_t x0;
+	int16_t y0;
+	int16_t w;
+	int16_t h;
+} render_canvas_t;
+
+#ifdef SYS_HEQ_CLAHE
+// CLAHE blend for one pixel row or column: weight w/256 of tile t1, the rest of tile t0
+typedef struct {
+	uint8_t t0;
+	uint8_t t1;
+	uint16_t w;
+} render_clahe_wt_t;
+#endif
+
+
+
 //
 // Variables
 //
 static uint8_t render_palette_mod;    // Either 0x00 or 0xFF, used to invert image (white-hot -> black-hot)
 
+// Specialized renderer for the current gui state and the state it was selected for
+static render_variant_func_t render_variantP;
+static int render_variant_key = -1;
+
+// Two 8-bit source lines for the streaming interpolator
+static uint8_t render_row_buf[2][LEP_WIDTH];
+
+// Internal RAM copy of RENDER_STRIP_LINES lepton lines starting at render_strip_y
+// (-1 when empty)
+static uint16_t render_strip_buf[RENDER_STRIP_LINES * LEP_WIDTH];
+static int render_strip_y;
+
+// Output image size and the part of the lepton image it shows (16.16 lepton pixels)
+static int render_img_width = IMG_BUF_WIDTH;
+static int render_img_height = IMG_BUF_HEIGHT;
+static int32_t render_src_x0 = 0;
+static int32_t render_src_y0 = 0;
+static int32_t render_src_w = LEP_WIDTH << 16;
+static int32_t render_src_h = LEP_HEIGHT << 16;
+
+// Separable scaler for images other than the default 2x interpolation
+static bool render_scaler_enabled = false;
+static int render_scale_taps;                      // 2 for bilinear, 4 for bicubic
+static render_scale_tap_t* render_scale_col;       // Per output column
+static render_scale_tap_t* render_scale_row;       // Per output row
+static int16_t* render_scale_hbuf[4];              // Horizontally scaled lepton lines...
+static int render_scale_hbuf_line[4];              // ...and the line in each
+
+// Overlay display lists.  One is built while the video interrupt may be compositing the
+// other.
+static render_ovl_list_t render_ovl_list[2];
+static render_ovl_list_t* render_ovl_buildP = &render_ovl_list[0];
+static render_ovl_list_t* DRAM_ATTR render_ovl_curP;             // Composited this field
+static render_ovl_list_t* volatile DRAM_ATTR render_ovl_nextP;   // For the next field, NULL if unchanged
+static render_canvas_t render_cv;
+
+// Glyph atlases for the text fonts and the text cache
+static render_atlas_t render_atlas[2] = {{&Digits8x16, 0, NULL}, {&Font7x10, 0, NULL}};
+static render_text_cache_t render_text_cache[RENDER_TEXT_CACHE_ENTRIES];
+static uint32_t render_text_use_count;
+
+// Histogram equalization mapping from histogram bin to 8-bit value
+static uint8_t render_heq_lut[LEP_HIST_BINS];
+static uint16_t render_heq_hist[LEP_HIST_BINS];
+
+#ifdef SYS_HEQ_CLAHE
+// CLAHE per-tile mappings, histograms for one row of tiles and blend weights
+static uint8_t render_clahe_lut[SYS_CLAHE_TILES_Y][SYS_CLAHE_TILES_X][LEP_HIST_BINS];
+static uint16_t render_clahe_hist[SYS_CLAHE_TILES_X][LEP_HIST_BINS];
+static render_clahe_wt_t render_clahe_x_wt[LEP_WIDTH];
+static render_clahe_wt_t render_clahe_y_wt[LEP_HEIGHT];
+#endif
+
+#if defined(RENDER_BENCHMARK) || defined(RENDER_STRIP_STATS)
+static const char* TAG = "render";
+#endif
+
+#ifdef RENDER_STRIP_STATS
+static uint32_t strip_frames;
+static uint32_t strip_t0;
+static uint32_t strip_copy_cycles[RENDER_NUM_STRIPS];
+static uint32_t strip_render_cycles[RENDER_NUM_STRIPS];
+#endif
+
+#ifdef RENDER_BENCHMARK
+static uint32_t bench_spot_calls;
+static uint32_t bench_spot_cycles;
+static uint32_t bench_text_cycles;
+static uint32_t bench_text_atlas_cycles;
+static uint32_t bench_text_ref_cycles;
+static uint8_t bench_text_buf[RENDER_TEXT_CACHE_BYTES];
+static uint16_t* bench_lepP;
+static uint8_t* bench_imgP;
+static uint32_t bench_frames;
+static uint32_t bench_cycles;
+static uint32_t bench_ref_cycles;
+static uint32_t bench_mismatch_frames;
+#endif
+
 
 
 //
 // Forward declarations for internal functions
 //
-static void render_double_rad_data(lep_buffer_t* lep, uint8_t* img, gui_state_t* g);
-static void render_double_agc_data(lep_buffer_t* lep, uint8_t* img);
-static void render_interp_rad_data(lep_buffer_t* lep, uint8_t* img, gui_state_t* g);
-static void render_interp_agc_data(uint16_t* buf, uint8_t* img);
-static void render_min_marker(lep_buffer_t* lep, uint8_t* img);
-static void render_max_marker(lep_buffer_t* lep, uint8_t* img);
+static void render_double_data(lep_buffer_t* lep, uint8_t* img, render_row_func_t row_func, const render_norm_t* n);
+static void render_scaled_data(lep_buffer_t* lep, uint8_t* img, render_row_func_t row_func, const render_norm_t* n);
+static void render_scale_set_taps(render_scale_tap_t* taps, int len, int32_t src_x0, int32_t src_w, int src_len, render_kernel_t kernel);
+static void render_scale_hline(const uint8_t* src, int16_t* dst);
+static void render_scale_vline(const render_scale_tap_t* t, uint8_t* img);
+static void render_scale_free();
+static void render_strip_begin();
+static const uint16_t* render_strip_line(lep_buffer_t* lep, int y);
+static void render_strip_end();
+static int16_t render_map_x(int x);
+static int16_t render_map_y(int y);
+static void render_interp_data(lep_buffer_t* lep, uint8_t* img, render_row_func_t row_func, const render_norm_t* n);
+static void render_variant_select(gui_state_t* g);
+static void render_double_norm_wh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static void render_double_agc_wh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static void render_double_norm_bh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static void render_double_agc_bh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static void render_interp_norm_wh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static void render_interp_agc_wh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static void render_interp_norm_bh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static void render_interp_agc_bh(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n);
+static render_row_func_t render_row_setup(lep_buffer_t* lep, gui_state_t* g, render_norm_t* n);
+static void render_norm_setup(lep_buffer_t* lep, render_norm_t* n);
+static void render_bin_setup(lep_buffer_t* lep, render_norm_t* n);
+static void render_heq_setup(lep_buffer_t* lep, render_norm_t* n);
+#ifdef SYS_HEQ_CLAHE
+static void render_clahe_setup(lep_buffer_t* lep, render_norm_t* n);
+static void render_clahe_set_weights(render_clahe_wt_t* wt, int len, int tiles, int tile_size);
+static void render_clahe_tile_lut(uint16_t* hist, uint8_t* lut);
+#endif
+static __inline__ uint8_t render_norm_pixel(uint32_t v, const render_norm_t* n);
+static void render_norm_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n);
+static void render_bin_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n);
+static void render_heq_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n);
+#ifdef SYS_HEQ_CLAHE
+static void render_clahe_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n);
+#endif
+static void render_agc_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n);
+#ifdef RENDER_BENCHMARK
+static void render_benchmark(lep_buffer_t* lep, uint8_t* img, gui_state_t* g, render_row_func_t row_func, uint32_t cycles);
+static void render_interp_rad_data_ref(lep_buffer_t* lep, uint8_t* img, gui_state_t* g);
+static void render_interp_agc_data_ref(uint16_t* buf, uint8_t* img);
 static void interp_set_pixel(uint16_t src, uint8_t* img, int x, int y);
 static void interp_set_outer_row(uint16_t* src, uint8_t* img, bool first_row);
 static void interp_set_outer_col(uint16_t* src, uint8_t* img, bool first_col);
 static void interp_set_inner(uint16_t* src, uint8_t* img);
-static void draw_hline(uint8_t* img, int16_t x1, int16_t x2, int16_t y, uint8_t c);
-static void draw_vline(uint8_t* img, int16_t x, int16_t y1, int16_t y2, uint8_t c);
-static void draw_line(uint8_t* img, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t c);
-static void draw_fill_rect(uint8_t* img, int16_t x, int16_t y, int16_t w, int16_t h, uint8_t c);
-static int16_t draw_char(uint8_t* img, int16_t x, int16_t y, uint8_t c, const Font_TypeDef *Font);
-static void draw_string(uint8_t* img, int16_t x, int16_t y, const char *str, const Font_TypeDef *Font);
-static __inline__ void draw_pixel(uint8_t* img, int16_t x, int16_t y, uint8_t c);
+#endif
+static void render_min_marker(lep_buffer_t* lep);
+static void render_max_marker(lep_buffer_t* lep);
+static void render_overlay_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t c);
+static bool render_overlay_sprite(int16_t x, int16_t y, int16_t w, int16_t h);
+static IRAM_ATTR void render_overlay_elem_line(const render_ovl_elem_t* e, int y, uint8_t* line);
+static void render_overlay_text(int16_t x, int16_t y, const char* s, const Font_TypeDef* font);
+static bool render_atlas_build(render_atlas_t* a);
+static const render_atlas_t* render_atlas_get(const Font_TypeDef* font);
+static int render_text_length(const char* s, const Font_TypeDef* font);
+static void render_text_raster(const char* s, int n, const render_atlas_t* a, uint8_t* pix, int16_t w, int16_t h);
+static void draw_hline(int16_t x1, int16_t x2, int16_t y, uint8_t c);
+static void draw_line(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t c);
+#ifdef RENDER_BENCHMARK
+static void render_benchmark_spotmeter(const char* s, uint32_t cycles, uint32_t text_cycles);
+static void draw_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t c);
+static int16_t draw_char(int16_t x, int16_t y, uint8_t c, const Font_TypeDef *Font);
+static void draw_string(int16_t x, int16_t y, const char *str, const Font_TypeDef *Font);
+#endif
+static __inline__ void draw_pixel(int16_t x, int16_t y, uint8_t c);
 static uint16_t get_string_width(const char *str, const Font_TypeDef *Font);
-static float lep_to_disp_temp(uint16_t v, gui_state_t* g);
+static IRAM_ATTR void line_set_outer(const uint8_t* P, uint8_t* line, uint8_t mod);
+static IRAM_ATTR void line_set_inner(const uint8_t* P, const uint8_t* Q, uint8_t* line, uint8_t mod);
+static __inline__ __attribute__((always_inline)) void line_set_outer_k(const uint8_t* P, uint8_t* line, uint8_t mod);
+static __inline__ __attribute__((always_inline)) void line_set_inner_k(const uint8_t* P, const uint8_t* Q, uint8_t* line, uint8_t mod);
 
 
 //
 // Render API
 //
+
+/**
+ * Expand the text fonts into glyph atlases.  Call once at startup.
+ */
+bool render_init()
+{
+	int i;
+	
+	for (i=0; i<2; i++) {
+		if (!render_atlas_build(&render_atlas[i])) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
 void render_lep_data(lep_buffer_t* lep, uint8_t* img, gui_state_t* g)
 {
-	// Setup the global palette modifier
-	render_palette_mod = (g->black_hot_palette) ? 0xFF : 0x00;
+	render_norm_t norm;
+	render_row_func_t row_func;
+#ifdef RENDER_BENCHMARK
+	uint32_t t = esp_cpu_get_ccount();
+#endif
 	
-	if (g->display_interp_enable) {
-		if (g->agc_enabled) {
-			render_interp_agc_data(lep->lep_bufferP, img);
-		} else {
-			render_interp_rad_data(lep, img, g);
+	// Setup the global palette modifier and specialized renderer
+	render_variant_select(g);
+	
+	row_func = render_row_setup(lep, g, &norm);
+	
+	if (render_scaler_enabled) {
+		render_scaled_data(lep, img, row_func, &norm);
+	} else if ((row_func == render_norm_row) || (row_func == render_agc_row)) {
+		render_variantP(lep, img, &norm);
+	} else if (g->display_interp_enable) {
+		// Single pass over the lepton buffer, which is left unmodified
+		render_interp_data(lep, img, row_func, &norm);
+	} else {
+		render_double_data(lep, img, row_func, &norm);
+	}
+#ifdef RENDER_BENCHMARK
+	render_benchmark(lep, img, g, row_func, esp_cpu_get_ccount() - t);
+#endif
+}
+
+
+/**
+ * Set the size of the images made by render_lep_data() and the other render functions
+ * (default IMG_BUF_WIDTH x IMG_BUF_HEIGHT).  Images other than the default size, bicubic
+ * or zoomed are made by a separable scaler using per-column and per-row weight tables
+ * computed here so there is no per-pixel floating point.  Call before rendering.
+ *   width, height are the image dimensions, e.g. the whole visible 384x288 PAL raster
+ *   kernel selects bilinear or bicubic interpolation
+ *   zoom_pct is the digital zoom into the center of the lepton image (100 = none)
+ * Returns false if the tables could not be allocated (the default image is restored)
+ */
+bool render_set_image_size(uint16_t width, uint16_t height, render_kernel_t kernel, uint16_t zoom_pct)
+{
+	int i;
+	
+	render_scale_free();
+	
+	if (zoom_pct < 100) zoom_pct = 100;
+	render_img_width = width;
+	render_img_height = height;
+	render_src_w = (int32_t) (((int64_t) LEP_WIDTH << 16) * 100 / zoom_pct);
+	render_src_h = (int32_t) (((int64_t) LEP_HEIGHT << 16) * 100 / zoom_pct);
+	render_src_x0 = ((LEP_WIDTH << 16) - render_src_w) / 2;
+	render_src_y0 = ((LEP_HEIGHT << 16) - render_src_h) / 2;
+	
+	// The 2x interpolator makes the default image
+	if ((width == IMG_BUF_WIDTH) && (height == IMG_BUF_HEIGHT) && (kernel == RENDER_KERNEL_BILINEAR) && (zoom_pct == 100)) {
+		return true;
+	}
+	
+	render_scale_col = heap_caps_malloc(width * sizeof(render_scale_tap_t), MALLOC_CAP_INTERNAL);
+	render_scale_row = heap_caps_malloc(height * sizeof(render_scale_tap_t), MALLOC_CAP_INTERNAL);
+	for (i=0; i<4; i++) {
+		render_scale_hbuf[i] = heap_caps_malloc(width * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+	}
+	if ((render_scale_col == NULL) || (render_scale_row == NULL) || (render_scale_hbuf[0] == NULL) ||
+	    (render_scale_hbuf[1] == NULL) || (render_scale_hbuf[2] == NULL) || (render_scale_hbuf[3] == NULL)) {
+		render_set_image_size(IMG_BUF_WIDTH, IMG_BUF_HEIGHT, RENDER_KERNEL_BILINEAR, 100);
+		return false;
+	}
+	
+	render_scale_taps = (kernel == RENDER_KERNEL_BICUBIC) ? 4 : 2;
+	render_scale_set_taps(render_scale_col, width, render_src_x0, render_src_w, LEP_WIDTH, kernel);
+	render_scale_set_taps(render_scale_row, height, render_src_y0, render_src_h, LEP_HEIGHT, kernel);
+	render_scaler_enabled = true;
+	
+	return true;
+}
+
+
+/**
+ * Convert the lepton image to 8-bit palette values for rendering lines on demand
+ * with render_src_line().  The lepton buffer is not modified.
+ *   src points to a LEP_WIDTH x LEP_HEIGHT buffer in internal RAM
+ */
+void render_lep_data_src(lep_buffer_t* lep, uint8_t* src, gui_state_t* g)
+{
+	uint8_t mod = (g->black_hot_palette) ? 0xFF : 0x00;
+	render_norm_t norm;
+	render_row_func_t row_func;
+	int x, y;
+	
+	row_func = render_row_setup(lep, g, &norm);
+	render_strip_begin();
+	for (y=0; y<LEP_HEIGHT; y++) {
+		row_func(render_strip_line(lep, y), src, y, &norm);
+		for (x=0; x<LEP_WIDTH; x++) {
+			*src++ ^= mod;
 		}
+	}
+	render_strip_end();
+}
+
+
+/**
+ * Render one display line from a source image made by render_lep_data_src().  Produces
+ * the same pixels as the frame buffer renderers (interpolated black hot pixels may differ
+ * by one count since the palette is applied first).  Called from the video interrupt so
+ * it lives in IRAM and only touches the buffers passed in.
+ *   src points to the LEP_WIDTH x LEP_HEIGHT source buffer
+ *   y is the display line (0 - IMG_BUF_HEIGHT-1)
+ *   line points to IMG_BUF_WIDTH pixels to fill
+ *   interp selects linear interpolation instead of pixel doubling
+ */
+void IRAM_ATTR render_src_line(const uint8_t* src, int y, uint8_t* line, bool interp)
+{
+	const uint8_t* P;
+	const uint8_t* Q;
+	int x;
+	
+	if (!interp) {
+		P = src + (y/2)*LEP_WIDTH;
+		for (x=0; x<LEP_WIDTH; x++) {
+			*line++ = *P;
+			*line++ = *P++;
+		}
+	} else if ((y == 0) || (y == IMG_BUF_HEIGHT-1)) {
+		// Top/Bottom rows
+		line_set_outer((y == 0) ? src : src + (LEP_HEIGHT-1)*LEP_WIDTH, line, 0);
 	} else {
-		if (g->agc_enabled) {
-			render_double_agc_data(lep, img);
-		} else {
-			render_double_rad_data(lep, img, g);
+		// Display line 2n+1 is closest to source line n, 2n+2 to source line n+1
+		P = src + ((y-1)/2)*LEP_WIDTH;
+		Q = P + LEP_WIDTH;
+		if ((y & 1) == 0) {
+			P = Q;
+			Q = P - LEP_WIDTH;
 		}
+		line_set_inner(P, Q, line, 0);
 	}
 }
 
 
-void render_spotmeter(lep_buffer_t* lep, uint8_t* img, gui_state_t* g)
+/**
+ * Add the spotmeter bounding box and temperature to the overlay
+ */
+void render_spotmeter(lep_buffer_t* lep, gui_state_t* g)
 {
-	char temp_str[8];
+	char temp_str[LEP_TEMP_STR_LEN];
 	int16_t x1, x2, y1, y2;
-	uint16_t c1, c2, r1, r2;
+	int16_t c1, c2, r1, r2;
 	uint16_t dw, dh;
 	uint16_t w, h;
+#ifdef RENDER_BENCHMARK
+	uint32_t t0 = esp_cpu_get_ccount();
+	uint32_t t1;
+#endif
 	
-	c1 = lep->lep_telemP[LEP_TEL_SPOT_X1] * IMG_BUF_MULT_FACTOR;
-	r1 = lep->lep_telemP[LEP_TEL_SPOT_Y1] * IMG_BUF_MULT_FACTOR;
-	c2 = lep->lep_telemP[LEP_TEL_SPOT_X2] * IMG_BUF_MULT_FACTOR;
-	r2 = lep->lep_telemP[LEP_TEL_SPOT_Y2] * IMG_BUF_MULT_FACTOR;
+	c1 = render_map_x(lep->lep_telemP[LEP_TEL_SPOT_X1]);
+	r1 = render_map_y(lep->lep_telemP[LEP_TEL_SPOT_Y1]);
+	c2 = render_map_x(lep->lep_telemP[LEP_TEL_SPOT_X2]);
+	r2 = render_map_y(lep->lep_telemP[LEP_TEL_SPOT_Y2]);
 	
 	// Spotmeter sense area dimensions
 	dw = c2 - c1;
@@ -118,62 +509,148 @@ void render_spotmeter(lep_buffer_t* lep, uint8_t* img, gui_state_t* g)
 	
 	// Draw a white bounding box surrounded by a black bounding box for contrast
 	// on all color palettes
-	draw_hline(img, x1, x2, y1, 0xFF);
-	draw_hline(img, x1, x2, y2, 0xFF);
-	draw_vline(img, x1, y1, y2, 0xFF);
-	draw_vline(img, x2, y1, y2, 0xFF);
+	render_overlay_rect(x1, y1, w+1, 1, 0xFF);
+	render_overlay_rect(x1, y2, w+1, 1, 0xFF);
+	render_overlay_rect(x1, y1, 1, h+1, 0xFF);
+	render_overlay_rect(x2, y1, 1, h+1, 0xFF);
 	
 	x1--;
 	y1--;
 	x2++;
 	y2++;
 	
-	draw_hline(img, x1, x2, y1, 0x00);
-	draw_hline(img, x1, x2, y2, 0x00);
-	draw_vline(img, x1, y1, y2, 0x00);
-	draw_vline(img, x2, y1, y2, 0x00);
+	render_overlay_rect(x1, y1, w+3, 1, 0x00);
+	render_overlay_rect(x1, y2, w+3, 1, 0x00);
+	render_overlay_rect(x1, y1, 1, h+3, 0x00);
+	render_overlay_rect(x2, y1, 1, h+3, 0x00);
 	
 	// Get the temperature string
-	sprintf(temp_str, "%d", (int16_t) round(lep_to_disp_temp(lep->lep_telemP[LEP_TEL_SPOT_MEAN], g)));
+	lepton_temp_to_str(lepton_kelvin_to_temp(lep->lep_telemP[LEP_TEL_SPOT_MEAN], g->rad_high_res, g->temp_unit_C, 0), 0, temp_str);
 	
 	// Compute upper left corner for text string
 	dw = get_string_width(temp_str, &Digits8x16);
 	dh = Digits8x16.font_Height;
 	x1 = c1 - dw/2;
-	y1 = (c1 <= (IMG_BUF_HEIGHT/2)) ? y1 - dh - 2 : y2 + 2;
+	y1 = (r1 <= (render_img_height/2)) ? y1 - dh - 2 : y2 + 2;
 	
-	// Blank an area and the draw the text
-	draw_fill_rect(img, x1-1, y1-1, dw+2, dh+2, TEXT_BG_COLOR);
-	draw_string(img, x1, y1, temp_str, &Digits8x16);	
+	// Draw the text on a blanked area
+#ifdef RENDER_BENCHMARK
+	t1 = esp_cpu_get_ccount();
+#endif
+	render_overlay_text(x1, y1, temp_str, &Digits8x16);
+#ifdef RENDER_BENCHMARK
+	render_benchmark_spotmeter(temp_str, esp_cpu_get_ccount() - t0, esp_cpu_get_ccount() - t1);
+#endif
 }
 
 
-void render_min_max_markers(lep_buffer_t* lep, uint8_t* img)
+/**
+ * Add the min and max markers to the overlay
+ */
+void render_min_max_markers(lep_buffer_t* lep)
 {
-	render_min_marker(lep, img);
-	render_max_marker(lep, img);
+	render_min_marker(lep);
+	render_max_marker(lep);
 }
 
 
-void render_parm_string(const char* s, uint8_t* img)
+/**
+ * Add a parameter string to the overlay
+ */
+void render_parm_string(const char* s)
 {
-	uint16_t w, h;
+	uint16_t w;
 	uint16_t x, y;
 	
 	// Do nothing for zero-length strings
 	if (s[0] == 0) return;
 	
-	// Compute the width and height of the string
+	// Compute the width of the string
 	w = get_string_width(s, &Font7x10);
-	h = Font7x10.font_Height;
 	
 	// Compute the starting location
-	x = (IMG_BUF_WIDTH - w) / 2;
-	y = IMG_BUF_HEIGHT/3;
+	x = (render_img_width - w) / 2;
+	y = render_img_height/3;
 	
-	// Blank an area and draw the text
-	draw_fill_rect(img, x-1, y-1, w+2, h+2, TEXT_BG_COLOR);
-	draw_string(img, x, y, s, &Font7x10);
+	// Draw the text on a blanked area
+	render_overlay_text(x, y, s, &Font7x10);
+}
+
+
+/**
+ * Start a new overlay.  The render_spotmeter(), render_min_max_markers() and
+ * render_parm_string() functions add elements to it, each a filled rectangle
+ * or a small sprite covering only its bounding box.
+ */
+void render_overlay_begin()
+{
+	// Withdraw any list not yet picked up so the interrupt can't switch to it while
+	// we write, then use the one not being composited
+	render_ovl_nextP = NULL;
+	render_ovl_buildP = (render_ovl_curP == &render_ovl_list[0]) ? &render_ovl_list[1] : &render_ovl_list[0];
+	render_ovl_buildP->num_elems = 0;
+	render_ovl_buildP->pool_used = 0;
+}
+
+
+/**
+ * Finish the overlay.  It is composited by render_overlay_line() starting with the next
+ * field and by subsequent calls to render_overlay_draw().
+ */
+void render_overlay_end()
+{
+	render_ovl_nextP = render_ovl_buildP;
+}
+
+
+/**
+ * Composite the overlay into a frame buffer.  Only the pixels in the bounding box
+ * of each element are touched.
+ */
+void render_overlay_draw(uint8_t* img)
+{
+	const render_ovl_elem_t* e = render_ovl_buildP->elem;
+	const render_ovl_elem_t* eEndP = e + render_ovl_buildP->num_elems;
+	int y, y2;
+	
+	while (e < eEndP) {
+		y = (e->y < 0) ? 0 : e->y;
+		y2 = (e->y + e->h > render_img_height) ? render_img_height : e->y + e->h;
+		while (y < y2) {
+			render_overlay_elem_line(e, y, img + y*render_img_width);
+			y++;
+		}
+		e++;
+	}
+}
+
+
+/**
+ * Composite the overlay into one display line as it is sent so it can change every
+ * field instead of with each lepton frame.  Switches overlays only at the top of the
+ * field.  Called from the video interrupt so it lives in IRAM.
+ *   y is the display line
+ *   line points to the display line pixels
+ */
+void IRAM_ATTR render_overlay_line(int y, uint8_t* line)
+{
+	const render_ovl_elem_t* e;
+	const render_ovl_elem_t* eEndP;
+	
+	if ((y == 0) && (render_ovl_nextP != NULL)) {
+		render_ovl_curP = render_ovl_nextP;
+		render_ovl_nextP = NULL;
+	}
+	if (render_ovl_curP == NULL) return;
+	
+	e = render_ovl_curP->elem;
+	eEndP = e + render_ovl_curP->num_elems;
+	while (e < eEndP) {
+		if ((y >= e->y) && (y < (e->y + e->h))) {
+			render_overlay_elem_line(e, y, line);
+		}
+		e++;
+	}
 }
 
 
@@ -181,32 +658,23 @@ void render_parm_string(const char* s, uint8_t* img)
 //
 // Internal functions
 //
-static void render_double_rad_data(lep_buffer_t* lep, uint8_t* img, gui_state_t* g)
+/**
+ * Double each lepton pixel into the display buffer.
+ *   row_func converts a lepton line to 8-bit values
+ *   n holds the per-frame constants for row_func
+ */
+static void render_double_data(lep_buffer_t* lep, uint8_t* img, render_row_func_t row_func, const render_norm_t* n)
 {
 	int src_y;
-	uint32_t t32;
-	uint32_t diff;
-	uint16_t* ptr = lep->lep_bufferP;
-	uint16_t min_val, max_val;
+	int x;
 	uint8_t t8;
 	
-	// Dynamic range from image
-	min_val = lep->lep_min_val;
-	max_val = lep->lep_max_val;
-	diff = max_val - min_val;
-	if (diff == 0) diff = 1;
-	
+	render_strip_begin();
 	for (src_y=0; src_y<LEP_HEIGHT; src_y++) {
-		// Linearly scale then double each pixel in a source line into the destination buffer
-		while (ptr < (lep->lep_bufferP + ((src_y+1)*LEP_WIDTH))) {
-			if (*ptr < min_val) {
-				t8 = 0;
-				ptr++;
-			} else {
-				t32 = ((uint32_t)(*ptr++ - min_val) * 255) / diff;
-				t8 = (t32 > 255) ? 255 : (uint8_t) t32;
-			}
-			
+		// Convert then double each pixel in a source line into the destination buffer
+		row_func(render_strip_line(lep, src_y), render_row_buf[0], src_y, n);
+		for (x=0; x<LEP_WIDTH; x++) {
+			t8 = render_row_buf[0][x];
 			*img++ = t8 ^ render_palette_mod;
 			*img++ = t8 ^ render_palette_mod;
 		}
@@ -215,169 +683,801 @@ static void render_double_rad_data(lep_buffer_t* lep, uint8_t* img, gui_state_t*
 		memcpy(img, img - 2*LEP_WIDTH, 2*LEP_WIDTH);
 		img += 2*LEP_WIDTH;
 	}
+	render_strip_end();
 }
 
 
-static void render_double_agc_data(lep_buffer_t* lep, uint8_t* img)
+/**
+ * Linearly interpolate the lepton image into the display buffer in one pass.  Each
+ * lepton line is converted once by row_func into a small 8-bit line buffer and the
+ * two display lines between it and the previous lepton line are produced from them.
+ * Gives the same pixels as the four region passes described below.
+ *   row_func converts a lepton line to 8-bit values
+ *   n holds the per-frame constants for row_func (may be NULL if unused)
+ */
+static void render_interp_data(lep_buffer_t* lep, uint8_t* img, render_row_func_t row_func, const render_norm_t* n)
 {
-	int src_y;
-	uint16_t* ptr = lep->lep_bufferP;
+	uint8_t* P = render_row_buf[0];
+	uint8_t* Q = render_row_buf[1];
+	uint8_t* t;
+	int y;
 	
-	for (src_y=0; src_y<LEP_HEIGHT; src_y++) {
-		// Double each pixel in a source line into the destination buffer
-		while (ptr < (lep->lep_bufferP + ((src_y+1)*LEP_WIDTH))) {
-			*img++ = ((uint8_t) (*ptr   & 0xFF)) ^ render_palette_mod;
-			*img++ = ((uint8_t) (*ptr++ & 0xFF)) ^ render_palette_mod;
-		}
+	render_strip_begin();
+	
+	// Top row only depends on the first lepton line
+	row_func(render_strip_line(lep, 0), P, 0, n);
+	line_set_outer(P, img, render_palette_mod);
+	img += IMG_BUF_WIDTH;
+	
+	for (y=1; y<LEP_HEIGHT; y++) {
+		// Q holds lepton line y-1, P line y
+		t = Q;
+		Q = P;
+		P = t;
+		row_func(render_strip_line(lep, y), P, y, n);
 		
-		// Duplicate the destination buffer line
-		memcpy(img, img - 2*LEP_WIDTH, 2*LEP_WIDTH);
-		img += 2*LEP_WIDTH;
+		// Display line 2y-1 is closest to lepton line y-1, 2y to lepton line y
+		line_set_inner(Q, P, img, render_palette_mod);
+		img += IMG_BUF_WIDTH;
+		line_set_inner(P, Q, img, render_palette_mod);
+		img += IMG_BUF_WIDTH;
 	}
+	
+	// Bottom row
+	line_set_outer(P, img, render_palette_mod);
+	
+	render_strip_end();
 }
 
 
-static void render_interp_rad_data(lep_buffer_t* lep, uint8_t* img, gui_state_t* g)
+/**
+ * Scale the lepton image into the display buffer using the tables from
+ * render_set_image_size().  Each lepton line used is converted by row_func and
+ * horizontally scaled once into one of four line buffers (selected by the line
+ * number modulo 4 since an output row uses at most four consecutive lepton lines),
+ * then each output row is a vertical combination of two or four of them.
+ *   row_func converts a lepton line to 8-bit values
+ *   n holds the per-frame constants for row_func
+ */
+static void render_scaled_data(lep_buffer_t* lep, uint8_t* img, render_row_func_t row_func, const render_norm_t* n)
 {
-	uint16_t* lepP = lep->lep_bufferP;
-	uint32_t t32;
-	uint16_t min_val, max_val;
-	uint32_t diff;
+	const render_scale_tap_t* t = render_scale_row;
+	int i, ly, y;
 	
-	// Dynamic range from image
-	min_val = lep->lep_min_val;
-	max_val = lep->lep_max_val;
-	diff = max_val - min_val;
-	if (diff == 0) diff = 1;
-	 
-	// Linearize the 16-bit data into 8-bits in the lep buffer
-	do {
-		if (*lepP < min_val) {
-			*lepP = 0;
+	for (i=0; i<4; i++) {
+		render_scale_hbuf_line[i] = -1;
+	}
+	
+	render_strip_begin();
+	for (y=0; y<render_img_height; y++) {
+		for (i=0; i<render_scale_taps; i++) {
+			ly = t->idx[i];
+			if (render_scale_hbuf_line[ly & 3] != ly) {
+				row_func(render_strip_line(lep, ly), render_row_buf[0], ly, n);
+				render_scale_hline(render_row_buf[0], render_scale_hbuf[ly & 3]);
+				render_scale_hbuf_line[ly & 3] = ly;
+			}
+		}
+	
+		render_scale_vline(t, img);
+		img += render_img_width;
+		t++;
+	}
+	render_strip_end();
+}
+
+
+/**
+ * Start a pass over the lepton image through the internal RAM strip buffer
+ */
+static void render_strip_begin()
+{
+	render_strip_y = -1;
+#ifdef RENDER_STRIP_STATS
+	strip_t0 = esp_cpu_get_ccount();
+#endif
+}
+
+
+/**
+ * Return a pointer to lepton line y in the strip buffer, first copying the strip
+ * containing it from the lepton buffer if necessary.  Lines must be requested in
+ * increasing order during a pass so each strip is copied once as one linear read
+ * of SPIRAM instead of the row stages reading it through the cache.
+ */
+static const uint16_t* render_strip_line(lep_buffer_t* lep, int y)
+{
+#ifdef RENDER_STRIP_STATS
+	uint32_t t;
+#endif
+	
+	if ((render_strip_y < 0) || (y >= render_strip_y + RENDER_STRIP_LINES)) {
+#ifdef RENDER_STRIP_STATS
+		t = esp_cpu_get_ccount();
+		if (render_strip_y >= 0) {
+			strip_render_cycles[render_strip_y / RENDER_STRIP_LINES] += t - strip_t0;
+		}
+#endif
+		render_strip_y = y - (y % RENDER_STRIP_LINES);
+		memcpy(render_strip_buf, lep->lep_bufferP + render_strip_y*LEP_WIDTH, sizeof(render_strip_buf));
+#ifdef RENDER_STRIP_STATS
+		strip_t0 = esp_cpu_get_ccount();
+		strip_copy_cycles[render_strip_y / RENDER_STRIP_LINES] += strip_t0 - t;
+#endif
+	}
+	
+	return render_strip_buf + (y - render_strip_y)*LEP_WIDTH;
+}
+
+
+/**
+ * End a pass over the lepton image.  Logs the average strip copy and render times
+ * every RENDER_BENCHMARK_FRAMES passes when RENDER_STRIP_STATS is defined.
+ */
+static void render_strip_end()
+{
+#ifdef RENDER_STRIP_STATS
+	uint32_t copy_sum = 0;
+	uint32_t render_sum = 0;
+	int i;
+	
+	if (render_strip_y >= 0) {
+		strip_render_cycles[render_strip_y / RENDER_STRIP_LINES] += esp_cpu_get_ccount() - strip_t0;
+	}
+	
+	if (++strip_frames == RENDER_BENCHMARK_FRAMES) {
+		for (i=0; i<RENDER_NUM_STRIPS; i++) {
+			ESP_LOGI(TAG, "Strip %2d: copy %u cycles, render %u cycles", i,
+			         strip_copy_cycles[i] / strip_frames, strip_render_cycles[i] / strip_frames);
+			copy_sum += strip_copy_cycles[i];
+			render_sum += strip_render_cycles[i];
+			strip_copy_cycles[i] = 0;
+			strip_render_cycles[i] = 0;
+		}
+		ESP_LOGI(TAG, "Strips: copy %u uS, render %u uS per frame",
+		         copy_sum / strip_frames / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+		         render_sum / strip_frames / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+		strip_frames = 0;
+	}
+#endif
+}
+
+
+/**
+ * Compute the lepton pixels and weights for each output column or row.  Output
+ * pixel i is centered at lepton coordinate src_x0 + (i + 1/2) * src_w / len - 1/2.
+ * Taps past the edge of the lepton image use the edge pixel.
+ *   taps points to len entries to fill
+ *   src_x0, src_w are the 16.16 lepton coordinates of the first edge and the span
+ *   src_len is the lepton image dimension
+ *   kernel selects bilinear (2 taps) or Catmull-Rom bicubic (4 taps) weights
+ */
+static void render_scale_set_taps(render_scale_tap_t* taps, int len, int32_t src_x0, int32_t src_w, int src_len, render_kernel_t kernel)
+{
+	int64_t p, t, t2, t3;
+	int i, j, k;
+	
+	for (i=0; i<len; i++) {
+		p = src_x0 + ((int64_t) (2*i + 1) * src_w) / (2*len) - 0x8000;
+		j = (int) (p >> 16);
+		t = (p >> 8) & 0xFF;           // 8-bit fraction
+	
+		if (kernel == RENDER_KERNEL_BICUBIC) {
+			// Catmull-Rom weights computed with 24 fraction bits, rounded to 8 and
+			// the center weight adjusted so they sum to 256
+			t2 = t * t;
+			t3 = t2 * t;
+			taps[i].w[0] = (int16_t) ((-t3 + 2*256*t2 - 65536*t + 65536) >> 17);
+			taps[i].w[2] = (int16_t) ((-3*t3 + 4*256*t2 + 65536*t + 65536) >> 17);
+			taps[i].w[3] = (int16_t) ((t3 - 256*t2 + 65536) >> 17);
+			taps[i].w[1] = 256 - taps[i].w[0] - taps[i].w[2] - taps[i].w[3];
+			j--;
 		} else {
-			t32 = ((uint32_t)(*lepP - min_val) * 255) / diff;
-			*lepP = (t32 > 255) ? 255 : (uint8_t) t32;
+			taps[i].w[0] = 256 - t;
+			taps[i].w[1] = t;
+			taps[i].w[2] = 0;
+			taps[i].w[3] = 0;
 		}
-	} while (++lepP < (lep->lep_bufferP + LEP_WIDTH*LEP_HEIGHT));
 	
-	// Render 8-bit data
-	render_interp_agc_data(lep->lep_bufferP, img);
+		for (k=0; k<4; k++) {
+			taps[i].idx[k] = (j+k < 0) ? 0 : ((j+k >= src_len) ? src_len-1 : j+k);
+		}
+	}
 }
 
 
-static void render_interp_agc_data(uint16_t* buf, uint8_t* img)
+/**
+ * Horizontally scale an 8-bit lepton line into a line buffer (6 fraction bits)
+ */
+static void render_scale_hline(const uint8_t* src, int16_t* dst)
 {
-	// Corner pixels
-	interp_set_pixel(*buf, img, 0, 0);
-	interp_set_pixel(*(buf + (LEP_WIDTH-1)), img, 2*LEP_WIDTH-1, 0);
-	interp_set_pixel(*(buf + LEP_WIDTH*(LEP_HEIGHT-1)), img, 0, 2*LEP_HEIGHT-1);
-	interp_set_pixel(*(buf + LEP_WIDTH*(LEP_HEIGHT-1) + (LEP_WIDTH-1)), img, 2*LEP_WIDTH-1, 2*LEP_HEIGHT-1);
+	const render_scale_tap_t* t = render_scale_col;
+	const int16_t* dstEndP = dst + render_img_width;
 	
-	// Top/Bottom rows
-	interp_set_outer_row(buf, img, true);
-	interp_set_outer_row(buf, img, false);
+	if (render_scale_taps == 2) {
+		while (dst < dstEndP) {
+			*dst++ = (t->w[0]*src[t->idx[0]] + t->w[1]*src[t->idx[1]]) >> 2;
+			t++;
+		}
+	} else {
+		while (dst < dstEndP) {
+			*dst++ = (t->w[0]*src[t->idx[0]] + t->w[1]*src[t->idx[1]] +
+			          t->w[2]*src[t->idx[2]] + t->w[3]*src[t->idx[3]]) >> 2;
+			t++;
+		}
+	}
+}
+
+
+/**
+ * Vertically combine the horizontally scaled lines for one output row
+ *   t holds the row's lepton lines and weights
+ */
+static void render_scale_vline(const render_scale_tap_t* t, uint8_t* img)
+{
+	const int16_t* h0 = render_scale_hbuf[t->idx[0] & 3];
+	const int16_t* h1 = render_scale_hbuf[t->idx[1] & 3];
+	const int16_t* h2 = render_scale_hbuf[t->idx[2] & 3];
+	const int16_t* h3 = render_scale_hbuf[t->idx[3] & 3];
+	const uint8_t* imgEndP = img + render_img_width;
+	int32_t w0 = t->w[0];
+	int32_t w1 = t->w[1];
+	int32_t w2 = t->w[2];
+	int32_t w3 = t->w[3];
+	int32_t v;
 	
-	// Left/Right columns
-	interp_set_outer_col(buf, img, true);
-	interp_set_outer_col(buf, img, false);
+	if (render_scale_taps == 2) {
+		while (img < imgEndP) {
+			v = (w0 * *h0++ + w1 * *h1++ + 0x2000) >> 14;
+			*img++ = ((uint8_t) v) ^ render_palette_mod;
+		}
+	} else {
+		while (img < imgEndP) {
+			// Bicubic overshoots at edges
+			v = (w0 * *h0++ + w1 * *h1++ + w2 * *h2++ + w3 * *h3++ + 0x2000) >> 14;
+			if (v < 0) v = 0;
+			if (v > 255) v = 255;
+			*img++ = ((uint8_t) v) ^ render_palette_mod;
+		}
+	}
+}
+
+
+/**
+ * Free the scaler tables
+ */
+static void render_scale_free()
+{
+	int i;
 	
-	// Inner pixels
-	interp_set_inner(buf, img);
+	render_scaler_enabled = false;
+	heap_caps_free(render_scale_col);
+	heap_caps_free(render_scale_row);
+	render_scale_col = NULL;
+	render_scale_row = NULL;
+	for (i=0; i<4; i++) {
+		heap_caps_free(render_scale_hbuf[i]);
+		render_scale_hbuf[i] = NULL;
+	}
 }
 
 
-static void render_min_marker(lep_buffer_t* lep, uint8_t* img)
+/**
+ * Display image coordinates of the center of a lepton pixel
+ */
+static int16_t render_map_x(int x)
 {
-	int16_t x1, xm, x2, y1, y2;
+	return (int16_t) (((((((int64_t) x) << 16) + 0x8000 - render_src_x0) * 2 * render_img_width) / render_src_w - 1) >> 1);
+}
+
+
+static int16_t render_map_y(int y)
+{
+	return (int16_t) (((((((int64_t) y) << 16) + 0x8000 - render_src_y0) * 2 * render_img_height) / render_src_h - 1) >> 1);
+}
+
+
+/**
+ * Select the row stage for the image and compute its per-frame constants
+ *  - AGC data from the lepton is used directly
+ *  - Radiometric data is histogram equalized (globally or per tile when SYS_HEQ_CLAHE is
+ *    defined) when the lepton buffer has a histogram, otherwise linearly scaled between
+ *    the image min and max
+ */
+static render_row_func_t render_row_setup(lep_buffer_t* lep, gui_state_t* g, render_norm_t* n)
+{
+	if (g->agc_enabled) {
+		return render_agc_row;
+	} else if (lep->hist_valid) {
+#ifdef SYS_HEQ_CLAHE
+		render_clahe_setup(lep, n);
+		return render_clahe_row;
+#else
+		render_heq_setup(lep, n);
+		return render_heq_row;
+#endif
+	} else {
+		render_norm_setup(lep, n);
+		return render_norm_row;
+	}
+}
+
+
+/**
+ * Compute the per-frame scaling constants from the image dynamic range
+ */
+static void render_norm_setup(lep_buffer_t* lep, render_norm_t* n)
+{
+	n->min_val = lep->lep_min_val;
+	n->diff = lep->lep_max_val - n->min_val;
+	if (n->diff == 0) n->diff = 1;
 	
-	// Compute a bounding box around the marker triangle
-	x1 = lep->lep_min_x * IMG_BUF_MULT_FACTOR - (IMG_MM_MARKER_SIZE/2);
-	xm = lep->lep_min_x * IMG_BUF_MULT_FACTOR;
-	x2 = x1 + IMG_MM_MARKER_SIZE;
-	y1 = lep->lep_min_y * IMG_BUF_MULT_FACTOR - (IMG_MM_MARKER_SIZE/2);
-	y2 = y1 + IMG_MM_MARKER_SIZE;
+	// recip = 255 * 2^(32-pre_shift) / diff rounded up, exact when 2^(32-pre_shift) >= diff^2
+	n->pre_shift = (n->diff < 256) ? 16 : 0;
+	n->recip = (uint32_t) (((uint64_t) 255 << (32 - n->pre_shift)) / n->diff) + 1;
+}
+
+
+/**
+ * Build the histogram equalization mapping from the lepton buffer's histogram
+ *  - SYS_HEQ_CLIP_LIMIT pixels are removed from each end of the histogram
+ *  - Each bin is then limited to SYS_HEQ_PLATEAU counts
+ *  - Each bin maps to the midpoint of its range in the cumulative histogram so
+ *    unused bins below the image go to 0 and above it to 255
+ */
+static void render_heq_setup(lep_buffer_t* lep, render_norm_t* n)
+{
+	uint32_t clip;
+	uint32_t cum;
+	uint32_t total;
+	uint16_t t16;
+	int i;
 	
-	// Draw a white downward facing triangle surrounded by a black triangle for contrast
-	draw_hline(img, x1, x2, y1, 0xFF);
-	draw_line(img, x1, y1, xm, y2, 0xFF);
-	draw_line(img, xm, y2, x2, y1, 0xFF);
+	memcpy(render_heq_hist, lep->lep_hist, sizeof(render_heq_hist));
 	
-	x1--;
-	y1--;
-	x2++;
-	y2++;
+	// Ignore outliers at each end
+	clip = SYS_HEQ_CLIP_LIMIT;
+	for (i=0; (i<LEP_HIST_BINS) && (clip != 0); i++) {
+		t16 = (render_heq_hist[i] < clip) ? render_heq_hist[i] : clip;
+		render_heq_hist[i] -= t16;
+		clip -= t16;
+	}
+	clip = SYS_HEQ_CLIP_LIMIT;
+	for (i=LEP_HIST_BINS-1; (i>=0) && (clip != 0); i--) {
+		t16 = (render_heq_hist[i] < clip) ? render_heq_hist[i] : clip;
+		render_heq_hist[i] -= t16;
+		clip -= t16;
+	}
+	
+	// Plateau
+	total = 0;
+	for (i=0; i<LEP_HIST_BINS; i++) {
+		if (render_heq_hist[i] > SYS_HEQ_PLATEAU) {
+			render_heq_hist[i] = SYS_HEQ_PLATEAU;
+		}
+		total += render_heq_hist[i];
+	}
 	
-	draw_hline(img, x1, x2, y1, 0x00);
-	draw_line(img, x1, y1, xm, y2, 0x00);
-	draw_line(img, xm, y2, x2, y1, 0x00);
+	// Mapping
+	if (total == 0) {
+		// Uniform image
+		for (i=0; i<LEP_HIST_BINS; i++) {
+			render_heq_lut[i] = (uint8_t) (i * 255 / (LEP_HIST_BINS - 1));
+		}
+	} else {
+		cum = 0;
+		for (i=0; i<LEP_HIST_BINS; i++) {
+			render_heq_lut[i] = (uint8_t) (((2*cum + render_heq_hist[i]) * 255 + total) / (2*total));
+			cum += render_heq_hist[i];
+		}
+	}
+	
+	render_bin_setup(lep, n);
+	n->lut = render_heq_lut;
 }
 
 
-static void render_max_marker(lep_buffer_t* lep, uint8_t* img)
+/**
+ * Setup to convert pixels to their histogram bin using the lepton buffer's binning
+ */
+static void render_bin_setup(lep_buffer_t* lep, render_norm_t* n)
 {
-	int16_t x1, xm, x2, y1, y2;
+	n->min_val = lep->lep_hist_min_val;
+	n->hist_range = lep->lep_hist_range;
+	n->hist_scale = lep->lep_hist_scale;
+}
+
+
+#ifdef SYS_HEQ_CLAHE
+/**
+ * Build the contrast limited adaptive histogram equalization mappings.  Tiles work
+ * on the globally equalized image so the clip limit bounds the contrast added to
+ * that (tiles of linearly scaled data would get little contrast where a large
+ * temperature split compresses them).  Tiles are histogrammed one row of tiles
+ * at a time.
+ */
+static void render_clahe_setup(lep_buffer_t* lep, render_norm_t* n)
+{
+	const uint16_t* src = lep->lep_bufferP;
+	uint8_t* heqP;
+	uint16_t* histP;
+	int tx, ty;
+	int x, y;
 	
-	// Compute a bounding box around the marker triangle
-	x1 = lep->lep_max_x * IMG_BUF_MULT_FACTOR - (IMG_MM_MARKER_SIZE/2);
-	xm = lep->lep_max_x * IMG_BUF_MULT_FACTOR;
-	x2 = x1 + IMG_MM_MARKER_SIZE;
-	y1 = lep->lep_max_y * IMG_BUF_MULT_FACTOR - (IMG_MM_MARKER_SIZE/2);
-	y2 = y1 + IMG_MM_MARKER_SIZE;
+	render_heq_setup(lep, n);
 	
-	// Draw a white upward facing triangle surrounded by a black triangle for contrast
-	draw_hline(img, x1, x2, y2, 0xFF);
-	draw_line(img, x1, y2, xm, y1, 0xFF);
-	draw_line(img, xm, y1, x2, y2, 0xFF);
+	render_clahe_set_weights(render_clahe_x_wt, LEP_WIDTH, SYS_CLAHE_TILES_X, CLAHE_TILE_W);
+	render_clahe_set_weights(render_clahe_y_wt, LEP_HEIGHT, SYS_CLAHE_TILES_Y, CLAHE_TILE_H);
 	
-	x1--;
-	y1--;
-	x2++;
-	y2++;
+	for (ty=0; ty<SYS_CLAHE_TILES_Y; ty++) {
+		memset(render_clahe_hist, 0, sizeof(render_clahe_hist));
+		
+		for (y=0; y<CLAHE_TILE_H; y++) {
+			render_heq_row(src, render_row_buf[0], 0, n);
+			heqP = render_row_buf[0];
+			for (tx=0; tx<SYS_CLAHE_TILES_X; tx++) {
+				histP = render_clahe_hist[tx];
+				for (x=0; x<CLAHE_TILE_W; x++) {
+					histP[*heqP++]++;
+				}
+			}
+			src += LEP_WIDTH;
+		}
+		
+		for (tx=0; tx<SYS_CLAHE_TILES_X; tx++) {
+			render_clahe_tile_lut(render_clahe_hist[tx], render_clahe_lut[ty][tx]);
+		}
+	}
+}
+
+
+/**
+ * Compute the blend between the two tiles whose centers are on either side of each
+ * pixel in a row or column.  Pixels outside the outer tile centers only use that tile.
+ *   len is the number of pixels
+ *   tiles is the number of tiles
+ *   tile_size is the tile dimension in pixels
+ */
+static void render_clahe_set_weights(render_clahe_wt_t* wt, int len, int tiles, int tile_size)
+{
+	int i;
+	int p;
 	
-	draw_hline(img, x1, x2, y2, 0x00);
-	draw_line(img, x1, y2, xm, y1, 0x00);
-	draw_line(img, xm, y1, x2, y2, 0x00);
+	for (i=0; i<len; i++) {
+		// Pixel center relative to the first tile center in half-pixels
+		p = 2*i + 1 - tile_size;
+		if (p <= 0) {
+			wt[i].t0 = 0;
+			wt[i].t1 = 0;
+			wt[i].w = 0;
+		} else if ((p / (2*tile_size)) >= (tiles - 1)) {
+			wt[i].t0 = tiles - 1;
+			wt[i].t1 = tiles - 1;
+			wt[i].w = 0;
+		} else {
+			wt[i].t0 = p / (2*tile_size);
+			wt[i].t1 = wt[i].t0 + 1;
+			wt[i].w = ((p % (2*tile_size)) * 256) / (2*tile_size);
+		}
+	}
 }
 
 
+/**
+ * Make one tile's mapping from its histogram.  Bins are limited to SYS_CLAHE_CLIP_LIMIT
+ * times the average bin count and the excess spread evenly over all bins before
+ * equalizing so uniform regions don't get their noise stretched.
+ */
+static void render_clahe_tile_lut(uint16_t* hist, uint8_t* lut)
+{
+	uint32_t clip;
+	uint32_t excess;
+	uint32_t inc;
+	uint32_t rem;
+	uint32_t cum;
+	int i;
+	
+	clip = (SYS_CLAHE_CLIP_LIMIT * CLAHE_TILE_PIXELS) / LEP_HIST_BINS;
+	if (clip == 0) clip = 1;
+	
+	excess = 0;
+	for (i=0; i<LEP_HIST_BINS; i++) {
+		if (hist[i] > clip) {
+			excess += hist[i] - clip;
+			hist[i] = clip;
+		}
+	}
+	
+	// Redistribute, spreading the remainder evenly across the bins
+	inc = excess / LEP_HIST_BINS;
+	rem = excess % LEP_HIST_BINS;
+	for (i=0; i<LEP_HIST_BINS; i++) {
+		hist[i] += inc + ((i+1)*rem / LEP_HIST_BINS) - (i*rem / LEP_HIST_BINS);
+	}
+	
+	// Each bin maps to the midpoint of its range in the cumulative histogram (which
+	// still totals CLAHE_TILE_PIXELS)
+	cum = 0;
+	for (i=0; i<LEP_HIST_BINS; i++) {
+		lut[i] = (uint8_t) (((2*cum + hist[i]) * 255 + CLAHE_TILE_PIXELS) / (2*CLAHE_TILE_PIXELS));
+		cum += hist[i];
+	}
+}
+#endif
 
-/******
- *
- * Linear Interpolation Pixel Doubler
- *
- * Each source pixel is broken into 4 sub-pixels (a-d), shown below.  Each sub-
- * pixel value is based primarily by its source pixel value plus contribution from 
- * surrounding source pixels.  Four source pixels (A-D) are shown.
- *
- *      +---+---+ +---+---+
- *      | a | b | | a | b |
- *      +---A---+ +---B---+
- *      | c | d | | c | d |
- *      +---+---+ +---+---+
- *
- *      +---+---+ +---+---+
- *      | a | b | | a | b |
- *      +---C---+ +---D---+
- *      | c | d | | c | d |
- *      +---+---+ +---+---+
- * 
- * There are three cases to calculate:
- *   1. The four corners of the source array (Aa, Bb, Cc, and Dd here)
- *      - These are simply set to the value of the source pixel (A, B, C and D)
- *   2. The outer edges of the source array (Ab, Ba, Ac, Bd, Ca, Db, Dc, Dc)
- *      - The sub-pixel value is based on two source pixels (the owning pixel and its neighbor)
- *      - The owning pixel contributes more to the sub-pixel by a Scale Factor (SF)
- *      - The sub-pixel = (SF * Owning Pixel + Neighbor Pixel) / DIV
- *      - The divisor scales the sum back to 8-bits = SF + 1
- *   3. The inner sub-pixels (Ad, Bc, Cb, Da)
- *      - The sub-pixel value is based on four source pixels (the owning pixel and its neighbors)
- *      - The owning pixel contributes more to the sub-pixel by a Scale Factor (SF)
- *      - The sub-pixel = (SF * Owning Pixel + 3 Neighbor Pixels) / DIV
- *      - The divisor scales the sum back to 8-bits = SF + 3
- *
+
+/**
+ * Row stage for radiometric data: linearly scale a lepton line to 8-bits between
+ * the image min and max.  Gives the same values as dividing each pixel by diff.
  */
- 
- 
+static void render_norm_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n)
+{
+	const uint8_t* dstEndP = dst + LEP_WIDTH;
+	
+	while (dst < dstEndP) {
+		*dst++ = render_norm_pixel(*src++, n);
+	}
+}
+
+
+/**
+ * Linearly scale one radiometric pixel to 8-bits (the per-pixel part of render_norm_row)
+ */
+static __inline__ uint8_t render_norm_pixel(uint32_t v, const render_norm_t* n)
+{
+	if (v < n->min_val) {
+		return 0;
+	} else if ((v -= n->min_val) >= n->diff) {
+		return 255;
+	} else {
+		return (uint8_t) (((uint64_t) (v << n->pre_shift) * n->recip) >> 32);
+	}
+}
+
+
+/**
+ * Convert a lepton line to histogram bins, binned the same way as vospi_get_frame()
+ */
+static void render_bin_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n)
+{
+	const uint8_t* dstEndP = dst + LEP_WIDTH;
+	uint32_t v;
+	
+	while (dst < dstEndP) {
+		v = *src++;
+		v = (v < n->min_val) ? 0 : v - n->min_val;
+		if (v > n->hist_range) v = n->hist_range;
+		*dst++ = (uint8_t) ((v * n->hist_scale) >> 16);
+	}
+}
+
+
+/**
+ * Row stage for histogram equalized radiometric data: look up each pixel's bin
+ */
+static void render_heq_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n)
+{
+	const uint8_t* dstEndP = dst + LEP_WIDTH;
+	
+	render_bin_row(src, dst, y, n);
+	while (dst < dstEndP) {
+		*dst = n->lut[*dst];
+		dst++;
+	}
+}
+
+
+#ifdef SYS_HEQ_CLAHE
+/**
+ * Row stage for CLAHE: bilinearly blend the mappings of the four nearest tiles
+ * for each globally equalized pixel
+ */
+static void render_clahe_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n)
+{
+	const render_clahe_wt_t* xw = render_clahe_x_wt;
+	uint8_t (*lut0)[LEP_HIST_BINS] = render_clahe_lut[render_clahe_y_wt[y].t0];
+	uint8_t (*lut1)[LEP_HIST_BINS] = render_clahe_lut[render_clahe_y_wt[y].t1];
+	uint32_t wy = render_clahe_y_wt[y].w;
+	uint32_t top, bot;
+	uint8_t v;
+	int x;
+	
+	render_heq_row(src, dst, y, n);
+	for (x=0; x<LEP_WIDTH; x++) {
+		v = dst[x];
+		top = lut0[xw->t0][v] * (256 - xw->w) + lut0[xw->t1][v] * xw->w;
+		bot = lut1[xw->t0][v] * (256 - xw->w) + lut1[xw->t1][v] * xw->w;
+		dst[x] = (uint8_t) ((top * (256 - wy) + bot * wy + 0x8000) >> 16);
+		xw++;
+	}
+}
+#endif
+
+
+/**
+ * Row stage for AGC data: the lepton already output 8-bit values
+ */
+static void render_agc_row(const uint16_t* src, uint8_t* dst, int y, const render_norm_t* n)
+{
+	const uint8_t* dstEndP = dst + LEP_WIDTH;
+	
+	while (dst < dstEndP) {
+		*dst++ = (uint8_t) (*src++ & 0xFF);
+	}
+}
+
+
+#ifdef RENDER_BENCHMARK
+/**
+ * Log the average time to render an image every RENDER_BENCHMARK_FRAMES frames.
+ * Interpolated linear and AGC images are also rendered by the previous multi-pass
+ * path on a copy of the lepton image, timed and compared with the single pass result.
+ */
+static void render_benchmark(lep_buffer_t* lep, uint8_t* img, gui_state_t* g, render_row_func_t row_func, uint32_t cycles)
+{
+	lep_buffer_t bench_lep;
+	const char* name;
+	bool has_ref;
+	uint32_t t;
+	
+	has_ref = !render_scaler_enabled && g->display_interp_enable && ((row_func == render_norm_row) || (row_func == render_agc_row));
+	
+	if (has_ref && (bench_lepP == NULL)) {
+		// Same memory types as the real buffers
+		bench_lepP = heap_caps_malloc(LEP_WIDTH*LEP_HEIGHT*sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+		bench_imgP = heap_caps_malloc(IMG_BUF_WIDTH*IMG_BUF_HEIGHT, MALLOC_CAP_INTERNAL);
+		if ((bench_lepP == NULL) || (bench_imgP == NULL)) {
+			ESP_LOGE(TAG, "Could not allocate benchmark buffers");
+			return;
+		}
+	}
+	
+	if (has_ref) {
+		// The previous path overwrites the lepton buffer so it gets a copy
+		memcpy(bench_lepP, lep->lep_bufferP, LEP_WIDTH*LEP_HEIGHT*sizeof(uint16_t));
+		bench_lep = *lep;
+		bench_lep.lep_bufferP = bench_lepP;
+		
+		t = esp_cpu_get_ccount();
+		if (g->agc_enabled) {
+			render_interp_agc_data_ref(bench_lep.lep_bufferP, bench_imgP);
+		} else {
+			render_interp_rad_data_ref(&bench_lep, bench_imgP, g);
+		}
+		bench_ref_cycles += esp_cpu_get_ccount() - t;
+		if (memcmp(img, bench_imgP, IMG_BUF_WIDTH*IMG_BUF_HEIGHT) != 0) {
+			bench_mismatch_frames++;
+		}
+	}
+	bench_cycles += cycles;
+	
+	if (++bench_frames == RENDER_BENCHMARK_FRAMES) {
+		if (row_func == render_agc_row) {
+			name = "AGC";
+		} else if (row_func == render_norm_row) {
+			name = "radiometric";
+#ifdef SYS_HEQ_CLAHE
+		} else if (row_func == render_clahe_row) {
+			name = "CLAHE";
+#endif
+		} else {
+			name = "HEQ";
+		}
+		
+		if (has_ref) {
+			ESP_LOGI(TAG, "Interpolate %s: single pass %u cycles (%u uS), multi-pass %u cycles, %u frames differ",
+			         name, bench_cycles / bench_frames, bench_cycles / bench_frames / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+			         bench_ref_cycles / bench_frames, bench_mismatch_frames);
+		} else {
+			ESP_LOGI(TAG, "%s %s: %u cycles (%u uS)", render_scaler_enabled ? "Scale" : (g->display_interp_enable ? "Interpolate" : "Double"),
+			         name, bench_cycles / bench_frames, bench_cycles / bench_frames / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+		}
+		bench_frames = 0;
+		bench_cycles = 0;
+		bench_ref_cycles = 0;
+		bench_mismatch_frames = 0;
+	}
+}
+
+
+/**
+ * Log the average time for render_spotmeter() every RENDER_BENCHMARK_FRAMES calls along
+ * with the time for its text box from the text cache, drawn from the glyph atlas and
+ * drawn by the previous bit at a time renderer.
+ */
+static void render_benchmark_spotmeter(const char* s, uint32_t cycles, uint32_t text_cycles)
+{
+	render_canvas_t cv = render_cv;
+	const render_atlas_t* a = render_atlas_get(&Digits8x16);
+	int16_t w = get_string_width(s, &Digits8x16) + 2;
+	int16_t h = Digits8x16.font_Height + 2;
+	uint32_t t;
+	
+	if ((a == NULL) || (w*h > RENDER_TEXT_CACHE_BYTES)) return;
+	
+	t = esp_cpu_get_ccount();
+	render_text_raster(s, strlen(s), a, bench_text_buf, w, h);
+	bench_text_atlas_cycles += esp_cpu_get_ccount() - t;
+	
+	render_cv.buf = bench_text_buf;
+	render_cv.x0 = 0;
+	render_cv.y0 = 0;
+	render_cv.w = w;
+	render_cv.h = h;
+	t = esp_cpu_get_ccount();
+	draw_fill_rect(0, 0, w, h, TEXT_BG_COLOR);
+	draw_string(1, 1, s, &Digits8x16);
+	bench_text_ref_cycles += esp_cpu_get_ccount() - t;
+	render_cv = cv;
+	
+	bench_spot_cycles += cycles;
+	bench_text_cycles += text_cycles;
+	
+	if (++bench_spot_calls == RENDER_BENCHMARK_FRAMES) {
+		ESP_LOGI(TAG, "Spotmeter: %u cycles, text box %u cycles (atlas %u, bit at a time %u)",
+		         bench_spot_cycles / bench_spot_calls, bench_text_cycles / bench_spot_calls,
+		         bench_text_atlas_cycles / bench_spot_calls, bench_text_ref_cycles / bench_spot_calls);
+		bench_spot_calls = 0;
+		bench_spot_cycles = 0;
+		bench_text_cycles = 0;
+		bench_text_atlas_cycles = 0;
+		bench_text_ref_cycles = 0;
+	}
+}
+
+
+//
+// Previous multi-pass renderer, only kept to compare against
+//
+static void render_interp_rad_data_ref(lep_buffer_t* lep, uint8_t* img, gui_state_t* g)
+{
+	uint16_t* lepP = lep->lep_bufferP;
+	uint32_t t32;
+	uint16_t min_val, max_val;
+	uint32_t diff;
+	
+	// Dynamic range from image
+	min_val = lep->lep_min_val;
+	max_val = lep->lep_max_val;
+	diff = max_val - min_val;
+	if (diff == 0) diff = 1;
+	 
+	// Linearize the 16-bit data into 8-bits in the lep buffer
+	do {
+		if (*lepP < min_val) {
+			*lepP = 0;
+		} else {
+			t32 = ((uint32_t)(*lepP - min_val) * 255) / diff;
+			*lepP = (t32 > 255) ? 255 : (uint8_t) t32;
+		}
+	} while (++lepP < (lep->lep_bufferP + LEP_WIDTH*LEP_HEIGHT));
+	
+	// Render 8-bit data
+	render_interp_agc_data_ref(lep->lep_bufferP, img);
+}
+
+
+static void render_interp_agc_data_ref(uint16_t* buf, uint8_t* img)
+{
+	// Corner pixels
+	interp_set_pixel(*buf, img, 0, 0);
+	interp_set_pixel(*(buf + (LEP_WIDTH-1)), img, 2*LEP_WIDTH-1, 0);
+	interp_set_pixel(*(buf + LEP_WIDTH*(LEP_HEIGHT-1)), img, 0, 2*LEP_HEIGHT-1);
+	interp_set_pixel(*(buf + LEP_WIDTH*(LEP_HEIGHT-1) + (LEP_WIDTH-1)), img, 2*LEP_WIDTH-1, 2*LEP_HEIGHT-1);
+	
+	// Top/Bottom rows
+	interp_set_outer_row(buf, img, true);
+	interp_set_outer_row(buf, img, false);
+	
+	// Left/Right columns
+	interp_set_outer_col(buf, img, true);
+	interp_set_outer_col(buf, img, false);
+	
+	// Inner pixels
+	interp_set_inner(buf, img);
+}
+
+
 /**
  * Set a single pixel in the segment buffer
  *   d contains source buffer 8-bit value
@@ -521,45 +1621,536 @@ static void interp_set_inner(uint16_t* src, uint8_t* img)
 		img += 2*LEP_WIDTH + 2;
 	}
 }
+#endif
 
 
-static void draw_hline(uint8_t* img, int16_t x1, int16_t x2, int16_t y, uint8_t c)
+/**
+ * Add a filled rectangle to the overlay, clipped to the display image
+ */
+static void render_overlay_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t c)
 {
-	uint8_t* imgP;
+	render_ovl_list_t* l = render_ovl_buildP;
+	render_ovl_elem_t* e;
+	
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	if (x + w > render_img_width) w = render_img_width - x;
+	if (y + h > render_img_height) h = render_img_height - y;
+	if ((w <= 0) || (h <= 0) || (l->num_elems == RENDER_OVERLAY_MAX_ELEMENTS)) return;
+	
+	e = &l->elem[l->num_elems++];
+	e->x = x;
+	e->y = y;
+	e->w = w;
+	e->h = h;
+	e->c = c;
+	e->pixP = NULL;
+}
+
+
+/**
+ * Add a transparent sprite covering x, y, w, h to the overlay and make it the
+ * target of the draw functions.  Returns false if it is not visible or there is
+ * no room for it.
+ */
+static bool render_overlay_sprite(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+	render_ovl_list_t* l = render_ovl_buildP;
+	render_ovl_elem_t* e;
 	
-	if ((y < 0) || (y >= IMG_BUF_HEIGHT)) return;
+	if ((x + w <= 0) || (x >= render_img_width) || (y + h <= 0) || (y >= render_img_height)) return false;
+	if ((l->num_elems == RENDER_OVERLAY_MAX_ELEMENTS) || ((l->pool_used + w*h) > RENDER_OVERLAY_POOL_BYTES)) return false;
 	
-	imgP = img + y*IMG_BUF_WIDTH + x1;
+	render_cv.buf = &l->pool[l->pool_used];
+	render_cv.x0 = x;
+	render_cv.y0 = y;
+	render_cv.w = w;
+	render_cv.h = h;
+	memset(render_cv.buf, RENDER_OVERLAY_CLEAR, w*h);
+	l->pool_used += w*h;
 	
-	while (x1 <= x2) {
-		if ((x1 >= 0) && (x1 < IMG_BUF_WIDTH)) {
-			*imgP = c;
+	e = &l->elem[l->num_elems++];
+	e->x = x;
+	e->y = y;
+	e->w = w;
+	e->h = h;
+	e->pixP = render_cv.buf;
+	
+	return true;
+}
+
+
+/**
+ * Composite the part of an overlay element on display line y (which it covers)
+ */
+static void IRAM_ATTR render_overlay_elem_line(const render_ovl_elem_t* e, int y, uint8_t* line)
+{
+	const uint8_t* pixP;
+	uint8_t* lineP;
+	uint8_t* lineEndP;
+	int x1, x2;
+	
+	x1 = (e->x < 0) ? 0 : e->x;
+	x2 = (e->x + e->w > render_img_width) ? render_img_width : e->x + e->w;
+	lineP = line + x1;
+	lineEndP = line + x2;
+	
+	if (e->pixP == NULL) {
+		while (lineP < lineEndP) {
+			*lineP++ = e->c;
+		}
+	} else {
+		pixP = e->pixP + (y - e->y)*e->w + (x1 - e->x);
+		while (lineP < lineEndP) {
+			if (*pixP != RENDER_OVERLAY_CLEAR) {
+				*lineP = *pixP;
+			}
+			pixP++;
+			lineP++;
 		}
-		imgP++;
-		x1++;
 	}
 }
 
 
-static void draw_vline(uint8_t* img, int16_t x, int16_t y1, int16_t y2, uint8_t c)
+/**
+ * Add a text box, the string at x, y on a one pixel TEXT_BG_COLOR border, to the
+ * overlay.  The box is copied from the text cache, only drawing it from the glyph
+ * atlas when the string isn't there.
+ */
+static void render_overlay_text(int16_t x, int16_t y, const char* s, const Font_TypeDef* font)
 {
-	uint8_t* imgP;
+	const render_atlas_t* a;
+	render_text_cache_t* c = NULL;
+	int i, n;
 	
-	if ((x < 0) || (x >= IMG_BUF_WIDTH)) return;
+	n = render_text_length(s, font);
 	
-	imgP = img + y1*IMG_BUF_WIDTH + x;
+	for (i=0; i<RENDER_TEXT_CACHE_ENTRIES; i++) {
+		if ((render_text_cache[i].font == font) && (strncmp(render_text_cache[i].str, s, n) == 0) &&
+		    (render_text_cache[i].str[n] == 0)) {
+			c = &render_text_cache[i];
+			break;
+		}
+	}
 	
-	while (y1 <= y2) {
-		if ((y1 >= 0) && (y1 < IMG_BUF_HEIGHT)) {
-			*imgP = c;
+	if (c == NULL) {
+		// Replace the least recently used entry
+		if ((a = render_atlas_get(font)) == NULL) return;
+		c = &render_text_cache[0];
+		for (i=1; i<RENDER_TEXT_CACHE_ENTRIES; i++) {
+			if (render_text_cache[i].last_use < c->last_use) {
+				c = &render_text_cache[i];
+			}
 		}
-		imgP += IMG_BUF_WIDTH;
-		y1++;
+		c->font = font;
+		strncpy(c->str, s, n);
+		c->str[n] = 0;
+		c->w = n * a->cell_w + 2;
+		c->h = font->font_Height + 2;
+		render_text_raster(s, n, a, c->pix, c->w, c->h);
+	}
+	c->last_use = ++render_text_use_count;
+	
+	if (render_overlay_sprite(x-1, y-1, c->w, c->h)) {
+		memcpy(render_cv.buf, c->pix, c->w * c->h);
+	}
+}
+
+
+/**
+ * Expand a font into byte per pixel glyphs
+ */
+static bool render_atlas_build(render_atlas_t* a)
+{
+	const Font_TypeDef* font = a->font;
+	const uint8_t* fontP;
+	uint8_t* pixP;
+	uint8_t bits;
+	int c, x, y;
+	
+	if (a->pixP != NULL) return true;
+	
+	// The lepton buffers are already in SPIRAM and the atlas is only read when the
+	// text cache misses
+	a->cell_w = font->font_Width + 1;
+	a->pixP = heap_caps_malloc((font->font_MaxChar - font->font_MinChar + 1) * a->cell_w * font->font_Height, MALLOC_CAP_SPIRAM);
+	if (a->pixP == NULL) return false;
+	
+	// Both fonts have horizontal scan lines of 8 pixels or less (one byte per row, LSB first)
+	pixP = a->pixP;
+	for (c=font->font_MinChar; c<=font->font_MaxChar; c++) {
+		fontP = &font->font_Data[(c - font->font_MinChar) * font->font_BPC];
+		for (y=0; y<font->font_Height; y++) {
+			bits = *fontP++;
+			for (x=0; x<a->cell_w; x++) {
+				*pixP++ = ((x < font->font_Width) && (bits & (1 << x))) ? TEXT_COLOR : TEXT_BG_COLOR;
+			}
+		}
+	}
+	
+	return true;
+}
+
+
+static const render_atlas_t* render_atlas_get(const Font_TypeDef* font)
+{
+	int i;
+	
+	for (i=0; i<2; i++) {
+		if ((render_atlas[i].font == font) && (render_atlas[i].pixP != NULL)) {
+			return &render_atlas[i];
+		}
+	}
+	
+	return NULL;
+}
+
+
+/**
+ * Number of characters of s that fit in a text cache entry
+ */
+static int render_text_length(const char* s, const Font_TypeDef* font)
+{
+	int n = strlen(s);
+	int max_n = (RENDER_TEXT_CACHE_BYTES / (font->font_Height + 2) - 2) / (font->font_Width + 1);
+	
+	if (max_n > RENDER_TEXT_MAX_CHARS) max_n = RENDER_TEXT_MAX_CHARS;
+	
+	return (n < max_n) ? n : max_n;
+}
+
+
+/**
+ * Draw the first n characters of s into a w x h text box by copying glyph rows
+ * from the atlas
+ */
+static void render_text_raster(const char* s, int n, const render_atlas_t* a, uint8_t* pix, int16_t w, int16_t h)
+{
+	const Font_TypeDef* font = a->font;
+	const uint8_t* glyphP;
+	uint8_t* dstP;
+	uint8_t c;
+	int i, y;
+	
+	memset(pix, TEXT_BG_COLOR, w*h);
+	
+	for (i=0; i<n; i++) {
+		c = (uint8_t) s[i];
+		if ((c < font->font_MinChar) || (c > font->font_MaxChar)) c = font->font_UnknownChar;
+		glyphP = a->pixP + (c - font->font_MinChar) * a->cell_w * font->font_Height;
+		dstP = pix + w + 1 + i*a->cell_w;
+		for (y=0; y<font->font_Height; y++) {
+			memcpy(dstP, glyphP, a->cell_w);
+			glyphP += a->cell_w;
+			dstP += w;
+		}
+	}
+}
+
+
+static void render_min_marker(lep_buffer_t* lep)
+{
+	int16_t x1, xm, x2, y1, y2;
+	
+	// Compute a bounding box around the marker triangle
+	xm = render_map_x(lep->lep_min_x);
+	x1 = xm - (IMG_MM_MARKER_SIZE/2);
+	x2 = x1 + IMG_MM_MARKER_SIZE;
+	y1 = render_map_y(lep->lep_min_y) - (IMG_MM_MARKER_SIZE/2);
+	y2 = y1 + IMG_MM_MARKER_SIZE;
+	if (!render_overlay_sprite(x1-1, y1-1, IMG_MM_MARKER_SIZE+3, IMG_MM_MARKER_SIZE+3)) return;
+	
+	// Draw a white downward facing triangle surrounded by a black triangle for contrast
+	draw_hline(x1, x2, y1, 0xFF);
+	draw_line(x1, y1, xm, y2, 0xFF);
+	draw_line(xm, y2, x2, y1, 0xFF);
+	
+	x1--;
+	y1--;
+	x2++;
+	y2++;
+	
+	draw_hline(x1, x2, y1, 0x00);
+	draw_line(x1, y1, xm, y2, 0x00);
+	draw_line(xm, y2, x2, y1, 0x00);
+}
+
+
+static void render_max_marker(lep_buffer_t* lep)
+{
+	int16_t x1, xm, x2, y1, y2;
+	
+	// Compute a bounding box around the marker triangle
+	xm = render_map_x(lep->lep_max_x);
+	x1 = xm - (IMG_MM_MARKER_SIZE/2);
+	x2 = x1 + IMG_MM_MARKER_SIZE;
+	y1 = render_map_y(lep->lep_max_y) - (IMG_MM_MARKER_SIZE/2);
+	y2 = y1 + IMG_MM_MARKER_SIZE;
+	if (!render_overlay_sprite(x1-1, y1-1, IMG_MM_MARKER_SIZE+3, IMG_MM_MARKER_SIZE+3)) return;
+	
+	// Draw a white upward facing triangle surrounded by a black triangle for contrast
+	draw_hline(x1, x2, y2, 0xFF);
+	draw_line(x1, y2, xm, y1, 0xFF);
+	draw_line(xm, y1, x2, y2, 0xFF);
+	
+	x1--;
+	y1--;
+	x2++;
+	y2++;
+	
+	draw_hline(x1, x2, y2, 0x00);
+	draw_line(x1, y2, xm, y1, 0x00);
+	draw_line(xm, y1, x2, y2, 0x00);
+}
+
+
+
+/******
+ *
+ * Linear Interpolation Pixel Doubler
+ *
+ * Each source pixel is broken into 4 sub-pixels (a-d), shown below.  Each sub-
+ * pixel value is based primarily by its source pixel value plus contribution from 
+ * surrounding source pixels.  Four source pixels (A-D) are shown.
+ *
+ *      +---+---+ +---+---+
+ *      | a | b | | a | b |
+ *      +---A---+ +---B---+
+ *      | c | d | | c | d |
+ *      +---+---+ +---+---+
+ *
+ *      +---+---+ +---+---+
+ *      | a | b | | a | b |
+ *      +---C---+ +---D---+
+ *      | c | d | | c | d |
+ *      +---+---+ +---+---+
+ * 
+ * There are three cases to calculate:
+ *   1. The four corners of the source array (Aa, Bb, Cc, and Dd here)
+ *      - These are simply set to the value of the source pixel (A, B, C and D)
+ *   2. The outer edges of the source array (Ab, Ba, Ac, Bd, Ca, Db, Dc, Dc)
+ *      - The sub-pixel value is based on two source pixels (the owning pixel and its neighbor)
+ *      - The owning pixel contributes more to the sub-pixel by a Scale Factor (SF)
+ *      - The sub-pixel = (SF * Owning Pixel + Neighbor Pixel) / DIV
+ *      - The divisor scales the sum back to 8-bits = SF + 1
+ *   3. The inner sub-pixels (Ad, Bc, Cb, Da)
+ *      - The sub-pixel value is based on four source pixels (the owning pixel and its neighbors)
+ *      - The owning pixel contributes more to the sub-pixel by a Scale Factor (SF)
+ *      - The sub-pixel = (SF * Owning Pixel + 3 Neighbor Pixels) / DIV
+ *      - The divisor scales the sum back to 8-bits = SF + 3
+ *
+ */
+ 
+ 
+/**
+ * Render a top or bottom display line where each pixel only depends on
+ * contributions from two source pixels on the same line (matches interp_set_pixel
+ * and interp_set_outer_row).
+ *   P points to the source line
+ *   line points to the display line
+ *   mod is XORed into each display pixel (palette inversion)
+ */
+static IRAM_ATTR void line_set_outer(const uint8_t* P, uint8_t* line, uint8_t mod)
+{
+	line_set_outer_k(P, line, mod);
+}
+
+
+/**
+ * Render an inner display line from the closest source line P and the other source
+ * line Q (matches interp_set_outer_col and interp_set_inner).
+ *   P points to the closest source line
+ *   Q points to the other source line
+ *   line points to the display line
+ *   mod is XORed into each display pixel (palette inversion)
+ */
+static IRAM_ATTR void line_set_inner(const uint8_t* P, const uint8_t* Q, uint8_t* line, uint8_t mod)
+{
+	line_set_inner_k(P, Q, line, mod);
+}
+
+
+/**
+ * Always inlined bodies of line_set_outer() and line_set_inner() so the specialized
+ * renderers get them with a constant mod
+ */
+static __inline__ __attribute__((always_inline)) void line_set_outer_k(const uint8_t* P, uint8_t* line, uint8_t mod)
+{
+	int x;
+	uint8_t A, B;
+	
+	*line++ = *P ^ mod;
+	B = *P;
+	for (x=0; x<LEP_WIDTH-1; x++) {
+		A = B;
+		B = *++P;
+		*line++ = ((SF_DS*A + B) / DIV_DS) ^ mod;
+		*line++ = ((A + SF_DS*B) / DIV_DS) ^ mod;
+	}
+	*line = B ^ mod;
+}
+
+
+static __inline__ __attribute__((always_inline)) void line_set_inner_k(const uint8_t* P, const uint8_t* Q, uint8_t* line, uint8_t mod)
+{
+	int x;
+	uint8_t A, B, C, D;
+	
+	// Left column
+	*line++ = ((SF_DS*(*P) + *Q) / DIV_DS) ^ mod;
+	
+	B = *P;
+	D = *Q;
+	for (x=0; x<LEP_WIDTH-1; x++) {
+		A = B;
+		C = D;
+		B = *++P;
+		D = *++Q;
+		*line++ = ((SF_QS*A + B + C + D) / DIV_QS) ^ mod;
+		*line++ = ((A + SF_QS*B + C + D) / DIV_QS) ^ mod;
+	}
+	
+	// Right column
+	*line = ((SF_DS*B + D) / DIV_DS) ^ mod;
+}
+
+
+
+//
+// Specialized renderers
+//
+// The common white/black hot, double/interpolate and AGC/linear radiometric combinations
+// are each compiled as their own function so the pixel conversion and palette are
+// constants in the inner loops instead of a row stage call per line and a palette XOR
+// per pixel.  They give the same pixels as render_double_data() and render_interp_data().
+//
+#define RENDER_PIXEL_AGC(v, n)  ((uint8_t) ((v) & 0xFF))
+#define RENDER_PIXEL_NORM(v, n) render_norm_pixel((v), (n))
+
+// Pixel doubler: convert, apply the palette and write each pixel twice then duplicate the line
+#define RENDER_DOUBLE_VARIANT(name, PIXEL, MOD) \
+static void name(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n) \
+{ \
+	const uint16_t* src; \
+	const uint16_t* srcEndP; \
+	uint16_t* img16; \
+	int y; \
+	\
+	render_strip_begin(); \
+	for (y=0; y<LEP_HEIGHT; y++) { \
+		src = render_strip_line(lep, y); \
+		srcEndP = src + LEP_WIDTH; \
+		img16 = (uint16_t*) img; \
+		while (src < srcEndP) { \
+			*img16++ = ((uint8_t) (PIXEL(*src, n) ^ (MOD))) * 0x0101; \
+			src++; \
+		} \
+		memcpy(img + 2*LEP_WIDTH, img, 2*LEP_WIDTH); \
+		img += 4*LEP_WIDTH; \
+	} \
+	render_strip_end(); \
+}
+
+// Convert one lepton line into an 8-bit line buffer for the interpolator
+#define RENDER_VARIANT_ROW(src, dst, PIXEL, n) \
+	{ \
+		const uint16_t* s = (src); \
+		uint8_t* d = (dst); \
+		const uint8_t* dEndP = d + LEP_WIDTH; \
+		while (d < dEndP) { \
+			*d++ = PIXEL(*s, n); \
+			s++; \
+		} \
+	}
+
+// Linear interpolator: the same line order as render_interp_data()
+#define RENDER_INTERP_VARIANT(name, PIXEL, MOD) \
+static void name(lep_buffer_t* lep, uint8_t* img, const render_norm_t* n) \
+{ \
+	uint8_t* P = render_row_buf[0]; \
+	uint8_t* Q = render_row_buf[1]; \
+	uint8_t* t; \
+	int y; \
+	\
+	render_strip_begin(); \
+	RENDER_VARIANT_ROW(render_strip_line(lep, 0), P, PIXEL, n); \
+	line_set_outer_k(P, img, (MOD)); \
+	img += IMG_BUF_WIDTH; \
+	for (y=1; y<LEP_HEIGHT; y++) { \
+		t = Q; \
+		Q = P; \
+		P = t; \
+		RENDER_VARIANT_ROW(render_strip_line(lep, y), P, PIXEL, n); \
+		line_set_inner_k(Q, P, img, (MOD)); \
+		img += IMG_BUF_WIDTH; \
+		line_set_inner_k(P, Q, img, (MOD)); \
+		img += IMG_BUF_WIDTH; \
+	} \
+	line_set_outer_k(P, img, (MOD)); \
+	render_strip_end(); \
+}
+
+RENDER_DOUBLE_VARIANT(render_double_norm_wh, RENDER_PIXEL_NORM, 0x00)
+RENDER_DOUBLE_VARIANT(render_double_agc_wh,  RENDER_PIXEL_AGC,  0x00)
+RENDER_DOUBLE_VARIANT(render_double_norm_bh, RENDER_PIXEL_NORM, 0xFF)
+RENDER_DOUBLE_VARIANT(render_double_agc_bh,  RENDER_PIXEL_AGC,  0xFF)
+RENDER_INTERP_VARIANT(render_interp_norm_wh, RENDER_PIXEL_NORM, 0x00)
+RENDER_INTERP_VARIANT(render_interp_agc_wh,  RENDER_PIXEL_AGC,  0x00)
+RENDER_INTERP_VARIANT(render_interp_norm_bh, RENDER_PIXEL_NORM, 0xFF)
+RENDER_INTERP_VARIANT(render_interp_agc_bh,  RENDER_PIXEL_AGC,  0xFF)
+
+// Indexed by [black hot][interpolate][AGC]
+static const render_variant_func_t render_variants[2][2][2] = {
+	{{render_double_norm_wh, render_double_agc_wh}, {render_interp_norm_wh, render_interp_agc_wh}},
+	{{render_double_norm_bh, render_double_agc_bh}, {render_interp_norm_bh, render_interp_agc_bh}}
+};
+
+
+/**
+ * Select the specialized renderer and palette modifier when the palette, display
+ * mode or AGC setting changes
+ */
+static void render_variant_select(gui_state_t* g)
+{
+	int key = (g->black_hot_palette ? 4 : 0) | (g->display_interp_enable ? 2 : 0) | (g->agc_enabled ? 1 : 0);
+	
+	if (key != render_variant_key) {
+		render_variant_key = key;
+		render_variantP = render_variants[(key >> 2) & 1][(key >> 1) & 1][key & 1];
+		render_palette_mod = (g->black_hot_palette) ? 0xFF : 0x00;
+	}
+}
+
+
+
+
+static void draw_hline(int16_t x1, int16_t x2, int16_t y, uint8_t c)
+{
+	uint8_t* imgP;
+	
+	x1 -= render_cv.x0;
+	x2 -= render_cv.x0;
+	y -= render_cv.y0;
+	if ((y < 0) || (y >= render_cv.h)) return;
+	
+	if (x1 < 0) x1 = 0;
+	if (x2 >= render_cv.w) x2 = render_cv.w - 1;
+	imgP = render_cv.buf + y*render_cv.w + x1;
+	
+	while (x1 <= x2) {
+		*imgP++ = c;
+		x1++;
 	}
 }
 
 
-static void draw_line(uint8_t* img, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t c)
+static void draw_line(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t c)
 {
 	int16_t dx = abs(x2 - x1);
 	int16_t dy = -abs(y2 - y1);
@@ -568,10 +2159,13 @@ static void draw_line(uint8_t* img, int16_t x1, int16_t y1, int16_t x2, int16_t
 	int16_t sx = (x1 < x2) ? 1 : -1;
 	int16_t sy = (y1 < y2) ? 1 : -1;
 	
+	x1 -= render_cv.x0;
+	y1 -= render_cv.y0;
+	x2 -= render_cv.x0;
+	y2 -= render_cv.y0;
+	
 	for (;;) {
-		if ((x1 >= 0) && (x1 < IMG_BUF_WIDTH) && (y1 >= 0) && (y1 < IMG_BUF_HEIGHT)) {
-			draw_pixel(img, x1, y1, c);
-		}
+		draw_pixel(x1, y1, c);
 		
 		if ((x1 == x2) && (y1 == y2)) break;
 		
@@ -588,18 +2182,20 @@ static void draw_line(uint8_t* img, int16_t x1, int16_t y1, int16_t x2, int16_t
 }
 
 
-static void draw_fill_rect(uint8_t* img, int16_t x, int16_t y, int16_t w, int16_t h, uint8_t c)
+#ifdef RENDER_BENCHMARK
+// Previous bit at a time text renderer, only kept to compare against
+static void draw_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t c)
 {
 	int16_t y1 = y;
 	
 	while (y1 < (y+h)) {
-		draw_hline(img, x, x+w-1, y1, c);
+		draw_hline(x, x+w-1, y1, c);
 		y1++;
 	}
 }
 
 
-static int16_t draw_char(uint8_t* img, int16_t x, int16_t y, uint8_t c, const Font_TypeDef *Font)
+static int16_t draw_char(int16_t x, int16_t y, uint8_t c, const Font_TypeDef *Font)
 {
 	uint16_t pX;
 	uint16_t pY;
@@ -623,7 +2219,7 @@ static int16_t draw_char(uint8_t* img, int16_t x, int16_t y, uint8_t c, const Fo
 				pY = y;
 				tmpCh = *pCh++;
 				while (tmpCh) {
-					if (tmpCh & 0x01) draw_pixel(img, pX, pY, TEXT_COLOR);
+					if (tmpCh & 0x01) draw_pixel(pX, pY, TEXT_COLOR);
 					tmpCh >>= 1;
 					pY++;
 				}
@@ -639,7 +2235,7 @@ static int16_t draw_char(uint8_t* img, int16_t x, int16_t y, uint8_t c, const Fo
 					tmpCh = *pCh++;
 					if (tmpCh) {
 						while (bL) {
-							if (tmpCh & 0x01) draw_pixel(img, pX, pY, TEXT_COLOR);
+							if (tmpCh & 0x01) draw_pixel(pX, pY, TEXT_COLOR);
 							tmpCh >>= 1;
 							if (tmpCh) {
 								pY++;
@@ -665,7 +2261,7 @@ static int16_t draw_char(uint8_t* img, int16_t x, int16_t y, uint8_t c, const Fo
 				pX = x;
 				tmpCh = *pCh++;
 				while (tmpCh) {
-					if (tmpCh & 0x01) draw_pixel(img, pX, pY, TEXT_COLOR);
+					if (tmpCh & 0x01) draw_pixel(pX, pY, TEXT_COLOR);
 					tmpCh >>= 1;
 					pX++;
 				}
@@ -681,7 +2277,7 @@ static int16_t draw_char(uint8_t* img, int16_t x, int16_t y, uint8_t c, const Fo
 					tmpCh = *pCh++;
 					if (tmpCh) {
 						while (bL) {
-							if (tmpCh & 0x01) draw_pixel(img, pX, pY, TEXT_COLOR);
+							if (tmpCh & 0x01) draw_pixel(pX, pY, TEXT_COLOR);
 							tmpCh >>= 1;
 							if (tmpCh) {
 								pX++;
@@ -704,23 +2300,25 @@ static int16_t draw_char(uint8_t* img, int16_t x, int16_t y, uint8_t c, const Fo
 }
 
 
-static void draw_string(uint8_t* img, int16_t x, int16_t y, const char *str, const Font_TypeDef *Font)
+static void draw_string(int16_t x, int16_t y, const char *str, const Font_TypeDef *Font)
 {
-	uint16_t pX = x;
-	uint16_t eX = IMG_BUF_WIDTH - Font->font_Width - 1;
+	uint16_t pX = x - render_cv.x0;
+	uint16_t eX = render_cv.w - Font->font_Width - 1;
 
+	y -= render_cv.y0;
 	while (*str) {
-		pX += draw_char(img, pX, y, *str++, Font);
+		pX += draw_char(pX, y, *str++, Font);
 		if (pX > eX) break;
 	}
 }
+#endif
 
 
-static __inline__ void draw_pixel(uint8_t* img, int16_t x, int16_t y, uint8_t c)
+static __inline__ void draw_pixel(int16_t x, int16_t y, uint8_t c)
 {
-	if ((x < 0) || (x >= IMG_BUF_WIDTH)) return;
-	if ((y < 0) || (y >= IMG_BUF_HEIGHT)) return;
-	*(img + x + y*IMG_BUF_WIDTH) = c;
+	if ((x < 0) || (x >= render_cv.w)) return;
+	if ((y < 0) || (y >= render_cv.h)) return;
+	*(render_cv.buf + x + y*render_cv.w) = c;
 }
 
 
@@ -731,22 +2329,3 @@ static uint16_t get_string_width(const char *str, const Font_TypeDef *Font)
 	return (int16_t) n * (Font->font_Width + 1);
 }
 
-
-static float lep_to_disp_temp(uint16_t v, gui_state_t* g)
-{
-	float t;
-	
-	if (g->rad_high_res) {
-		t = lepton_kelvin_to_C(v, 0.01);
-	} else {
-		t = lepton_kelvin_to_C(v, 0.1);
-	}
-
-	// Convert to F if required
-	if (!g->temp_unit_C) {
-		t = t * 9.0 / 5.0 + 32.0;
-	}
-	
-	return t;
-}
-
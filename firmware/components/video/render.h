@@ -50,6 +50,35 @@
 // Text background intensity
 #define TEXT_BG_COLOR       120
 
+// Overlay display list size (elements and bytes of sprite pixels) and the sprite
+// pixel value left transparent (not used by the markers or text)
+#define RENDER_OVERLAY_MAX_ELEMENTS 16
+#define RENDER_OVERLAY_POOL_BYTES   3072
+#define RENDER_OVERLAY_CLEAR        0x01
+
+// Rendered text boxes cached until their text changes (longer strings are truncated
+// to fit RENDER_TEXT_CACHE_BYTES)
+#define RENDER_TEXT_CACHE_ENTRIES   2
+#define RENDER_TEXT_CACHE_BYTES     2048
+#define RENDER_TEXT_MAX_CHARS       24
+
+// Uncomment to log the average time to render an image every RENDER_BENCHMARK_FRAMES
+// frames.  Interpolated linear and AGC images are also rendered by the previous
+// multi-pass code on a copy of the image to compare.  Also logs the spotmeter time with
+// its text drawn from the cache, the glyph atlas and the previous renderer.  The
+// specialized renderers are compared with the generic row stage path by the host
+// benchmark in test/render.
+//#define RENDER_BENCHMARK
+#define RENDER_BENCHMARK_FRAMES 100
+
+// Lepton lines copied from the SPIRAM lepton buffer into an internal RAM strip at a
+// time for rendering (must evenly divide LEP_HEIGHT)
+#define RENDER_STRIP_LINES  8
+
+// Uncomment to log the average time to copy and render each strip every
+// RENDER_BENCHMARK_FRAMES frames
+//#define RENDER_STRIP_STATS
+
 
 // Linear Interpolation Scale Factors
 //  DS = Dual Source Pixel case (SF_DS is typically 2 or 3)
@@ -64,6 +93,12 @@
 //
 // Render Typedefs
 //
+// Image scaler kernels for render_set_image_size()
+typedef enum {
+	RENDER_KERNEL_BILINEAR,
+	RENDER_KERNEL_BICUBIC
+} render_kernel_t;
+
 // GUI state - state shared between screens
 typedef struct {
 	bool agc_enabled;            // Set by telemetry from Lepton to indicate image state
@@ -80,9 +115,17 @@ typedef struct {
 //
 // Render API
 //
+bool render_init();
 void render_lep_data(lep_buffer_t* lep, uint8_t* img, gui_state_t* g);
-void render_spotmeter(lep_buffer_t* lep, uint8_t* img, gui_state_t* g);
-void render_min_max_markers(lep_buffer_t* lep, uint8_t* img);
-void render_parm_string(const char* s, uint8_t* img);
+bool render_set_image_size(uint16_t width, uint16_t height, render_kernel_t kernel, uint16_t zoom_pct);
+void render_lep_data_src(lep_buffer_t* lep, uint8_t* src, gui_state_t* g);
+void render_src_line(const uint8_t* src, int y, uint8_t* line, bool interp);
+void render_overlay_begin();
+void render_spotmeter(lep_buffer_t* lep, gui_state_t* g);
+void render_min_max_markers(lep_buffer_t* lep);
+void render_parm_string(const char* s);
+void render_overlay_end();
+void render_overlay_draw(uint8_t* img);
+void render_overlay_line(int y, uint8_t* line);
 
 #endif /* RENDER_H */
\ No newline at end of file
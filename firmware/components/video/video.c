@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "esp_attr.h"
 #include "esp_intr_alloc.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "soc/gpio_reg.h"
 #include "soc/rtc.h"
 #include "soc/soc.h"
@@ -29,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "soc/i2s_reg.h"
 #include "soc/rtc_io_reg.h"
 #include "soc/io_mux_reg.h"
+#include "soc/cpu.h"
 #include "esp32/rom/gpio.h"
 #include "esp32/rom/lldesc.h"
 #include "driver/periph_ctrl.h"
@@ -36,6 +38,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "driver/gpio.h"
 #include "driver/i2s.h"
 #include "math.h"
+#include <inttypes.h>
 #include <esp_log.h>
 #include <string.h>
 #include <freertos/event_groups.h>
@@ -49,12 +52,16 @@ static const char* TAG = "VIDEO";
 #define INTERRUPT_STOPWATCH_START() g_interrupt_stopwatch_start=esp_timer_get_time()
 #define INTERRUPT_STOPWATCH_STOP() g_interrupt_stopwatch_delta=esp_timer_get_time()-g_interrupt_stopwatch_start; \
 g_interrupt_min=MIN(g_interrupt_stopwatch_delta, g_interrupt_min); \
-g_interrupt_max=MAX(g_interrupt_stopwatch_delta, g_interrupt_max);
+g_interrupt_max=MAX(g_interrupt_stopwatch_delta, g_interrupt_max); \
+g_interrupt_total_us+=g_interrupt_stopwatch_delta; g_interrupt_count++
 
 static uint32_t g_interrupt_stopwatch_start;
 static uint32_t g_interrupt_stopwatch_delta;
 static uint32_t g_interrupt_min=UINT32_MAX;
 static uint32_t g_interrupt_max=0;
+static uint32_t g_interrupt_total_us;
+static uint32_t g_interrupt_count;
+static int64_t g_stats_start_us;
 
 #define PIXEL_STOPWATCH_START() g_pixel_stopwatch_start=esp_timer_get_time()
 #define PIXEL_STOPWATCH_STOP() g_pixel_total_us+=esp_timer_get_time()-g_pixel_stopwatch_start; g_pixel_calls_count++
@@ -115,27 +122,100 @@ static uint32_t g_pixel_calls_count;
 #define US_TO_SAMPLES(time_us) (round(((double)g_video_signal.dac_frequency*time_us/1000000.0)))
 #define SAMPLES_TO_US(samples) ((double)g_video_signal.line_duration_us/(double)g_video_signal.samples_per_line/(double)samples)
 
-#define DMA_BUFFER_UINT16 ((uint16_t*)((lldesc_t*)I2S0.out_eof_des_addr)->buf)
-#define DMA_BUFFER_UINT8 ((uint8_t*)((lldesc_t*)I2S0.out_eof_des_addr)->buf)
-#define DMA_BUFFER_UINT32 ((uint32_t*)((lldesc_t*)I2S0.out_eof_des_addr)->buf)
+#define DMA_BUFFER_UINT16 ((uint16_t*)g_fill_desc->buf)
+#define DMA_BUFFER_UINT8 ((uint8_t*)g_fill_desc->buf)
+#define DMA_BUFFER_UINT32 ((uint32_t*)g_fill_desc->buf)
+
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+#define DMA_LINE_BUFFER_COUNT 2
+#else
+// Ring of line buffers, refilled in batches of half the ring
+#define DMA_LINE_BUFFER_COUNT CONFIG_VIDEO_DMA_RING_LINES
+#define DMA_RING_BATCH_LINES (DMA_LINE_BUFFER_COUNT/2)
+#if DMA_LINE_BUFFER_COUNT < 2 || DMA_LINE_BUFFER_COUNT % 2
+#error "CONFIG_VIDEO_DMA_RING_LINES must be an even number of at least 2"
+#endif
+#endif
+
+/// Address of the first sample of a line in a \c FB_FORMAT_DAC_NATIVE frame buffer
+#define NATIVE_FB_LINE_UINT8(fb, y) ((fb) + (y)*g_video_signal.samples_per_line*sizeof(uint16_t))
+#define NATIVE_LINE_UINT8(y) NATIVE_FB_LINE_UINT8(g_video_signal.frame_buffer, y)
 
 static intr_handle_t i2s_interrupt_handle;
-static lldesc_t DRAM_ATTR dma_buffers[2] = {0};
+static lldesc_t DRAM_ATTR dma_buffers[DMA_LINE_BUFFER_COUNT] = {0};
+/// Line buffers owned by \a dma_buffers. Descriptors may point into the frame buffer instead (FB_FORMAT_DAC_NATIVE).
+static uint8_t* DRAM_ATTR dma_line_buffers[DMA_LINE_BUFFER_COUNT] = {0};
+/// Descriptor the DMA just finished sending, latched at interrupt entry. Its buffer is refilled with the next line.
+static lldesc_t* DRAM_ATTR g_fill_desc;
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+/// Next ring descriptor to refill, the oldest one sent
+static int DRAM_ATTR g_ring_fill_index = 0;
+static VIDEO_RING_STATS DRAM_ATTR g_ring_stats;
+/// CPU cycles to send the whole ring, a longer gap between interrupts can't be seen from the eof descriptor
+static uint32_t DRAM_ATTR g_ring_cycles;
+static uint32_t DRAM_ATTR g_ring_last_ccount;
+/// Lines to refill until the DMA sent the last visible line and the frame buffers flip, 0 when none due
+static int DRAM_ATTR g_ring_flip_lines = 0;
+#endif
+
+// Frame buffer value to DAC level lookup tables, built once by setup_dac_lut()
+// so the scanline interrupt does not need to multiply/divide every pixel.
+static uint8_t DRAM_ATTR g_dac_lut_8bpp[256];
+static uint8_t DRAM_ATTR g_dac_lut_4bpp[16];
+#if CONFIG_VIDEO_DITHER
+// Ordered dither thresholds in 1/8 DAC steps by [field parity][line parity][column parity].
+// Each field is a 2x2 Bayer pattern, the next field fills in the odd thresholds.
+static const uint8_t g_dither_thresholds[2][2][2] = { {{0,4},{6,2}}, {{5,1},{3,7}} };
+/// Dithered 8bpp lookup tables [field parity*2 + line parity][column parity][grey]
+static uint8_t DRAM_ATTR g_dac_lut_8bpp_dither[4][2][256];
+/// Toggled every field when the visible lines are done
+static int DRAM_ATTR g_dither_field = 0;
+#endif
 static int volatile g_current_scan_line = 0;
 EventGroupHandle_t g_video_event_group=NULL;
 
+/// All frame buffers, \a g_video_signal.frame_buffer is the one being sent
+static uint8_t* g_frame_buffers[CONFIG_VIDEO_FRAME_BUFFER_COUNT] = {0};
+static int g_frame_buffer_count = 0;
+/// Frame buffer passed to \a video_present(), becomes the scanned one at the end of the visible lines
+static uint8_t* volatile DRAM_ATTR g_pending_frame_buffer = NULL;
+/// Last frame buffer that became the scanned one and when (esp_timer µs), for latency measurements
+static uint8_t* volatile DRAM_ATTR g_flip_frame_buffer = NULL;
+static volatile int64_t DRAM_ATTR g_flip_time_us = 0;
+
+/// Produces grey pixels of visible lines in \c FB_FORMAT_LINE_CALLBACK format
+static p_video_line_callback DRAM_ATTR g_line_callback = NULL;
+/// Line the callback writes to, converted to DAC levels right after
+static uint8_t* DRAM_ATTR g_callback_line = NULL;
+static VIDEO_LINE_CALLBACK_STATS DRAM_ATTR g_line_callback_stats;
+
+/// Scanout scaling set by \a video_set_scaling(), applied by the next \a video_init()
+static VIDEO_SCALE_X g_scale_x = VIDEO_SCALE_X_NONE;
+static bool g_repeat_lines = false;
+
 DRAM_ATTR volatile VIDEO_SIGNAL_PARAMS g_video_signal;
 
 static inline IRAM_ATTR void pal_render_scan_line(void) __attribute__((always_inline));
-static inline IRAM_ATTR void signal_vertical_sync_line(VSYNC_PULSE_LENGTH first_pulse, VSYNC_PULSE_LENGTH second_pulse) __attribute__((always_inline));
+static inline IRAM_ATTR void signal_vertical_sync_line(uint8_t* buf, VSYNC_PULSE_LENGTH first_pulse, VSYNC_PULSE_LENGTH second_pulse) __attribute__((always_inline));
+static inline IRAM_ATTR void signal_blank_line(uint8_t* buf) __attribute__((always_inline));
 static void IRAM_ATTR i2s_interrupt(void *dma_buffer_size_bytes);
+static inline IRAM_ATTR void flip_frame_buffer(void) __attribute__((always_inline));
 static void setup_video_dac(void);
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+static void setup_field_dma_chain(size_t dma_buffer_size_bytes);
+static void free_field_dma_chain(void);
+static inline IRAM_ATTR void field_render_scan_line(void) __attribute__((always_inline));
+#endif
 
 static void IRAM_ATTR render_pixels_grey_8bpp(void);
+static void IRAM_ATTR render_pixels_grey_8bpp_x2(void);
+static void IRAM_ATTR render_pixels_grey_8bpp_interp(void);
 static void IRAM_ATTR render_pixels_grey_4bpp(void);
 static void IRAM_ATTR render_pixels_grey_1bpp(void);
 static void IRAM_ATTR render_pixels_color_8bpp(void);
 static void IRAM_ATTR render_pixels_color_16bpp(void);
+static void IRAM_ATTR render_pixels_dac_native(void);
+static void IRAM_ATTR render_pixels_line_callback(void);
 #if CONFIG_VIDEO_ENABLE_LVGL_SUPPORT
 static void IRAM_ATTR render_pixels_lvgl_1bpp(void);
 #endif
@@ -143,6 +223,47 @@ static void IRAM_ATTR render_pixels_lvgl_1bpp(void);
 /// Set to true if video is generated and buffers allocated.
 static bool g_video_initialized = false;
 
+/**
+ * @brief Precomputes the DAC level for every possible 8 and 4 bit grey value.
+ * 
+ * Uses the same integer scaling the pixel renderers used to do per pixel so
+ * the output levels are unchanged.
+ */
+static void setup_dac_lut(void)
+{
+    const uint32_t factor_8bpp_x1000 = ((DAC_LEVEL_WHITE-DAC_LEVEL_BLACK)*1000)/255;
+    const uint32_t factor_4bpp_x1000 = ((DAC_LEVEL_WHITE-DAC_LEVEL_BLACK)*1000)/15;
+
+    for(uint32_t i=0; i<sizeof(g_dac_lut_8bpp); i++)
+    {
+        g_dac_lut_8bpp[i] = DAC_LEVEL_BLACK + (i*factor_8bpp_x1000)/1000;
+    }
+
+    for(uint32_t i=0; i<sizeof(g_dac_lut_4bpp); i++)
+    {
+        g_dac_lut_4bpp[i] = DAC_LEVEL_BLACK + (i*factor_4bpp_x1000)/1000;
+    }
+
+#if CONFIG_VIDEO_DITHER
+    // level = floor(exact level + (threshold+0.5)/8), in 1/16 steps to stay integer
+    for(int field=0; field<2; field++)
+    {
+        for(int line=0; line<2; line++)
+        {
+            for(int column=0; column<2; column++)
+            {
+                const uint32_t bias = (2*g_dither_thresholds[field][line][column]+1)*255;
+                for(uint32_t i=0; i<256; i++)
+                {
+                    g_dac_lut_8bpp_dither[field*2+line][column][i] =
+                        DAC_LEVEL_BLACK + (i*(DAC_LEVEL_WHITE-DAC_LEVEL_BLACK)*16 + bias)/(16*255);
+                }
+            }
+        }
+    }
+#endif
+}
+
 static void setup_video_signal(VIDEO_MODE mode, DAC_FREQUENCY dac_frequency, uint16_t width_pixels, uint16_t height_pixels, FRAME_BUFFER_FORMAT fb_format)
 {
     g_video_signal.dac_frequency = (uint32_t)dac_frequency;
@@ -185,15 +306,49 @@ static void setup_video_signal(VIDEO_MODE mode, DAC_FREQUENCY dac_frequency, uin
             g_video_signal.hsync_samples)
             /2 -
             (width_pixels/2);
+    g_video_signal.offset_x_samples &=~1; //must be even, pixels are written 2 samples per 32 bits
     
     g_video_signal.video_mode = mode;
+    g_video_signal.frame_buffer_format = fb_format;
+
+    g_video_signal.scale_x = VIDEO_SCALE_X_NONE;
+    g_video_signal.repeat_lines = false;
+    if( g_scale_x != VIDEO_SCALE_X_NONE || g_repeat_lines )
+    {
+        if( fb_format == FB_FORMAT_GREY_8BPP )
+        {
+            g_video_signal.scale_x = g_scale_x;
+            g_video_signal.repeat_lines = g_repeat_lines;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Scaling only supported in FB_FORMAT_GREY_8BPP, ignored");
+        }
+    }
+    g_video_signal.fb_width_pixels = g_video_signal.scale_x == VIDEO_SCALE_X_NONE ? width_pixels : width_pixels/2;
+    g_video_signal.fb_height_pixels = g_video_signal.repeat_lines ? height_pixels/2 : height_pixels;
+
+    setup_dac_lut();
 
     switch (fb_format)
     {
         case FB_FORMAT_GREY_8BPP:
             g_video_signal.bits_per_pixel = 8;
             ESP_LOGD(TAG, "FB format FB_FORMAT_GREY_8BPP");
-            g_video_signal.pixel_render_func = render_pixels_grey_8bpp;
+            switch( g_video_signal.scale_x )
+            {
+                case VIDEO_SCALE_X_DOUBLE:
+                    g_video_signal.pixel_render_func = render_pixels_grey_8bpp_x2;
+                    break;
+
+                case VIDEO_SCALE_X_INTERP:
+                    g_video_signal.pixel_render_func = render_pixels_grey_8bpp_interp;
+                    break;
+
+                default:
+                    g_video_signal.pixel_render_func = render_pixels_grey_8bpp;
+                    break;
+            }
             break;
 
         case FB_FORMAT_GREY_4BPP:
@@ -220,6 +375,18 @@ static void setup_video_signal(VIDEO_MODE mode, DAC_FREQUENCY dac_frequency, uin
             g_video_signal.pixel_render_func = render_pixels_color_16bpp;
             break;
 
+        case FB_FORMAT_DAC_NATIVE:
+            g_video_signal.bits_per_pixel = 16;
+            ESP_LOGD(TAG, "FB format FB_FORMAT_DAC_NATIVE");
+            g_video_signal.pixel_render_func = render_pixels_dac_native;
+            break;
+
+        case FB_FORMAT_LINE_CALLBACK:
+            g_video_signal.bits_per_pixel = 8;
+            ESP_LOGD(TAG, "FB format FB_FORMAT_LINE_CALLBACK");
+            g_video_signal.pixel_render_func = render_pixels_line_callback;
+            break;
+
 #if CONFIG_VIDEO_ENABLE_LVGL_SUPPORT
         case FB_FORMAT_LVGL_1BPP:
             g_video_signal.bits_per_pixel = 8;
@@ -235,28 +402,81 @@ static void setup_video_signal(VIDEO_MODE mode, DAC_FREQUENCY dac_frequency, uin
 
     const uint8_t BITS_IN_BYTE=8;
 
-    if( g_video_signal.bits_per_pixel <= BITS_IN_BYTE )
+    if( fb_format == FB_FORMAT_DAC_NATIVE )
+    {
+        // whole scan lines, the DMA sends them straight out of the frame buffer
+        g_video_signal.frame_buffer_size_bytes = g_video_signal.samples_per_line*sizeof(uint16_t)*height_pixels;
+    }
+    else if( fb_format == FB_FORMAT_LINE_CALLBACK )
+    {
+        // no frame buffer, lines are produced while the field is sent
+        g_video_signal.frame_buffer_size_bytes = 0;
+    }
+    else if( g_video_signal.bits_per_pixel <= BITS_IN_BYTE )
     {
-        g_video_signal.frame_buffer_size_bytes = width_pixels*height_pixels / (BITS_IN_BYTE/g_video_signal.bits_per_pixel);
+        g_video_signal.frame_buffer_size_bytes = g_video_signal.fb_width_pixels*g_video_signal.fb_height_pixels / (BITS_IN_BYTE/g_video_signal.bits_per_pixel);
     }
     else
     {
-        g_video_signal.frame_buffer_size_bytes = width_pixels*height_pixels*g_video_signal.bits_per_pixel/BITS_IN_BYTE;
+        g_video_signal.frame_buffer_size_bytes = g_video_signal.fb_width_pixels*g_video_signal.fb_height_pixels*g_video_signal.bits_per_pixel/BITS_IN_BYTE;
+    }
+    ESP_LOGD(TAG, "Bits per pixel: %u, %ux%u. FB size %" PRIu32 " bytes ", g_video_signal.bits_per_pixel, g_video_signal.width_pixels, g_video_signal.height_pixels, g_video_signal.frame_buffer_size_bytes);
+    if( g_video_signal.scale_x != VIDEO_SCALE_X_NONE || g_video_signal.repeat_lines )
+    {
+        ESP_LOGI(TAG, "Frame buffer %ux%u scaled at scanout", g_video_signal.fb_width_pixels, g_video_signal.fb_height_pixels);
+        assert(g_video_signal.fb_width_pixels%4==0); // read 4 pixels at once
     }
-    ESP_LOGD(TAG, "Bits per pixel: %u, %ux%u. FB size %u bytes ", g_video_signal.bits_per_pixel, g_video_signal.width_pixels, g_video_signal.height_pixels, g_video_signal.frame_buffer_size_bytes);
 
     assert(g_video_signal.frame_buffer_size_bytes%4==0); //for 32 bit access (read/write 4 bytes at once)
 
-    const uint32_t caps = MALLOC_CAP_32BIT; //must be 8bit to allow LVGL direct framebuffer access (otherwise it can be 32bit)
-    ESP_LOGD(TAG, "Memory: total free: %u, largest block %u", heap_caps_get_free_size(caps), heap_caps_get_largest_free_block(caps));
-    g_video_signal.frame_buffer = (uint8_t*)heap_caps_calloc(g_video_signal.frame_buffer_size_bytes, sizeof(uint8_t), caps);
-    if(NULL == g_video_signal.frame_buffer)
+    // Frame buffers are read by the interrupt so they must be in internal RAM
+    const uint32_t caps = fb_format == FB_FORMAT_DAC_NATIVE ? MALLOC_CAP_DMA : MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT; //must be 8bit to allow LVGL direct framebuffer access (otherwise it can be 32bit)
+    ESP_LOGD(TAG, "Memory: total free: %zu, largest block %zu", heap_caps_get_free_size(caps), heap_caps_get_largest_free_block(caps));
+    g_frame_buffer_count = 0;
+    g_video_signal.frame_buffer = NULL;
+    g_pending_frame_buffer = NULL;
+
+    if( fb_format == FB_FORMAT_LINE_CALLBACK )
+    {
+        g_callback_line = (uint8_t*)heap_caps_calloc(width_pixels, sizeof(uint8_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT);
+        assert(g_callback_line != NULL);
+        video_get_line_callback_stats(NULL, true);
+        ESP_LOGI(TAG, "Lines rendered by callback, budget %" PRIu32 " cycles per line", g_line_callback_stats.budget_cycles);
+        return;
+    }
+
+    for(int n=0; n<CONFIG_VIDEO_FRAME_BUFFER_COUNT; n++)
+    {
+        g_frame_buffers[n] = (uint8_t*)heap_caps_calloc(g_video_signal.frame_buffer_size_bytes, sizeof(uint8_t), caps);
+        if( NULL == g_frame_buffers[n] )
+        {
+            if( n == 0 )
+            {
+                ESP_LOGE(TAG, "Failed to allocate %" PRIu32 " bytes for frame buffer", g_video_signal.frame_buffer_size_bytes);
+                heap_caps_print_heap_info(caps);
+                assert(false);
+            }
+
+            // page flipping needs more memory, run with what we got
+            ESP_LOGW(TAG, "Only %d of %d frame buffers allocated", n, CONFIG_VIDEO_FRAME_BUFFER_COUNT);
+            break;
+        }
+        g_frame_buffer_count++;
+    }
+    g_video_signal.frame_buffer = g_frame_buffers[0];
+    ESP_LOGI(TAG, "Allocated %d frame buffer(s) of %" PRIu32 " bytes", g_frame_buffer_count, g_video_signal.frame_buffer_size_bytes);
+
+    if( fb_format == FB_FORMAT_DAC_NATIVE )
     {
-        ESP_LOGE(TAG, "Failed to allocate %u bytes for frame buffer", g_video_signal.frame_buffer_size_bytes);
-        heap_caps_print_heap_info(caps);
-        assert(false);
+        // Pre-render horizontal sync and porches, visible part black
+        for(int n=0; n<g_frame_buffer_count; n++)
+        {
+            for(uint16_t y=0; y<height_pixels; y++)
+            {
+                signal_blank_line(NATIVE_FB_LINE_UINT8(g_frame_buffers[n], y));
+            }
+        }
     }
-    ESP_LOGI(TAG, "Allocated %u bytes for frame buffer", g_video_signal.frame_buffer_size_bytes);
 }
 
 static void set_dac_frequency(void)
@@ -305,7 +525,7 @@ static void setup_video_dac(void)
 	ESP_LOGD(TAG, "DAC setup");
 
     const size_t dma_buffer_size_bytes = g_video_signal.samples_per_line*sizeof(uint16_t);
-    ESP_LOGD(TAG, "Computed DMA buffer size: %u", dma_buffer_size_bytes);
+    ESP_LOGD(TAG, "Computed DMA buffer size: %zu", dma_buffer_size_bytes);
 
     periph_module_enable(PERIPH_I2S0_MODULE);
     ESP_ERROR_CHECK(esp_intr_alloc(ETS_I2S0_INTR_SOURCE, ESP_INTR_FLAG_LEVEL1 | ESP_INTR_FLAG_IRAM, i2s_interrupt, (void*)dma_buffer_size_bytes, &i2s_interrupt_handle));
@@ -329,20 +549,32 @@ static void setup_video_dac(void)
     I2S0.clkm_conf.clka_en = 1;                 // use clk_apll clock
     I2S0.fifo_conf.tx_fifo_mod = 1; // 16-bit single channel data
 
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+    setup_field_dma_chain(dma_buffer_size_bytes);
+#else
 	const size_t DMA_BUFFER_COUNT = sizeof(dma_buffers)/sizeof(lldesc_t);
     for (size_t n=0; n<DMA_BUFFER_COUNT; n++)
 	{
-        ESP_LOGD(TAG, "Allocating DMA buffer: %u bytes", dma_buffer_size_bytes);
-        dma_buffers[n].buf = (uint8_t*)heap_caps_calloc(dma_buffer_size_bytes, sizeof(uint8_t), MALLOC_CAP_DMA);
-		assert(dma_buffers[n].buf != NULL);
+        ESP_LOGD(TAG, "Allocating DMA buffer: %zu bytes", dma_buffer_size_bytes);
+        dma_line_buffers[n] = (uint8_t*)heap_caps_calloc(dma_buffer_size_bytes, sizeof(uint8_t), MALLOC_CAP_DMA);
+		assert(dma_line_buffers[n] != NULL);
+        dma_buffers[n].buf = dma_line_buffers[n];
         dma_buffers[n].owner = 1;
-        dma_buffers[n].eof = 1;
+        dma_buffers[n].eof = (n+1) % DMA_RING_BATCH_LINES == 0; // interrupt once per batch
         dma_buffers[n].length = dma_buffer_size_bytes;
         dma_buffers[n].size = dma_buffer_size_bytes;
-        dma_buffers[n].empty = (uint32_t)(n==DMA_BUFFER_COUNT-1? &dma_buffers[0] : &dma_buffers[n+1]);
+        dma_buffers[n].empty = (uint32_t)(uintptr_t)(n==DMA_BUFFER_COUNT-1? &dma_buffers[0] : &dma_buffers[n+1]);
     }
-    I2S0.out_link.addr = (uint32_t)&dma_buffers[0];
-    ESP_LOGI(TAG, "DMA buffers configured. Buffers: %u, Size: %u bytes each", DMA_BUFFER_COUNT, dma_buffer_size_bytes);
+    I2S0.out_link.addr = (uint32_t)(uintptr_t)&dma_buffers[0];
+    g_ring_fill_index = 0;
+    g_ring_flip_lines = 0;
+    // line_duration_us is truncated, NTSC lines are 63.55 µs
+    g_ring_cycles = (uint64_t)DMA_LINE_BUFFER_COUNT*g_video_signal.samples_per_line*CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ*1000000/g_video_signal.dac_frequency;
+    g_ring_last_ccount = esp_cpu_get_ccount();
+    video_get_ring_stats(NULL, true);
+    ESP_LOGI(TAG, "DMA buffers configured. Buffers: %zu, Size: %zu bytes each, refilled %d at a time", DMA_BUFFER_COUNT, dma_buffer_size_bytes, DMA_RING_BATCH_LINES);
+#endif
+    video_get_isr_stats(NULL, true);
 
     set_dac_frequency();
 
@@ -391,24 +623,42 @@ void video_stop(void)
     const size_t DMA_BUFFER_COUNT = sizeof(dma_buffers)/sizeof(lldesc_t);
     for(size_t i=0;i<DMA_BUFFER_COUNT;i++)
     {
-        if( dma_buffers[i].buf )
+        // descriptor may point to the frame buffer, always free the owned line buffer
+        if( dma_line_buffers[i] )
         {
             ESP_LOGD(TAG, "Free DMA buffers");
-            heap_caps_free((uint8_t*)dma_buffers[i].buf);
-            dma_buffers[i].buf=NULL;
+            heap_caps_free(dma_line_buffers[i]);
+            dma_line_buffers[i]=NULL;
         }
+        dma_buffers[i].buf=NULL;
     }
 
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+    free_field_dma_chain();
+#endif
+
     // disable I2S
     ESP_LOGD(TAG, "Disable I²S module");
     periph_module_disable(PERIPH_I2S0_MODULE);
 
-    // free frame buffer
-    if( g_video_signal.frame_buffer )
+    // free frame buffers
+    for(int n=0; n<CONFIG_VIDEO_FRAME_BUFFER_COUNT; n++)
+    {
+        if( g_frame_buffers[n] )
+        {
+            ESP_LOGD(TAG, "Free framebuffer memory");
+            heap_caps_free(g_frame_buffers[n]);
+            g_frame_buffers[n]=NULL;
+        }
+    }
+    g_frame_buffer_count = 0;
+    g_video_signal.frame_buffer=NULL;
+    g_pending_frame_buffer=NULL;
+
+    if( g_callback_line )
     {
-        ESP_LOGD(TAG, "Free framebuffer memory");
-        heap_caps_free(g_video_signal.frame_buffer);
-        g_video_signal.frame_buffer=NULL;
+        heap_caps_free(g_callback_line);
+        g_callback_line=NULL;
     }
 
     if( g_video_event_group )
@@ -497,7 +747,7 @@ void video_init(uint16_t width, uint16_t height, FRAME_BUFFER_FORMAT fb_format,
 	setup_video_dac();
 
     ESP_LOGD(TAG,"rtc_clk_xtal_freq_get() = %d", (int)rtc_clk_xtal_freq_get());
-    ESP_LOGI(TAG,"DAC frequency: %u Hz", (uint32_t)g_video_signal.dac_frequency);
+    ESP_LOGI(TAG,"DAC frequency: %" PRIu32 " Hz", g_video_signal.dac_frequency);
     ESP_LOGD(TAG,"DAC SYNC  level: %u", DAC_LEVEL_SYNC);
     ESP_LOGD(TAG,"DAC BLACK level: %u", DAC_LEVEL_BLACK);
     ESP_LOGD(TAG,"DAC WHITE level: %u", DAC_LEVEL_WHITE);
@@ -517,47 +767,82 @@ void video_init(uint16_t width, uint16_t height, FRAME_BUFFER_FORMAT fb_format,
     g_video_initialized = true;
 }
 
-static inline IRAM_ATTR void signal_vertical_sync_line(const VSYNC_PULSE_LENGTH first_pulse, const VSYNC_PULSE_LENGTH second_pulse)
+/**
+ * @brief Sets samples \a start to \a end-1 of a line to \a level.
+ * 
+ * Samples are counted in the order they are sent. The I²S sends the upper half
+ * of each 32 bit word first so an odd boundary sample is not where a plain
+ * memset would put it.
+ */
+static inline IRAM_ATTR void fill_samples(uint8_t* buf, int start, int end, uint8_t level)
 {
-    const int half_bytes = g_video_signal.samples_per_line; //number of bytes = samples x2, so half = samples
-    int first_pulse_width_bytes =   first_pulse == VSYNC_PULSE_LONG ? g_video_signal.vsync_long_samples*2 : g_video_signal.vsync_short_samples*2;
-    int second_pulse_width_bytes = second_pulse == VSYNC_PULSE_LONG ? g_video_signal.vsync_long_samples*2 : g_video_signal.vsync_short_samples*2;
-
-    memset(DMA_BUFFER_UINT8, DAC_LEVEL_SYNC, first_pulse_width_bytes);
-    memset(DMA_BUFFER_UINT8+first_pulse_width_bytes, DAC_LEVEL_BLACK, half_bytes - first_pulse_width_bytes);
+    uint16_t* p = (uint16_t*)buf;
 
-    memset(DMA_BUFFER_UINT8+half_bytes, DAC_LEVEL_SYNC, second_pulse_width_bytes);
-    memset(DMA_BUFFER_UINT8+half_bytes+second_pulse_width_bytes, DAC_LEVEL_BLACK, half_bytes - second_pulse_width_bytes);
+    if( start & 1 )
+    {
+        p[start^1] = level << 8;
+        start++;
+    }
+    if( end & 1 )
+    {
+        end--;
+        p[end^1] = level << 8;
+    }
+    if( end > start )
+    {
+        memset(buf+start*sizeof(uint16_t), level, (end-start)*sizeof(uint16_t));
+    }
 }
 
-static IRAM_ATTR inline void signal_blank_line(void)
+static inline IRAM_ATTR void signal_vertical_sync_line(uint8_t* buf, const VSYNC_PULSE_LENGTH first_pulse, const VSYNC_PULSE_LENGTH second_pulse)
 {
-    const size_t hsync = g_video_signal.hsync_samples*sizeof(uint16_t);
-    memset(DMA_BUFFER_UINT8, DAC_LEVEL_SYNC, hsync);
-    memset(DMA_BUFFER_UINT8+hsync, DAC_LEVEL_BLACK, (g_video_signal.samples_per_line-g_video_signal.hsync_samples)*sizeof(uint16_t));
+    const int half = g_video_signal.samples_per_line/2;
+    int first_pulse_width =   first_pulse == VSYNC_PULSE_LONG ? g_video_signal.vsync_long_samples : g_video_signal.vsync_short_samples;
+    int second_pulse_width = second_pulse == VSYNC_PULSE_LONG ? g_video_signal.vsync_long_samples : g_video_signal.vsync_short_samples;
+
+    fill_samples(buf, 0, first_pulse_width, DAC_LEVEL_SYNC);
+    fill_samples(buf, first_pulse_width, half, DAC_LEVEL_BLACK);
+
+    fill_samples(buf, half, half+second_pulse_width, DAC_LEVEL_SYNC);
+    fill_samples(buf, half+second_pulse_width, g_video_signal.samples_per_line, DAC_LEVEL_BLACK);
 }
 
-static void IRAM_ATTR render_pixels_grey_8bpp(void)
+static IRAM_ATTR inline void signal_blank_line(uint8_t* buf)
 {
-    const uint32_t factor_x1000 = ((DAC_LEVEL_WHITE-DAC_LEVEL_BLACK)*1000)/255;
-    const int fb_y = g_current_scan_line-g_video_signal.offset_y_lines;
+    fill_samples(buf, 0, g_video_signal.hsync_samples, DAC_LEVEL_SYNC);
+    fill_samples(buf, g_video_signal.hsync_samples, g_video_signal.samples_per_line, DAC_LEVEL_BLACK);
+}
 
-    // use 32 bit access (4 times faster)
-    //4 pixels per 32 bits
-    uint32_t* p = DMA_BUFFER_UINT32+g_video_signal.offset_x_samples/2;
-    uint32_t* s = (uint32_t*)g_video_signal.frame_buffer + fb_y*g_video_signal.width_pixels/4;
-    size_t len = g_video_signal.width_pixels/4;
+/**
+ * @brief Gets the 8bpp lookup tables for even and odd pixel columns of the current scan line.
+ */
+static inline IRAM_ATTR void dac_lut_8bpp_line(const uint8_t** lut_even, const uint8_t** lut_odd)
+{
+#if CONFIG_VIDEO_DITHER
+    *lut_even = g_dac_lut_8bpp_dither[(g_dither_field & 1)*2 + (g_current_scan_line & 1)][0];
+    *lut_odd = g_dac_lut_8bpp_dither[(g_dither_field & 1)*2 + (g_current_scan_line & 1)][1];
+#else
+    *lut_even = g_dac_lut_8bpp;
+    *lut_odd = g_dac_lut_8bpp;
+#endif
+}
 
+static inline IRAM_ATTR void convert_pixels_grey_8bpp(const uint32_t* s, uint32_t* p, size_t len)
+{
+    const uint8_t* lut_even;
+    const uint8_t* lut_odd;
     uint32_t p4;
+
+    dac_lut_8bpp_line(&lut_even, &lut_odd);
     while(len--)
     {
         p4 = *s;
         s++;
 
-        uint8_t pixel1 = DAC_LEVEL_BLACK + (((p4 & 0xFF000000) >> 24) * factor_x1000)/1000;
-        uint8_t pixel2 = DAC_LEVEL_BLACK + (((p4 & 0x00FF0000) >> 16) * factor_x1000)/1000;
-        uint8_t pixel3 = DAC_LEVEL_BLACK + (((p4 & 0x0000FF00) >> 8 ) * factor_x1000)/1000;
-        uint8_t pixel4 = DAC_LEVEL_BLACK + (((p4 & 0x000000FF) >> 0 ) * factor_x1000)/1000;
+        uint8_t pixel1 = lut_odd[(p4 & 0xFF000000) >> 24];
+        uint8_t pixel2 = lut_even[(p4 & 0x00FF0000) >> 16];
+        uint8_t pixel3 = lut_odd[(p4 & 0x0000FF00) >> 8 ];
+        uint8_t pixel4 = lut_even[(p4 & 0x000000FF) >> 0 ];
 
         // DAC uses MSB byte of uint16_t
         *p = pixel4 << 24 | pixel3 << 8;
@@ -568,6 +853,104 @@ static void IRAM_ATTR render_pixels_grey_8bpp(void)
     }
 }
 
+static IRAM_ATTR inline void signal_visible_line(void)
+{
+    if( g_video_signal.frame_buffer_format != FB_FORMAT_DAC_NATIVE )
+    {
+        // native lines already contain sync and porches
+        signal_blank_line(DMA_BUFFER_UINT8); //TODO optimize this
+    }
+    g_video_signal.pixel_render_func();
+}
+
+/**
+ * @brief Frame buffer line of the current scan line, the same one twice when lines are repeated.
+ */
+static inline IRAM_ATTR uint32_t* grey_8bpp_source_line(void)
+{
+    const int fb_y = (g_current_scan_line-g_video_signal.offset_y_lines) >> (g_video_signal.repeat_lines ? 1 : 0);
+
+    return (uint32_t*)g_video_signal.frame_buffer + fb_y*g_video_signal.fb_width_pixels/4;
+}
+
+static void IRAM_ATTR render_pixels_grey_8bpp(void)
+{
+    // use 32 bit access (4 times faster)
+    //4 pixels per 32 bits
+    uint32_t* p = DMA_BUFFER_UINT32+g_video_signal.offset_x_samples/2;
+    uint32_t* s = grey_8bpp_source_line();
+
+    convert_pixels_grey_8bpp(s, p, g_video_signal.fb_width_pixels/4);
+}
+
+/**
+ * @brief Renders a half width 8bpp frame buffer line, every pixel sent twice.
+ * 
+ * One frame buffer pixel fills both samples of a 32 bit DMA word.
+ */
+static void IRAM_ATTR render_pixels_grey_8bpp_x2(void)
+{
+    uint32_t* p = DMA_BUFFER_UINT32+g_video_signal.offset_x_samples/2;
+    const uint32_t* s = grey_8bpp_source_line();
+    size_t len = g_video_signal.fb_width_pixels/4;
+    const uint8_t* lut_even;
+    const uint8_t* lut_odd;
+    uint32_t p4;
+    uint32_t v;
+
+    dac_lut_8bpp_line(&lut_even, &lut_odd);
+    while(len--)
+    {
+        p4 = *s;
+        s++;
+
+        // DAC uses MSB byte of uint16_t, both samples of a word from the same pixel
+        v = (p4 & 0x000000FF) >> 0;
+        *p++ = lut_even[v] << 24 | lut_odd[v] << 8;
+        v = (p4 & 0x0000FF00) >> 8;
+        *p++ = lut_even[v] << 24 | lut_odd[v] << 8;
+        v = (p4 & 0x00FF0000) >> 16;
+        *p++ = lut_even[v] << 24 | lut_odd[v] << 8;
+        v = (p4 & 0xFF000000) >> 24;
+        *p++ = lut_even[v] << 24 | lut_odd[v] << 8;
+    }
+}
+
+/**
+ * @brief Renders a half width 8bpp frame buffer line with linear interpolation.
+ * 
+ * Every frame buffer pixel is followed by the average DAC level of it and the
+ * next pixel. The last pixel is sent twice.
+ */
+static void IRAM_ATTR render_pixels_grey_8bpp_interp(void)
+{
+    uint32_t* p = DMA_BUFFER_UINT32+g_video_signal.offset_x_samples/2;
+    const uint32_t* s = grey_8bpp_source_line();
+    size_t len = g_video_signal.fb_width_pixels/4;
+    uint32_t a = g_dac_lut_8bpp[*(const uint8_t*)s];
+    uint32_t b;
+    uint32_t p4;
+
+    while(len--)
+    {
+        p4 = *s;
+        s++;
+
+        b = g_dac_lut_8bpp[(p4 & 0x0000FF00) >> 8 ];
+        *p++ = a << 24 | ((a+b+1)/2) << 8;
+        a = b;
+        b = g_dac_lut_8bpp[(p4 & 0x00FF0000) >> 16];
+        *p++ = a << 24 | ((a+b+1)/2) << 8;
+        a = b;
+        b = g_dac_lut_8bpp[(p4 & 0xFF000000) >> 24];
+        *p++ = a << 24 | ((a+b+1)/2) << 8;
+        a = b;
+        b = len ? g_dac_lut_8bpp[*(const uint8_t*)s] : a; // first pixel of the next 4
+        *p++ = a << 24 | ((a+b+1)/2) << 8;
+        a = b;
+    }
+}
+
 #if CONFIG_VIDEO_ENABLE_LVGL_SUPPORT
 /**
  * @brief Renders pixel for LVGL 1 bit per pixel compatible framebuffer.
@@ -721,7 +1104,6 @@ static void IRAM_ATTR render_pixels_color_16bpp(void)
 
 static void IRAM_ATTR render_pixels_grey_4bpp(void)
 {
-    const uint32_t factor_x1000 = ((DAC_LEVEL_WHITE-DAC_LEVEL_BLACK)*1000)/15;
     const int fb_y = g_current_scan_line-g_video_signal.offset_y_lines;
 
     // use 32 bit access (4 times faster)
@@ -736,14 +1118,14 @@ static void IRAM_ATTR render_pixels_grey_4bpp(void)
         p4 = *s;
         s++;
 
-        uint8_t pixel1 = DAC_LEVEL_BLACK + (((p4 & 0xF0000000) >> 28) * factor_x1000)/1000;
-        uint8_t pixel2 = DAC_LEVEL_BLACK + (((p4 & 0x0F000000) >> 24) * factor_x1000)/1000;
-        uint8_t pixel3 = DAC_LEVEL_BLACK + (((p4 & 0x00F00000) >> 20) * factor_x1000)/1000;
-        uint8_t pixel4 = DAC_LEVEL_BLACK + (((p4 & 0x000F0000) >> 16) * factor_x1000)/1000;
-        uint8_t pixel5 = DAC_LEVEL_BLACK + (((p4 & 0x0000F000) >> 12) * factor_x1000)/1000;
-        uint8_t pixel6 = DAC_LEVEL_BLACK + (((p4 & 0x00000F00) >> 8 ) * factor_x1000)/1000;
-        uint8_t pixel7 = DAC_LEVEL_BLACK + (((p4 & 0x000000F0) >> 4 ) * factor_x1000)/1000;
-        uint8_t pixel8 = DAC_LEVEL_BLACK + (((p4 & 0x0000000F) >> 0 ) * factor_x1000)/1000;
+        uint8_t pixel1 = g_dac_lut_4bpp[(p4 & 0xF0000000) >> 28];
+        uint8_t pixel2 = g_dac_lut_4bpp[(p4 & 0x0F000000) >> 24];
+        uint8_t pixel3 = g_dac_lut_4bpp[(p4 & 0x00F00000) >> 20];
+        uint8_t pixel4 = g_dac_lut_4bpp[(p4 & 0x000F0000) >> 16];
+        uint8_t pixel5 = g_dac_lut_4bpp[(p4 & 0x0000F000) >> 12];
+        uint8_t pixel6 = g_dac_lut_4bpp[(p4 & 0x00000F00) >> 8 ];
+        uint8_t pixel7 = g_dac_lut_4bpp[(p4 & 0x000000F0) >> 4 ];
+        uint8_t pixel8 = g_dac_lut_4bpp[(p4 & 0x0000000F) >> 0 ];
 
         *p = pixel8 << 24 | pixel7 << 8;
         p++;
@@ -759,6 +1141,55 @@ static void IRAM_ATTR render_pixels_grey_4bpp(void)
     }
 }
 
+/**
+ * @brief Sends the frame buffer line directly.
+ * 
+ * The line is already stored as DAC samples so the descriptor is just pointed at it.
+ * No pixel data is copied.
+ */
+static void IRAM_ATTR render_pixels_dac_native(void)
+{
+    const int fb_y = g_current_scan_line-g_video_signal.offset_y_lines;
+
+    g_fill_desc->buf = NATIVE_LINE_UINT8(fb_y);
+}
+
+/**
+ * @brief Renders a visible line produced by the line callback.
+ * 
+ * The callback writes 8 bit grey pixels, converted to DAC levels like
+ * \c FB_FORMAT_GREY_8BPP. Lines taking longer than a scan line are counted,
+ * the DMA ring can absorb a few but not a whole field of them.
+ */
+static void IRAM_ATTR render_pixels_line_callback(void)
+{
+    const int fb_y = g_current_scan_line-g_video_signal.offset_y_lines;
+    const uint32_t start = esp_cpu_get_ccount();
+
+    uint32_t* p = DMA_BUFFER_UINT32+g_video_signal.offset_x_samples/2;
+
+    if( g_line_callback )
+    {
+        g_line_callback(fb_y, g_callback_line);
+    }
+    else
+    {
+        memset(g_callback_line, 0, g_video_signal.width_pixels);
+    }
+    convert_pixels_grey_8bpp((uint32_t*)g_callback_line, p, g_video_signal.width_pixels/4);
+
+    const uint32_t cycles = esp_cpu_get_ccount() - start;
+    g_line_callback_stats.lines++;
+    if( cycles > g_line_callback_stats.max_cycles )
+    {
+        g_line_callback_stats.max_cycles = cycles;
+    }
+    if( cycles > g_line_callback_stats.budget_cycles )
+    {
+        g_line_callback_stats.overruns++;
+    }
+}
+
 static void IRAM_ATTR render_pixels_grey_1bpp(void)
 {
     const int fb_y = g_current_scan_line-g_video_signal.offset_y_lines;
@@ -828,40 +1259,42 @@ static inline IRAM_ATTR void pal_render_scan_line(void)
 
     if( g_current_scan_line <= 2) // lines 1,2
     {
-        signal_vertical_sync_line(VSYNC_PULSE_LONG,VSYNC_PULSE_LONG);
+        signal_vertical_sync_line(DMA_BUFFER_UINT8, VSYNC_PULSE_LONG, VSYNC_PULSE_LONG);
     }
     else if( g_current_scan_line == 3) //line 3
     {
-        signal_vertical_sync_line(VSYNC_PULSE_LONG,VSYNC_PULSE_SHORT);
+        signal_vertical_sync_line(DMA_BUFFER_UINT8, VSYNC_PULSE_LONG, VSYNC_PULSE_SHORT);
     }
     else if( g_current_scan_line <= 5) // lines 4,5
     {
-        signal_vertical_sync_line(VSYNC_PULSE_SHORT,VSYNC_PULSE_SHORT);
+        signal_vertical_sync_line(DMA_BUFFER_UINT8, VSYNC_PULSE_SHORT, VSYNC_PULSE_SHORT);
     }
     else if( g_current_scan_line < g_video_signal.offset_y_lines )
     {
-        signal_blank_line();
+        signal_blank_line(DMA_BUFFER_UINT8);
     }
     else if (g_current_scan_line < g_video_signal.offset_y_lines+g_video_signal.height_pixels)
     {
         PIXEL_STOPWATCH_START();
-        signal_blank_line(); //TODO optimize this
-        g_video_signal.pixel_render_func();
+        signal_visible_line();
         PIXEL_STOPWATCH_STOP();
     }
     else if( g_current_scan_line < g_video_signal.number_of_lines - 2 ) // PAL 310 / NTSC 260
     {
-        if( g_current_scan_line == g_video_signal.offset_y_lines+g_video_signal.height_pixels && even_frame )
+        if( g_current_scan_line == g_video_signal.offset_y_lines+g_video_signal.height_pixels )
         {
-            // All visible lines passed
-            xEventGroupSetBits(g_video_event_group, COMPOSITE_EVENT_FRAME_VISIBLE_END_BIT);
+            if( even_frame )
+            {
+                // All visible lines passed
+                xEventGroupSetBits(g_video_event_group, COMPOSITE_EVENT_FRAME_VISIBLE_END_BIT);
+            }
         }
 
-        signal_blank_line();
+        signal_blank_line(DMA_BUFFER_UINT8);
     }
     else if (g_current_scan_line <= g_video_signal.number_of_lines) // PAL lines 310-312 / NTSC 260-262
     {
-        signal_vertical_sync_line(VSYNC_PULSE_SHORT, VSYNC_PULSE_SHORT);
+        signal_vertical_sync_line(DMA_BUFFER_UINT8, VSYNC_PULSE_SHORT, VSYNC_PULSE_SHORT);
     }
     
 #if CONFIG_VIDEO_TRIGGER_MODE_LINE
@@ -905,36 +1338,38 @@ static inline IRAM_ATTR void ntsc_render_scan_line(void)
 
     if( g_current_scan_line <= 3) // lines 1,2,3
     {
-        signal_vertical_sync_line(VSYNC_PULSE_SHORT,VSYNC_PULSE_SHORT);
+        signal_vertical_sync_line(DMA_BUFFER_UINT8, VSYNC_PULSE_SHORT, VSYNC_PULSE_SHORT);
     }
     else if( g_current_scan_line <= 6 ) //line 4,5,6
     {
-        signal_vertical_sync_line(VSYNC_PULSE_LONG,VSYNC_PULSE_LONG);
+        signal_vertical_sync_line(DMA_BUFFER_UINT8, VSYNC_PULSE_LONG, VSYNC_PULSE_LONG);
     }
     else if( g_current_scan_line <= 9) // lines 7,8,9
     {
-        signal_vertical_sync_line(VSYNC_PULSE_SHORT,VSYNC_PULSE_SHORT);
+        signal_vertical_sync_line(DMA_BUFFER_UINT8, VSYNC_PULSE_SHORT, VSYNC_PULSE_SHORT);
     }
     else if( g_current_scan_line < g_video_signal.offset_y_lines )
     {
-        signal_blank_line();
+        signal_blank_line(DMA_BUFFER_UINT8);
     }
     else if (g_current_scan_line < g_video_signal.offset_y_lines+g_video_signal.height_pixels)
     {
         PIXEL_STOPWATCH_START();
-        signal_blank_line();
-        g_video_signal.pixel_render_func();
+        signal_visible_line();
         PIXEL_STOPWATCH_STOP();
     }
-    else if( g_current_scan_line < g_video_signal.number_of_lines  )
+    else if( g_current_scan_line <= g_video_signal.number_of_lines ) // NTSC lines up to 262
     {
-        if( g_current_scan_line == g_video_signal.offset_y_lines+g_video_signal.height_pixels && first_field )
+        if( g_current_scan_line == g_video_signal.offset_y_lines+g_video_signal.height_pixels )
         {
-            // All visible lines passed
-            xEventGroupSetBits(g_video_event_group, COMPOSITE_EVENT_FRAME_VISIBLE_END_BIT);
+            if( first_field )
+            {
+                // All visible lines passed
+                xEventGroupSetBits(g_video_event_group, COMPOSITE_EVENT_FRAME_VISIBLE_END_BIT);
+            }
         }
 
-        signal_blank_line();
+        signal_blank_line(DMA_BUFFER_UINT8);
     }
 
 #if CONFIG_VIDEO_TRIGGER_MODE_LINE
@@ -954,55 +1389,693 @@ static inline IRAM_ATTR void ntsc_render_scan_line(void)
     }
 }
 
-static void IRAM_ATTR i2s_interrupt(void *dma_buffer_size_bytes)
+#if CONFIG_VIDEO_DMA_MODE_FIELD || CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+/**
+ * @brief Scan line types. The first entries also index the line templates.
+ */
+typedef enum _LINE_TYPE
 {
-	if (I2S0.int_st.out_eof)
-	{
-#if CONFIG_VIDEO_TRIGGER_MODE_ISR
-        DIAG_PIN_HI();
-#endif
-        INTERRUPT_STOPWATCH_START();
+    LINE_VSYNC_LONG_LONG,
+    LINE_VSYNC_LONG_SHORT,
+    LINE_VSYNC_SHORT_SHORT,
+    LINE_BLANK,
+    LINE_VISIBLE
+} LINE_TYPE;
 
-        if( g_video_signal.video_mode >= VIDEO_MODE_NTSC )
-            ntsc_render_scan_line();
-        else
-            pal_render_scan_line();
+/**
+ * @brief Returns the type of a scan line.
+ * 
+ * Same field layout as generated by \a pal_render_scan_line() and \a ntsc_render_scan_line().
+ * 
+ * @param line scan line number, 1 to number_of_lines
+ */
+static IRAM_ATTR LINE_TYPE get_line_type(int line)
+{
+    if( line >= g_video_signal.offset_y_lines && line < g_video_signal.offset_y_lines+g_video_signal.height_pixels )
+    {
+        return LINE_VISIBLE;
+    }
 
-        INTERRUPT_STOPWATCH_STOP();
-#if CONFIG_VIDEO_TRIGGER_MODE_ISR
-        DIAG_PIN_LO();
-#endif
-	}
+    if( g_video_signal.video_mode >= VIDEO_MODE_NTSC )
+    {
+        if( line <= 3 || (line >= 7 && line <= 9) ) // lines 1,2,3 and 7,8,9
+            return LINE_VSYNC_SHORT_SHORT;
+        if( line <= 6 ) // lines 4,5,6
+            return LINE_VSYNC_LONG_LONG;
+    }
+    else
+    {
+        if( line <= 2 ) // lines 1,2
+            return LINE_VSYNC_LONG_LONG;
+        if( line == 3 ) // line 3
+            return LINE_VSYNC_LONG_SHORT;
+        if( line <= 5 || line > g_video_signal.number_of_lines - 3 ) // lines 4,5 and 310-312
+            return LINE_VSYNC_SHORT_SHORT;
+    }
 
-	// reset the interrupt
-    I2S0.int_clr.val = I2S0.int_st.val;
+    return LINE_BLANK;
 }
+#endif
 
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+#define LINE_TEMPLATE_COUNT LINE_VISIBLE
 
-#if CONFIG_VIDEO_DIAG_ENABLE_INTERRUPT_STATS
-void video_show_stats(void)
-{
-    uint32_t pixel_avg_us = g_pixel_total_us/g_pixel_calls_count;
-
-    ESP_LOGI(TAG, "Interrupt MAX: %u µs, MIN: %u µs. Pixel AVG: %u µs", g_interrupt_max, g_interrupt_min, pixel_avg_us );
-
-    g_pixel_total_us = g_pixel_calls_count = 0;
-    g_interrupt_min = UINT32_MAX;
-    g_interrupt_max = 0;
-}
+/// One descriptor per scan line of the field, linked in a loop
+static lldesc_t* g_field_chain = NULL;
+/// Constant sync and blank lines shared by all descriptors of the same type
+static uint8_t* g_line_templates[LINE_TEMPLATE_COUNT] = {0};
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+/// Lines from each descriptor of \a g_field_chain to the next one with the eof flag
+static uint16_t DRAM_ATTR g_field_lines_to_eof[PAL_TOTAL_LINES_COUNT];
 #endif
 
-void video_graphics(GRAPHICS_MODE mode, FRAME_BUFFER_FORMAT fb_format)
+/**
+ * @brief Describes the whole field once as a looped descriptor chain.
+ * 
+ * Sync and blank lines point to the shared templates. Visible lines point
+ * to the frame buffer (FB_FORMAT_DAC_NATIVE) or alternate between the two
+ * line buffers which the interrupt renders two lines ahead. The interrupt is
+ * only requested for visible lines that need rendering, after the last
+ * visible line and at the end of the field.
+ */
+static void setup_field_dma_chain(size_t dma_buffer_size_bytes)
 {
-    switch( mode )
+    const int visible_end = g_video_signal.offset_y_lines + g_video_signal.height_pixels;
+    const bool native = g_video_signal.frame_buffer_format == FB_FORMAT_DAC_NATIVE;
+    int interrupt_lines = 0;
+
+    for(int t=0; t<LINE_TEMPLATE_COUNT; t++)
     {
-        case PAL_384x288:
-            video_init(384, 288, fb_format, VIDEO_MODE_PAL, false);
-            break;
+        g_line_templates[t] = (uint8_t*)heap_caps_calloc(dma_buffer_size_bytes, sizeof(uint8_t), MALLOC_CAP_DMA);
+        assert(g_line_templates[t] != NULL);
+    }
+    signal_vertical_sync_line(g_line_templates[LINE_VSYNC_LONG_LONG], VSYNC_PULSE_LONG, VSYNC_PULSE_LONG);
+    signal_vertical_sync_line(g_line_templates[LINE_VSYNC_LONG_SHORT], VSYNC_PULSE_LONG, VSYNC_PULSE_SHORT);
+    signal_vertical_sync_line(g_line_templates[LINE_VSYNC_SHORT_SHORT], VSYNC_PULSE_SHORT, VSYNC_PULSE_SHORT);
+    signal_blank_line(g_line_templates[LINE_BLANK]);
 
-        case PAL_768x288:
-            video_init(768, 288, fb_format, VIDEO_MODE_PAL, true);
-            break;
+    if( !native )
+    {
+        // sync and porches are set once, the interrupt only rewrites the pixels
+        for(int n=0; n<DMA_LINE_BUFFER_COUNT; n++)
+        {
+            dma_line_buffers[n] = (uint8_t*)heap_caps_calloc(dma_buffer_size_bytes, sizeof(uint8_t), MALLOC_CAP_DMA);
+            assert(dma_line_buffers[n] != NULL);
+            signal_blank_line(dma_line_buffers[n]);
+        }
+    }
+
+    g_field_chain = (lldesc_t*)heap_caps_calloc(g_video_signal.number_of_lines, sizeof(lldesc_t), MALLOC_CAP_DMA);
+    assert(g_field_chain != NULL);
+
+    for(int i=0; i<g_video_signal.number_of_lines; i++)
+    {
+        const int line = i+1;
+        const LINE_TYPE type = get_line_type(line);
+        lldesc_t* d = &g_field_chain[i];
+
+        if( type == LINE_VISIBLE )
+        {
+            if( native )
+            {
+                d->buf = NATIVE_LINE_UINT8(line - g_video_signal.offset_y_lines);
+                d->eof = 0;
+            }
+            else
+            {
+                d->buf = dma_line_buffers[line % DMA_LINE_BUFFER_COUNT];
+                d->eof = 1;
+            }
+        }
+        else
+        {
+            d->buf = g_line_templates[type];
+            d->eof = line == visible_end || line == g_video_signal.number_of_lines;
+        }
+
+        interrupt_lines += d->eof;
+        d->owner = 1;
+        d->length = dma_buffer_size_bytes;
+        d->size = dma_buffer_size_bytes;
+        d->empty = (uint32_t)(uintptr_t)&g_field_chain[(i+1) % g_video_signal.number_of_lines];
+    }
+
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+    // walk back from the last line, it always has the eof flag
+    const int last = g_video_signal.number_of_lines-1;
+    for(int i=last-1; i>=0; i--)
+    {
+        g_field_lines_to_eof[i] = g_field_chain[i+1].eof ? 1 : g_field_lines_to_eof[i+1]+1;
+    }
+    g_field_lines_to_eof[last] = g_field_chain[0].eof ? 1 : g_field_lines_to_eof[0]+1;
+#endif
+    I2S0.out_link.addr = (uint32_t)(uintptr_t)&g_field_chain[0];
+    ESP_LOGI(TAG, "Field DMA chain configured. Descriptors: %u, interrupts per field: %d", g_video_signal.number_of_lines, interrupt_lines);
+}
+
+static void free_field_dma_chain(void)
+{
+    if( g_field_chain )
+    {
+        ESP_LOGD(TAG, "Free field DMA chain");
+        heap_caps_free(g_field_chain);
+        g_field_chain = NULL;
+    }
+
+    for(int t=0; t<LINE_TEMPLATE_COUNT; t++)
+    {
+        if( g_line_templates[t] )
+        {
+            heap_caps_free(g_line_templates[t]);
+            g_line_templates[t] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Interrupt handler work in whole field DMA mode.
+ * 
+ * \a g_fill_desc is the descriptor of the line just sent. Only visible lines
+ * are rendered, into the descriptor two lines ahead which uses the same line buffer.
+ */
+static inline IRAM_ATTR void field_render_scan_line(void)
+{
+    static bool frame_field = true;
+    const int line = g_fill_desc - g_field_chain + 1;
+    const int visible_end = g_video_signal.offset_y_lines + g_video_signal.height_pixels;
+
+#if CONFIG_VIDEO_TRIGGER_MODE_LINE
+    DIAG_PIN_HI();
+#endif
+
+    if( line < visible_end )
+    {
+        g_current_scan_line = line + DMA_LINE_BUFFER_COUNT;
+        if( g_current_scan_line < visible_end )
+        {
+            g_fill_desc = &g_field_chain[g_current_scan_line-1];
+            PIXEL_STOPWATCH_START();
+            g_video_signal.pixel_render_func();
+            PIXEL_STOPWATCH_STOP();
+        }
+    }
+    else if( line == visible_end )
+    {
+        flip_frame_buffer();
+        if( frame_field )
+        {
+            // All visible lines passed
+            xEventGroupSetBits(g_video_event_group, COMPOSITE_EVENT_FRAME_VISIBLE_END_BIT);
+        }
+    }
+    else // last line of the field
+    {
+#if CONFIG_VIDEO_TRIGGER_MODE_FIELD
+        DIAG_PIN_LO();
+#endif
+        xEventGroupClearBits( g_video_event_group,
+            COMPOSITE_EVENT_FRAME_END_BIT |
+            COMPOSITE_EVENT_FRAME_VISIBLE_END_BIT
+        );
+        if( frame_field )
+        {
+            xEventGroupSetBits(g_video_event_group, COMPOSITE_EVENT_FRAME_END_BIT);
+        }
+        frame_field = !frame_field;
+
+        if( g_video_signal.frame_buffer_format != FB_FORMAT_DAC_NATIVE )
+        {
+            // first visible lines of the next field, the rest is rendered as they are sent
+            for(int n=0; n<DMA_LINE_BUFFER_COUNT; n++)
+            {
+                g_current_scan_line = g_video_signal.offset_y_lines + n;
+                g_fill_desc = &g_field_chain[g_current_scan_line-1];
+                g_video_signal.pixel_render_func();
+            }
+        }
+#if CONFIG_VIDEO_TRIGGER_MODE_FIELD
+        DIAG_PIN_HI();
+#endif
+    }
+
+#if CONFIG_VIDEO_TRIGGER_MODE_LINE
+    DIAG_PIN_LO();
+#endif
+}
+#endif
+
+/**
+ * @brief Makes the frame buffer passed to \a video_present() the scanned one.
+ * 
+ * Called once the DMA sent the last visible line so the new image starts with the
+ * next field and nothing reads the old one any more.
+ */
+static inline IRAM_ATTR void flip_frame_buffer(void)
+{
+    uint8_t* fb = g_pending_frame_buffer;
+
+#if CONFIG_VIDEO_DITHER
+    g_dither_field++;
+#endif
+
+    if( fb )
+    {
+        g_video_signal.frame_buffer = fb;
+        g_pending_frame_buffer = NULL;
+        g_flip_time_us = esp_timer_get_time();
+        g_flip_frame_buffer = fb;
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+        if( g_video_signal.frame_buffer_format == FB_FORMAT_DAC_NATIVE )
+        {
+            // visible line descriptors point straight into the frame buffer
+            for(int y=0; y<g_video_signal.height_pixels; y++)
+            {
+                g_field_chain[g_video_signal.offset_y_lines + y - 1].buf = NATIVE_LINE_UINT8(y);
+            }
+        }
+#endif
+        xEventGroupSetBits(g_video_event_group, COMPOSITE_EVENT_FRAME_PRESENTED_BIT);
+    }
+}
+
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+/**
+ * @brief Interrupt handler work in line DMA mode.
+ * 
+ * Refills every ring descriptor sent since the last interrupt, in order, with
+ * the next scan lines. Normally that is one batch but a late interrupt catches
+ * up on everything sent so far. The lines still queued at entry (lead) are
+ * tracked to show how close the ring came to running dry.
+ * 
+ * @param eof_desc last descriptor with the eof flag the DMA finished
+ * @return lead, lines still queued for the DMA at entry
+ */
+static inline IRAM_ATTR int ring_render_scan_lines(lldesc_t* eof_desc)
+{
+    const int eof_index = eof_desc - dma_buffers;
+    const uint32_t now = esp_cpu_get_ccount();
+    int sent = (eof_index - g_ring_fill_index + 1 + DMA_LINE_BUFFER_COUNT) % DMA_LINE_BUFFER_COUNT;
+
+    if( sent == 0 || now - g_ring_last_ccount > g_ring_cycles )
+    {
+        // whole ring sent, the DMA is repeating old lines
+        sent = DMA_LINE_BUFFER_COUNT;
+        g_ring_stats.underruns++;
+    }
+    g_ring_last_ccount = now;
+
+    if( sent > g_ring_stats.max_sent_lines )
+    {
+        g_ring_stats.max_sent_lines = sent;
+    }
+    const int lead = DMA_LINE_BUFFER_COUNT - sent;
+    if( lead < g_ring_stats.min_lead_lines )
+    {
+        g_ring_stats.min_lead_lines = lead;
+    }
+
+    while( sent-- )
+    {
+        g_fill_desc = &dma_buffers[g_ring_fill_index];
+        if( g_video_signal.frame_buffer_format == FB_FORMAT_DAC_NATIVE )
+        {
+            // take the descriptor back from the frame buffer, it is pointed there again for visible lines
+            g_fill_desc->buf = dma_line_buffers[g_ring_fill_index];
+        }
+
+        if( g_ring_flip_lines && --g_ring_flip_lines == 0 )
+        {
+            // the DMA sent the last visible line
+            flip_frame_buffer();
+        }
+
+        if( g_video_signal.video_mode >= VIDEO_MODE_NTSC )
+            ntsc_render_scan_line();
+        else
+            pal_render_scan_line();
+
+        if( g_current_scan_line == g_video_signal.offset_y_lines+g_video_signal.height_pixels )
+        {
+            // the last visible lines are still queued, FB_FORMAT_DAC_NATIVE descriptors point
+            // into the frame buffer, so it flips when the descriptor of the last one comes back
+            g_ring_flip_lines = DMA_LINE_BUFFER_COUNT-1;
+        }
+
+        g_ring_fill_index = (g_ring_fill_index+1) % DMA_LINE_BUFFER_COUNT;
+    }
+
+    return lead;
+}
+
+/**
+ * @brief Gets the line DMA ring fill statistics.
+ * 
+ * @param stats where to store the statistics, may be NULL
+ * @param reset start a new measurement
+ */
+void video_get_ring_stats(VIDEO_RING_STATS* stats, bool reset)
+{
+    if( stats )
+    {
+        *stats = g_ring_stats;
+        stats->ring_lines = DMA_LINE_BUFFER_COUNT;
+        stats->batch_lines = DMA_RING_BATCH_LINES;
+    }
+
+    if( reset )
+    {
+        // single 32 bit stores, safe against the interrupt
+        g_ring_stats.max_sent_lines = 0;
+        g_ring_stats.min_lead_lines = DMA_LINE_BUFFER_COUNT;
+        g_ring_stats.underruns = 0;
+    }
+}
+#endif
+
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+#define ISR_HISTOGRAM_BUCKET_CYCLES (CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ*VIDEO_ISR_HISTOGRAM_BUCKET_NS/1000)
+
+// Only written by the interrupt, readers copy it without locking. Reset is
+// requested through a flag so the interrupt never loses a count to a reader.
+static VIDEO_ISR_HISTOGRAM DRAM_ATTR g_isr_histogram;
+static volatile bool DRAM_ATTR g_isr_histogram_reset = true;
+static uint32_t DRAM_ATTR g_isr_last_entry_ccount;
+/// Expected distance to the next interrupt entry, 0 when unknown
+static uint32_t DRAM_ATTR g_isr_period_cycles;
+static uint32_t DRAM_ATTR g_isr_line_cycles;
+
+static inline IRAM_ATTR int isr_histogram_bucket(uint32_t cycles)
+{
+    const uint32_t bucket = cycles/ISR_HISTOGRAM_BUCKET_CYCLES;
+    return bucket < VIDEO_ISR_HISTOGRAM_BUCKETS ? bucket : VIDEO_ISR_HISTOGRAM_BUCKETS-1;
+}
+
+/**
+ * @brief Records one interrupt in the histograms.
+ * 
+ * @param entry CPU cycle count at interrupt entry
+ * @param line scan line the interrupt worked for, classifies the interrupt
+ * @param lead_lines lines queued for the DMA at entry, the time left to finish
+ * @param next_period_lines lines until the next interrupt is due
+ */
+static inline IRAM_ATTR void isr_histogram_record(uint32_t entry, int line, int lead_lines, int next_period_lines)
+{
+    const uint32_t duration = esp_cpu_get_ccount() - entry;
+    const uint32_t period = entry - g_isr_last_entry_ccount;
+    const LINE_TYPE line_type = get_line_type(line);
+    const int type = line_type == LINE_VISIBLE ? VIDEO_ISR_LINE_VISIBLE :
+        (line_type == LINE_BLANK ? VIDEO_ISR_LINE_BLANK : VIDEO_ISR_LINE_VSYNC);
+    uint32_t late = 0;
+
+    g_isr_histogram.duration[type][isr_histogram_bucket(duration)]++;
+    if( g_isr_period_cycles )
+    {
+        late = period > g_isr_period_cycles ? period - g_isr_period_cycles : 0;
+        g_isr_histogram.jitter[type][isr_histogram_bucket(late ? late : g_isr_period_cycles - period)]++;
+    }
+
+    g_isr_last_entry_ccount = entry;
+    g_isr_period_cycles = next_period_lines * g_isr_line_cycles;
+
+    // late entry eats into the lead too
+    const uint32_t lead = lead_lines * g_isr_line_cycles;
+    if( late + duration + CONFIG_VIDEO_DIAG_ISR_NEAR_UNDERRUN_US*CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ > lead )
+    {
+        g_isr_histogram.near_underruns[type]++;
+    }
+}
+
+/**
+ * @brief Clears the histograms, called by the interrupt when requested.
+ */
+static IRAM_ATTR void isr_histogram_reset(void)
+{
+    uint32_t* p = (uint32_t*)&g_isr_histogram;
+    for(int i=0; i<sizeof(g_isr_histogram)/sizeof(uint32_t); i++)
+    {
+        p[i] = 0;
+    }
+
+    // line_duration_us is truncated, NTSC lines are 63.55 µs
+    g_isr_line_cycles = (uint64_t)g_video_signal.samples_per_line*CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ*1000000/g_video_signal.dac_frequency;
+    g_isr_period_cycles = 0; // no previous entry to measure jitter against
+    g_isr_histogram_reset = false;
+}
+
+/**
+ * @brief Gets the interrupt duration and entry jitter histograms.
+ * 
+ * The copy is not atomic, an interrupt may land in the middle. Counts of
+ * a few buckets may then be one interrupt ahead of the rest.
+ * 
+ * @param histogram where to store the histograms, may be NULL
+ * @param reset start a new measurement with the next interrupt
+ */
+void video_get_isr_histogram(VIDEO_ISR_HISTOGRAM* histogram, bool reset)
+{
+    if( histogram )
+    {
+        memcpy(histogram, &g_isr_histogram, sizeof(VIDEO_ISR_HISTOGRAM));
+    }
+
+    if( reset )
+    {
+        g_isr_histogram_reset = true;
+    }
+}
+
+/**
+ * @brief Calculates a percentile from a histogram.
+ * 
+ * @param buckets one histogram of \c VIDEO_ISR_HISTOGRAM
+ * @param per_mille percentile in 0.1% units, e.g. 500 for p50 or 999 for p99.9
+ * @return upper edge of the bucket holding the percentile in ns, 0 if the histogram is empty
+ */
+uint32_t video_isr_histogram_percentile_ns(const uint32_t* buckets, uint32_t per_mille)
+{
+    uint64_t total = 0;
+    for(int i=0; i<VIDEO_ISR_HISTOGRAM_BUCKETS; i++)
+    {
+        total += buckets[i];
+    }
+
+    if( total == 0 )
+    {
+        return 0;
+    }
+
+    // smallest bucket with at least per_mille of the samples at or below it
+    const uint64_t rank = (total*per_mille + 999)/1000;
+    uint64_t count = 0;
+    int i;
+    for(i=0; i<VIDEO_ISR_HISTOGRAM_BUCKETS-1; i++)
+    {
+        count += buckets[i];
+        if( count >= rank )
+        {
+            break;
+        }
+    }
+
+    return (i+1)*VIDEO_ISR_HISTOGRAM_BUCKET_NS;
+}
+#endif
+
+// Interrupt rate and load, always counted: two cycle counter reads per interrupt
+static uint32_t DRAM_ATTR g_isr_count;
+static uint32_t DRAM_ATTR g_isr_busy_cycles;
+static int64_t g_isr_stats_start_us;
+
+/**
+ * @brief Gets the number of video interrupts and the CPU cycles they took.
+ * 
+ * The busy cycle count wraps after about 17 s of interrupt time at 240 MHz,
+ * read the statistics at least every few seconds.
+ * 
+ * @param stats where to store the statistics, may be NULL
+ * @param reset start a new measurement
+ */
+void video_get_isr_stats(VIDEO_ISR_STATS* stats, bool reset)
+{
+    const int64_t now_us = esp_timer_get_time();
+
+    if( stats )
+    {
+        stats->interrupts = g_isr_count;
+        stats->busy_cycles = g_isr_busy_cycles;
+        stats->elapsed_us = now_us - g_isr_stats_start_us;
+    }
+
+    if( reset )
+    {
+        // an interrupt in between may be lost, not worth a critical section
+        g_isr_count = 0;
+        g_isr_busy_cycles = 0;
+        g_isr_stats_start_us = now_us;
+    }
+}
+
+static void IRAM_ATTR i2s_interrupt(void *dma_buffer_size_bytes)
+{
+	if (I2S0.int_st.out_eof)
+	{
+#if CONFIG_VIDEO_TRIGGER_MODE_ISR
+        DIAG_PIN_HI();
+#endif
+        INTERRUPT_STOPWATCH_START();
+        const uint32_t entry = esp_cpu_get_ccount();
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+        if( g_isr_histogram_reset )
+        {
+            isr_histogram_reset();
+        }
+#endif
+
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+        g_fill_desc = (lldesc_t*)(uintptr_t)I2S0.out_eof_des_addr;
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+        // the line sent, the next one is on air while a visible line two ahead is rendered
+        const lldesc_t* sent_desc = g_fill_desc;
+#endif
+        field_render_scan_line();
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+        isr_histogram_record(entry, sent_desc - g_field_chain + 1, DMA_LINE_BUFFER_COUNT-1, g_field_lines_to_eof[sent_desc - g_field_chain]);
+#endif
+#else
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+        // first line refilled, the one with the closest deadline
+        const int line = g_current_scan_line + 1;
+        const int lead = ring_render_scan_lines((lldesc_t*)(uintptr_t)I2S0.out_eof_des_addr);
+        isr_histogram_record(entry, line, lead, DMA_RING_BATCH_LINES);
+#else
+        ring_render_scan_lines((lldesc_t*)(uintptr_t)I2S0.out_eof_des_addr);
+#endif
+#endif
+
+        g_isr_count++;
+        g_isr_busy_cycles += esp_cpu_get_ccount() - entry;
+        INTERRUPT_STOPWATCH_STOP();
+#if CONFIG_VIDEO_TRIGGER_MODE_ISR
+        DIAG_PIN_LO();
+#endif
+	}
+
+	// reset the interrupt
+    I2S0.int_clr.val = I2S0.int_st.val;
+}
+
+
+#if CONFIG_VIDEO_DIAG_ENABLE_INTERRUPT_STATS
+/**
+ * @brief Converts 8bpp pixels using the per pixel multiply/divide the renderer used
+ * before the DAC lookup table was added.
+ * 
+ * Only used by \a video_show_stats() to show the cost of both methods.
+ */
+static void __attribute__((noinline)) stats_convert_pixels_arith(const uint32_t* s, uint32_t* p, size_t len)
+{
+    const uint32_t factor_x1000 = ((DAC_LEVEL_WHITE-DAC_LEVEL_BLACK)*1000)/255;
+    uint32_t p4;
+
+    while(len--)
+    {
+        p4 = *s;
+        s++;
+
+        uint8_t pixel1 = DAC_LEVEL_BLACK + (((p4 & 0xFF000000) >> 24) * factor_x1000)/1000;
+        uint8_t pixel2 = DAC_LEVEL_BLACK + (((p4 & 0x00FF0000) >> 16) * factor_x1000)/1000;
+        uint8_t pixel3 = DAC_LEVEL_BLACK + (((p4 & 0x0000FF00) >> 8 ) * factor_x1000)/1000;
+        uint8_t pixel4 = DAC_LEVEL_BLACK + (((p4 & 0x000000FF) >> 0 ) * factor_x1000)/1000;
+
+        *p = pixel4 << 24 | pixel3 << 8;
+        p++;
+
+        *p = pixel2 << 24 | pixel1 << 8; 
+        p++;
+    }
+}
+
+static void __attribute__((noinline)) stats_convert_pixels_lut(const uint32_t* s, uint32_t* p, size_t len)
+{
+    convert_pixels_grey_8bpp(s, p, len);
+}
+
+/**
+ * @brief Logs the CPU cost of converting one 8bpp scan line with multiply/divide
+ * and with the DAC lookup table.
+ * 
+ * Best of a few runs is used to filter out task switches and interrupts.
+ */
+static void show_line_cost_stats(void)
+{
+    const size_t len = g_video_signal.width_pixels/4;
+    uint32_t arith_cycles = UINT32_MAX;
+    uint32_t lut_cycles = UINT32_MAX;
+    uint32_t t;
+
+    uint32_t* line = heap_caps_malloc(g_video_signal.width_pixels*sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT);
+    if( NULL == line )
+    {
+        return;
+    }
+
+    for(int i=0; i<4; i++)
+    {
+        t = esp_cpu_get_ccount();
+        stats_convert_pixels_arith((uint32_t*)g_video_signal.frame_buffer, line, len);
+        arith_cycles = MIN(esp_cpu_get_ccount()-t, arith_cycles);
+
+        t = esp_cpu_get_ccount();
+        stats_convert_pixels_lut((uint32_t*)g_video_signal.frame_buffer, line, len);
+        lut_cycles = MIN(esp_cpu_get_ccount()-t, lut_cycles);
+    }
+
+    heap_caps_free(line);
+
+    ESP_LOGI(TAG, "Line cost: multiply/divide %" PRIu32 " cycles (%" PRIu32 " µs), LUT %" PRIu32 " cycles (%" PRIu32 " µs)",
+        arith_cycles, arith_cycles/CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+        lut_cycles, lut_cycles/CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+}
+
+void video_show_stats(void)
+{
+    uint32_t pixel_avg_us = g_pixel_total_us/g_pixel_calls_count;
+    int64_t now_us = esp_timer_get_time();
+    uint32_t elapsed_ms = (now_us - g_stats_start_us)/1000;
+
+    ESP_LOGI(TAG, "Interrupt MAX: %" PRIu32 " µs, MIN: %" PRIu32 " µs. Pixel AVG: %" PRIu32 " µs", g_interrupt_max, g_interrupt_min, pixel_avg_us );
+
+    if( elapsed_ms != 0 )
+    {
+        // load in 0.01% units: us/ms = 0.1%
+        uint32_t load = (uint32_t)(((uint64_t)g_interrupt_total_us*10)/elapsed_ms);
+        ESP_LOGI(TAG, "Interrupts: %" PRIu32 "/s, CPU load %" PRIu32 ".%02" PRIu32 "%%", (uint32_t)(((uint64_t)g_interrupt_count*1000)/elapsed_ms), load/100, load%100);
+    }
+
+    if( g_video_signal.pixel_render_func == render_pixels_grey_8bpp )
+    {
+        show_line_cost_stats();
+    }
+
+    g_pixel_total_us = g_pixel_calls_count = 0;
+    g_interrupt_min = UINT32_MAX;
+    g_interrupt_max = 0;
+    g_interrupt_total_us = g_interrupt_count = 0;
+    g_stats_start_us = now_us;
+}
+#endif
+
+void video_graphics(GRAPHICS_MODE mode, FRAME_BUFFER_FORMAT fb_format)
+{
+    switch( mode )
+    {
+        case PAL_384x288:
+            video_init(384, 288, fb_format, VIDEO_MODE_PAL, false);
+            break;
+
+        case PAL_768x288:
+            video_init(768, 288, fb_format, VIDEO_MODE_PAL, true);
+            break;
 
         case PAL_360x288:
             video_init(360, 288, fb_format, VIDEO_MODE_PAL_BT601, false);
@@ -1086,7 +2159,187 @@ uint8_t* video_get_frame_buffer_address(void)
 
 uint8_t* video_get_frame_buffer_size(void)
 {
-    return (uint8_t*)g_video_signal.frame_buffer_size_bytes;
+    return (uint8_t*)(uintptr_t)g_video_signal.frame_buffer_size_bytes;
+}
+
+/**
+ * @brief Gets a frame buffer that is not sent and not waiting to be sent.
+ * 
+ * With two frame buffers and one already passed to \a video_present() this waits
+ * until the flip happened, at most one field. With a single frame buffer the
+ * scanned one is returned and drawing into it may tear.
+ * 
+ * @return frame buffer to draw the next image in, then pass it to \a video_present()
+ */
+uint8_t* video_get_back_buffer(void)
+{
+    const TickType_t xTicksToWait = 100 / portTICK_PERIOD_MS;
+
+    if( g_frame_buffer_count <= 1 )
+    {
+        // NULL in FB_FORMAT_LINE_CALLBACK format
+        return g_frame_buffers[0];
+    }
+
+    while(1)
+    {
+        // read pending first, if the interrupt flips in between both are the same buffer
+        uint8_t* pending = g_pending_frame_buffer;
+        uint8_t* front = g_video_signal.frame_buffer;
+
+        for(int n=0; n<g_frame_buffer_count; n++)
+        {
+            if( g_frame_buffers[n] != front && g_frame_buffers[n] != pending )
+            {
+                return g_frame_buffers[n];
+            }
+        }
+
+        xEventGroupWaitBits(
+                g_video_event_group,
+                COMPOSITE_EVENT_FRAME_PRESENTED_BIT,
+                pdTRUE,
+                pdFALSE,
+                xTicksToWait );
+    }
+}
+
+/**
+ * @brief Sets the function producing visible lines in \c FB_FORMAT_LINE_CALLBACK format.
+ * 
+ * The callback is called from the I²S interrupt for every visible line, a few
+ * lines ahead of the beam. It must be in IRAM, only touch internal RAM and
+ * return within one scan line including the DAC level conversion.
+ * 
+ * @param callback function writing width_pixels grey values, 0 black to 255 white
+ */
+void video_set_line_callback(p_video_line_callback callback)
+{
+    g_line_callback = callback;
+}
+
+/**
+ * @brief Sets scaling done while lines are sent, so a smaller frame buffer fills the screen.
+ * 
+ * Only used in \c FB_FORMAT_GREY_8BPP format. Call before \a video_init(), which
+ * then allocates frame buffers of \a g_video_signal.fb_width_pixels by
+ * \a g_video_signal.fb_height_pixels. The width and height passed to
+ * \a video_init() stay the size on screen.
+ * 
+ * @param scale_x send every frame buffer pixel twice, or with interpolated pixels in between
+ * @param repeat_lines send every frame buffer line twice
+ */
+void video_set_scaling(VIDEO_SCALE_X scale_x, bool repeat_lines)
+{
+    g_scale_x = scale_x;
+    g_repeat_lines = repeat_lines;
+}
+
+/**
+ * @brief Gets the cost of lines rendered by the line callback.
+ * 
+ * @param stats where to store the statistics, may be NULL
+ * @param reset start a new measurement
+ */
+void video_get_line_callback_stats(VIDEO_LINE_CALLBACK_STATS* stats, bool reset)
+{
+    if( stats )
+    {
+        *stats = g_line_callback_stats;
+    }
+
+    if( reset )
+    {
+        // line_duration_us is truncated, NTSC lines are 63.55 µs
+        g_line_callback_stats.budget_cycles = (uint64_t)g_video_signal.samples_per_line*CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ*1000000/g_video_signal.dac_frequency;
+        g_line_callback_stats.max_cycles = 0;
+        g_line_callback_stats.overruns = 0;
+        g_line_callback_stats.lines = 0;
+    }
+}
+
+/**
+ * @brief Shows a frame buffer from the next field on.
+ * 
+ * Only the scan out pointer is swapped, after the last visible line, so the
+ * call returns immediately and the image never tears. Presenting again before
+ * the flip replaces the waiting frame buffer.
+ * 
+ * @param fb frame buffer from \a video_get_back_buffer()
+ */
+void video_present(uint8_t* fb)
+{
+#ifndef NDEBUG
+    bool known = false;
+    for(int n=0; n<g_frame_buffer_count; n++)
+    {
+        known |= fb == g_frame_buffers[n];
+    }
+    assert(known);
+#endif
+
+    if( fb == g_video_signal.frame_buffer )
+    {
+        // single buffer, already shown
+        g_flip_time_us = esp_timer_get_time();
+        g_flip_frame_buffer = fb;
+        return;
+    }
+
+    xEventGroupClearBits(g_video_event_group, COMPOSITE_EVENT_FRAME_PRESENTED_BIT);
+    g_pending_frame_buffer = fb;
+}
+
+/**
+ * @brief Gets the frame buffer that last became the scanned one and when.
+ * 
+ * The flip happens after the last visible line, so the time is the start of the
+ * vertical blanking before the first field showing the frame buffer. With a single
+ * frame buffer it is the time of \a video_present().
+ * 
+ * @param fb where to store the frame buffer, NULL if none was presented yet
+ * @return time of the flip in µs since boot (esp_timer)
+ */
+int64_t video_get_flip_time(uint8_t** fb)
+{
+    uint8_t* f;
+    int64_t t;
+
+    // the interrupt may flip in between, read until both are from the same flip
+    do
+    {
+        f = g_flip_frame_buffer;
+        t = g_flip_time_us;
+    } while( f != g_flip_frame_buffer || t != g_flip_time_us );
+
+    *fb = f;
+    return t;
+}
+
+/**
+ * @brief Writes one line of grey pixels into a \c FB_FORMAT_DAC_NATIVE frame buffer.
+ * 
+ * Pixels are converted to DAC levels and stored in the I²S sample order. Sync and
+ * porches of the line are left untouched.
+ * 
+ * @param y line number, 0 to height-1
+ * @param pixels width_pixels grey values, 0 black to 255 white
+ */
+void video_native_put_line(uint16_t y, const uint8_t* pixels)
+{
+    assert(g_video_signal.frame_buffer_format == FB_FORMAT_DAC_NATIVE);
+    assert(y < g_video_signal.height_pixels);
+
+    uint32_t* p = (uint32_t*)NATIVE_LINE_UINT8(y) + g_video_signal.offset_x_samples/2;
+    size_t len = g_video_signal.width_pixels/2;
+
+    while(len--)
+    {
+        // DAC uses MSB byte of uint16_t, upper half word is sent first
+        *p = g_dac_lut_8bpp[pixels[0]] << 24 | g_dac_lut_8bpp[pixels[1]] << 8;
+        p++;
+        pixels += 2;
+    }
 }
 
 uint16_t video_get_width(void)
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define COMPOSITE_EVENT_FRAME_END_BIT (1<<0)
 #define COMPOSITE_EVENT_FRAME_VISIBLE_END_BIT (1<<1)
 #define COMPOSITE_EVENT_LINE_STARTS_BIT (1<<2)
+#define COMPOSITE_EVENT_FRAME_PRESENTED_BIT (1<<3)
 
 /**
  * @brief Video modes.
@@ -107,13 +108,44 @@ typedef enum _FRAME_BUFFER_FORMAT
     FB_FORMAT_GREY_8BPP, ///< in theory 256 shadows, in practice 77-23=54 when no voltage divider used for DAC output, or 180 with voltage divider.
     FB_FORMAT_RGB_8BPP, ///< 3-3-2 color
     FB_FORMAT_RGB_16BPP, ///< 5-6-5 color
+    FB_FORMAT_DAC_NATIVE, ///< full scan lines stored as DAC samples (incl. sync and porches), sent by DMA without copying
+    FB_FORMAT_LINE_CALLBACK, ///< no frame buffer, 8 bit grey lines produced on demand by \a video_set_line_callback()
 #if CONFIG_VIDEO_ENABLE_LVGL_SUPPORT
     FB_FORMAT_LVGL_1BPP, //< 1 bit color, pixel stored in one byte. LVGL video_graphics library compatible.
 #endif
 } FRAME_BUFFER_FORMAT;
 
+/**
+ * @brief Horizontal scaling done while lines are sent, \c FB_FORMAT_GREY_8BPP only.
+ */
+typedef enum _VIDEO_SCALE_X
+{
+    VIDEO_SCALE_X_NONE, ///< one frame buffer pixel per pixel on screen
+    VIDEO_SCALE_X_DOUBLE, ///< half width frame buffer, every pixel sent twice
+    VIDEO_SCALE_X_INTERP, ///< half width frame buffer, pixels interpolated in between
+} VIDEO_SCALE_X;
+
 typedef void (*p_pixel_render_func)(void);
 
+/**
+ * @brief Produces one visible line in \c FB_FORMAT_LINE_CALLBACK format.
+ * 
+ * @param y line number, 0 to height-1
+ * @param line width_pixels grey values to fill, 0 black to 255 white
+ */
+typedef void (*p_video_line_callback)(uint16_t y, uint8_t* line);
+
+/**
+ * @brief Cost of lines in \c FB_FORMAT_LINE_CALLBACK format, in CPU cycles.
+ */
+typedef struct _VIDEO_LINE_CALLBACK_STATS
+{
+    uint32_t budget_cycles; ///< one scan line
+    uint32_t max_cycles; ///< slowest line (callback and DAC conversion)
+    uint32_t overruns; ///< lines slower than the budget
+    uint32_t lines; ///< lines rendered
+} VIDEO_LINE_CALLBACK_STATS;
+
 typedef struct _VIDEO_SIGNAL_PARAMS
 {
     VIDEO_MODE video_mode;
@@ -132,12 +164,72 @@ typedef struct _VIDEO_SIGNAL_PARAMS
     uint32_t dac_frequency; ///< DAC frequency in Hz
 
     uint8_t* frame_buffer;
+    FRAME_BUFFER_FORMAT frame_buffer_format;
+    uint16_t fb_width_pixels; ///< frame buffer width, half of width_pixels when scaled horizontally
+    uint16_t fb_height_pixels; ///< frame buffer height, half of height_pixels when lines are repeated
+    VIDEO_SCALE_X scale_x;
+    bool repeat_lines;
     uint8_t bits_per_pixel;
     uint32_t frame_buffer_size_bytes;
     void (*pixel_render_func)(void);
 
 } VIDEO_SIGNAL_PARAMS;
 
+/**
+ * @brief Video interrupt rate and CPU load since the last reset.
+ */
+typedef struct _VIDEO_ISR_STATS
+{
+    uint32_t interrupts; ///< interrupts handled
+    uint32_t busy_cycles; ///< CPU cycles spent in the interrupt
+    uint32_t elapsed_us; ///< measurement time
+} VIDEO_ISR_STATS;
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+/**
+ * @brief Line DMA ring fill statistics.
+ * 
+ * Lead is the number of lines still queued for the DMA when the interrupt
+ * starts refilling. Zero lead means the DMA sent stale lines.
+ */
+typedef struct _VIDEO_RING_STATS
+{
+    uint16_t ring_lines; ///< number of line buffers in the ring
+    uint16_t batch_lines; ///< lines refilled per interrupt when it is on time
+    uint16_t max_sent_lines; ///< high-water mark of sent lines waiting to be refilled
+    uint16_t min_lead_lines; ///< lowest lead seen
+    uint32_t underruns; ///< interrupts that found the whole ring sent
+} VIDEO_RING_STATS;
+#endif
+
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+#define VIDEO_ISR_HISTOGRAM_BUCKETS 64
+#define VIDEO_ISR_HISTOGRAM_BUCKET_NS 500 ///< last bucket also holds everything above 31.5 µs
+
+/**
+ * @brief Interrupt classes, by the type of scan line the interrupt worked for.
+ */
+typedef enum _VIDEO_ISR_LINE_TYPE
+{
+    VIDEO_ISR_LINE_VSYNC,
+    VIDEO_ISR_LINE_BLANK,
+    VIDEO_ISR_LINE_VISIBLE,
+    VIDEO_ISR_LINE_TYPES
+} VIDEO_ISR_LINE_TYPE;
+
+/**
+ * @brief Video interrupt timing histograms.
+ * 
+ * Jitter is the distance of the interrupt entry from the expected interrupt
+ * period (one line, or one batch of the line DMA ring), early or late.
+ */
+typedef struct _VIDEO_ISR_HISTOGRAM
+{
+    uint32_t duration[VIDEO_ISR_LINE_TYPES][VIDEO_ISR_HISTOGRAM_BUCKETS]; ///< interrupt run time
+    uint32_t jitter[VIDEO_ISR_LINE_TYPES][VIDEO_ISR_HISTOGRAM_BUCKETS]; ///< interrupt entry jitter
+    uint32_t near_underruns[VIDEO_ISR_LINE_TYPES]; ///< interrupts that finished less than CONFIG_VIDEO_DIAG_ISR_NEAR_UNDERRUN_US before the DMA ran dry
+} VIDEO_ISR_HISTOGRAM;
+#endif
+
 #if CONFIG_VIDEO_DIAG_DISPLAY_TEST_FUNC
 
 typedef enum _TEST_VIDEO_TYPE
@@ -158,13 +250,30 @@ extern volatile VIDEO_SIGNAL_PARAMS g_video_signal;
 void video_init(uint16_t width, uint16_t height, FRAME_BUFFER_FORMAT fb_format, VIDEO_MODE mode, bool hires_pixel_width);
 uint8_t* video_get_frame_buffer_address(void);
 uint8_t* video_get_frame_buffer_size(void);
+uint8_t* video_get_back_buffer(void);
+void video_present(uint8_t* fb);
+int64_t video_get_flip_time(uint8_t** fb);
+void video_set_line_callback(p_video_line_callback callback);
+void video_set_scaling(VIDEO_SCALE_X scale_x, bool repeat_lines);
+void video_get_line_callback_stats(VIDEO_LINE_CALLBACK_STATS* stats, bool reset);
 uint16_t video_get_width(void);
 uint16_t video_get_height(void);
 void video_graphics(GRAPHICS_MODE mode, FRAME_BUFFER_FORMAT fb_format);
 void video_wait_frame(void);
 void video_get_mode_description(char* buffer, size_t buffer_size);
+void video_native_put_line(uint16_t y, const uint8_t* pixels);
 void video_stop(void);
+void video_get_isr_stats(VIDEO_ISR_STATS* stats, bool reset);
+
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+void video_get_ring_stats(VIDEO_RING_STATS* stats, bool reset);
+#endif
 
 #if CONFIG_VIDEO_DIAG_ENABLE_INTERRUPT_STATS
 void video_show_stats(void);
+#endif
+
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+void video_get_isr_histogram(VIDEO_ISR_HISTOGRAM* histogram, bool reset);
+uint32_t video_isr_histogram_percentile_ns(const uint32_t* buckets, uint32_t per_mille);
 #endif
\ No newline at end of file
@@ -28,15 +28,19 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "lep_task.h"
 #include "lepton_utilities.h"
+#include "temporal_filter.h"
 #include "cci.h"
 #include "video_task.h"
 #include "vospi.h"
+#include "vsync_timing.h"
 #include "ps_utilities.h"
 #include "sys_utilities.h"
 #include "system_config.h"
@@ -49,6 +53,11 @@
 // Uncomment to log image acquisition timestamps
 //#define LOG_ACQ_TIMESTAMP
 
+// Uncomment to log the VSYNC period, jitter and the delay until this task runs
+// every LOG_VSYNC_TIMING_SECS seconds
+//#define LOG_VSYNC_TIMING
+#define LOG_VSYNC_TIMING_SECS 10
+
 // States
 #define STATE_INIT      0
 #define STATE_RUN       1
@@ -66,6 +75,18 @@ static const int lep_vsync_pin = BRD_LEP_VSYNC_IO;
 
 
 
+//
+// LEP Task Forward Declarations for internal functions
+//
+static bool lep_vsync_init();
+static void lep_vsync_isr(void* arg);
+static bool lep_vsync_wait(int64_t* vsyncUsec);
+#ifdef LOG_VSYNC_TIMING
+static void lep_vsync_log();
+#endif
+
+
+
 //
 // LEP Task API
 //
@@ -77,11 +98,13 @@ static const int lep_vsync_pin = BRD_LEP_VSYNC_IO;
 void lep_task()
 {
 	int task_state = STATE_INIT;
-	int vid_buf_index = 0;
 	int vsync_count = 0;
 	int sync_fail_count = 0;
 	int reset_fail_count = 0;
 	int64_t vsyncDetectedUsec;
+#ifdef LOG_VSYNC_TIMING
+	int64_t vsyncLogUsec = esp_timer_get_time();
+#endif
 	
 	ESP_LOGI(TAG, "Start task");
 	
@@ -99,9 +122,34 @@ void lep_task()
 		vTaskDelete(NULL);
 	}
 	
+	// Attempt to setup the VSYNC interrupt (allocated on this task's core)
+	if (!lep_vsync_init()) {
+		ESP_LOGE(TAG, "Lepton VSYNC interrupt initialization failed");
+		ctrl_set_fault_type(CTRL_FAULT_LEP_VOSPI);
+		vTaskDelete(NULL);
+	}
+	
 	// Setup lepton configuration
 	lep_config_t* lep_stP = lepton_get_lep_st();
+#ifdef SYS_HEQ_AGC
+	// Radiometric output with a histogram for vid_task to equalize
+	lep_stP->agc_set_enabled = false;
+	vospi_include_hist(true);
+#else
 	lep_stP->agc_set_enabled = true;
+#endif
+#ifdef SYS_TEMPORAL_FILTER
+	// History keeps 8 fraction bits for 8-bit AGC data
+#ifdef SYS_HEQ_AGC
+	if (tfilter_init(SYS_TF_STRENGTH, SYS_TF_NOISE_RAD, 0)) {
+#else
+	if (tfilter_init(SYS_TF_STRENGTH, SYS_TF_NOISE_AGC, 8)) {
+#endif
+		vospi_include_filter(true);
+	} else {
+		ESP_LOGE(TAG, "Temporal filter initialization failed");
+	}
+#endif
 	lep_stP->emissivity = ps_get_parm(PS_PARM_EMISSIVITY);
 	lep_stP->gain_mode = SYS_GAIN_AUTO;
 
@@ -121,31 +169,27 @@ void lep_task()
 				break;
 			
 			case STATE_RUN:   // Initialized and running
-				// Spin waiting for vsync to be asserted
-				while (gpio_get_level((gpio_num_t) lep_vsync_pin) == 0) {
-//					vTaskDelay(pdMS_TO_TICKS(9));
+				// Block until the VSYNC interrupt (leaves the core free between segments)
+				// then attempt to process a segment
+#ifdef LOG_VSYNC_TIMING
+				if ((esp_timer_get_time() - vsyncLogUsec) >= (LOG_VSYNC_TIMING_SECS * 1000000LL)) {
+					vsyncLogUsec = esp_timer_get_time();
+					lep_vsync_log();
 				}
-				vsyncDetectedUsec = esp_timer_get_time();
-				
-				// Attempt to process a segment
-				if (vospi_transfer_segment(vsyncDetectedUsec)) {
+#endif
+				if (lep_vsync_wait(&vsyncDetectedUsec) && vospi_transfer_segment(vsyncDetectedUsec)) {
 					// Got image
 					vsync_count = 0;
 					
-					// Copy the frame to the current half of the shared buffer and let vid_task know
-					xSemaphoreTake(vid_lep_buffer[vid_buf_index].lep_mutex, portMAX_DELAY);
-					vospi_get_frame(&vid_lep_buffer[vid_buf_index]);
-					xSemaphoreGive(vid_lep_buffer[vid_buf_index].lep_mutex);
+					// Load the frame into our shared buffer, make it the newest for vid_task
+					// and let it know
 #ifdef LOG_ACQ_TIMESTAMP
-					ESP_LOGI(TAG, "Push into buf %d", vid_buf_index);
+					ESP_LOGI(TAG, "Push into buf %d", tbuf_producer_index(&vid_lep_tbuf));
 #endif
-					if (vid_buf_index == 0) {
-						xTaskNotify(task_handle_vid, VID_NOTIFY_LEP_FRAME_MASK_1, eSetBits);
-						vid_buf_index = 1;
-					} else {
-						xTaskNotify(task_handle_vid, VID_NOTIFY_LEP_FRAME_MASK_2, eSetBits);
-						vid_buf_index = 0;
-					}
+					vospi_get_frame(&vid_lep_buffer[tbuf_producer_index(&vid_lep_tbuf)]);
+					vid_lep_buffer[tbuf_producer_index(&vid_lep_tbuf)].lep_stamps.handoff_usec = esp_timer_get_time();
+					tbuf_publish(&vid_lep_tbuf);
+					xTaskNotify(task_handle_vid, VID_NOTIFY_LEP_FRAME_MASK, eSetBits);
 					
 					// Clear the resynchronization fault indication if necessary (since we are working again)
 					if (sync_fail_count >= LEP_SYNC_FAIL_FAULT_LIMIT) {
@@ -206,6 +250,9 @@ void lep_task()
     			// Attempt to re-initialize the Lepton
     			if (lepton_init()) {
 					task_state = STATE_RUN;
+#ifdef SYS_TEMPORAL_FILTER
+					tfilter_reset();
+#endif
 					
 					// Note the reset
     				reset_fail_count = 1;
@@ -233,3 +280,82 @@ void lep_task()
 		}
 	}
 }
+
+
+
+//
+// LEP Task internal functions
+//
+
+/**
+ * Setup a rising edge interrupt on the Lepton VSYNC output
+ */
+static bool lep_vsync_init()
+{
+	esp_err_t ret;
+	
+	vsync_timing_reset();
+	
+	gpio_set_intr_type((gpio_num_t) lep_vsync_pin, GPIO_INTR_POSEDGE);
+	
+	// The ISR service may already have been installed by another module
+	ret = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+	if ((ret != ESP_OK) && (ret != ESP_ERR_INVALID_STATE)) {
+		return false;
+	}
+	
+	return (gpio_isr_handler_add((gpio_num_t) lep_vsync_pin, lep_vsync_isr, NULL) == ESP_OK);
+}
+
+
+/**
+ * VSYNC interrupt handler: timestamp the edge and wake lep_task
+ */
+static void IRAM_ATTR lep_vsync_isr(void* arg)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	
+	vsync_timing_edge(esp_timer_get_time());
+	vTaskNotifyGiveFromISR(task_handle_lep, &xHigherPriorityTaskWoken);
+	if (xHigherPriorityTaskWoken == pdTRUE) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+
+/**
+ * Wait for a VSYNC edge recent enough to read a segment.  Edges that occurred while
+ * the task was busy (e.g. delaying after a frame) are skipped.
+ *   vsyncUsec is set to the time of the edge
+ * Returns false if no edge was seen within LEP_VSYNC_TIMEOUT_MSEC
+ */
+static bool lep_vsync_wait(int64_t* vsyncUsec)
+{
+	while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LEP_VSYNC_TIMEOUT_MSEC)) != 0) {
+		*vsyncUsec = vsync_timing_last_edge();
+		if (vsync_timing_wake(*vsyncUsec, esp_timer_get_time())) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+#ifdef LOG_VSYNC_TIMING
+/**
+ * Log the VSYNC period and jitter over the last VSYNC_TS_LEN edges and the task
+ * wake statistics since the last log
+ */
+static void lep_vsync_log()
+{
+	vsync_stats_t st;
+	
+	vsync_timing_get_stats(LEP_FRAME_USEC, &st);
+	ESP_LOGI(TAG, "VSYNC: %u edges, period %d (%d - %d) uS, jitter %d uS, %u missed",
+	         st.edges, st.period_avg_usec, st.period_min_usec, st.period_max_usec,
+	         st.jitter_usec, st.missed);
+	ESP_LOGI(TAG, "  wake: %u, avg %d uS, max %d uS, %u late",
+	         st.wakes, st.wake_avg_usec, st.wake_max_usec, st.late);
+}
+#endif
@@ -41,6 +41,9 @@
 // Reset fail delay before attempting a re-init (seconds)
 #define LEP_RESET_FAIL_RETRY_SECS 60
 
+// Maximum time to wait for a VSYNC interrupt before counting a failed segment (mSec)
+#define LEP_VSYNC_TIMEOUT_MSEC 50
+
 
 
 //
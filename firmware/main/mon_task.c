@@ -27,8 +27,11 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "sys_utilities.h"
+#include "video.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 
 //
@@ -51,6 +54,15 @@ static void print_memory_stats();
 #ifdef MON_TASKS
 static void print_task_stats();
 #endif
+#ifdef MON_VIDEO
+static void print_video_stats();
+#endif
+#ifdef MON_FRAMES
+static void print_frame_stats();
+#endif
+#ifdef MON_LATENCY
+static void print_latency_stats();
+#endif
 
 
 
@@ -83,6 +95,15 @@ void mon_task()
 #ifdef MON_TASKS
 		print_task_stats();
 #endif
+#ifdef MON_VIDEO
+		print_video_stats();
+#endif
+#ifdef MON_FRAMES
+		print_frame_stats();
+#endif
+#ifdef MON_LATENCY
+		print_latency_stats();
+#endif
 
 		vTaskDelay(pdMS_TO_TICKS(MON_SAMPLE_MSEC));
 	}
@@ -184,3 +205,103 @@ static void print_task_stats()
     }
 }
 #endif
+
+
+#ifdef MON_VIDEO
+static void print_video_stats()
+{
+	VIDEO_ISR_STATS is;
+	uint32_t load;
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+	VIDEO_RING_STATS rs;
+#endif
+	
+	video_get_isr_stats(&is, true);
+	if (is.elapsed_us != 0) {
+		// Load in 0.01% units
+		load = (uint32_t) (((uint64_t) is.busy_cycles * 10000) / ((uint64_t) is.elapsed_us * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ));
+		ESP_LOGI(TAG, "Video ISR: %u interrupts/sec - CPU load: %u.%02u%%",
+		         (uint32_t) (((uint64_t) is.interrupts * 1000000) / is.elapsed_us), load / 100, load % 100);
+	}
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+	video_get_ring_stats(&rs, true);
+	ESP_LOGI(TAG, "Video DMA ring: %d lines, batch %d - Max sent: %d / Min lead: %d / Underruns: %u",
+	         rs.ring_lines, rs.batch_lines, rs.max_sent_lines, rs.min_lead_lines, rs.underruns);
+#endif
+	if (g_video_signal.frame_buffer_format == FB_FORMAT_LINE_CALLBACK) {
+		VIDEO_LINE_CALLBACK_STATS ls;
+		
+		video_get_line_callback_stats(&ls, true);
+		ESP_LOGI(TAG, "Video line callback: %u lines - Max: %u / Budget: %u cycles - Overruns: %u",
+		         ls.lines, ls.max_cycles, ls.budget_cycles, ls.overruns);
+	}
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+	static VIDEO_ISR_HISTOGRAM ih;   // too big for the stack
+	static const char* ih_names[VIDEO_ISR_LINE_TYPES] = {"vsync", "blank", "visible"};
+	
+	video_get_isr_histogram(&ih, true);
+	for (int i=0; i<VIDEO_ISR_LINE_TYPES; i++) {
+		ESP_LOGI(TAG, "Video ISR %s: duration p50 %u / p99 %u / p99.9 %u ns - jitter p50 %u / p99 %u / p99.9 %u ns - Near underruns: %u",
+		         ih_names[i],
+		         video_isr_histogram_percentile_ns(ih.duration[i], 500),
+		         video_isr_histogram_percentile_ns(ih.duration[i], 990),
+		         video_isr_histogram_percentile_ns(ih.duration[i], 999),
+		         video_isr_histogram_percentile_ns(ih.jitter[i], 500),
+		         video_isr_histogram_percentile_ns(ih.jitter[i], 990),
+		         video_isr_histogram_percentile_ns(ih.jitter[i], 999),
+		         ih.near_underruns[i]);
+	}
+#endif
+#if CONFIG_VIDEO_DIAG_ENABLE_INTERRUPT_STATS
+	video_show_stats();
+#endif
+}
+#endif
+
+
+#ifdef MON_FRAMES
+static void print_frame_stats()
+{
+	tbuf_counts_t c;
+	
+	tbuf_get_counts(&vid_lep_tbuf, &c);
+	ESP_LOGI(TAG, "Lepton frames: produced %u / consumed %u / dropped %u", c.produced, c.consumed, c.dropped);
+}
+#endif
+
+
+#ifdef MON_LATENCY
+static void print_latency_stats()
+{
+	static frame_latency_stats_t ls;   // too big for the stack
+	static char hist_buf[LAT_BUCKETS*12];
+	static uint32_t prev_dropped = 0;
+	tbuf_counts_t c;
+	int i, j, n;
+	
+	frame_latency_get_stats(&ls, true);
+	tbuf_get_counts(&vid_lep_tbuf, &c);
+	ESP_LOGI(TAG, "Frame latency: %u frames - Late: %u / Not shown: %u / Dropped: %u",
+	         ls.frames, ls.late, ls.not_shown, c.dropped - prev_dropped);
+	prev_dropped = c.dropped;
+	
+	for (i=0; i<LAT_NUM_STAGES; i++) {
+		ESP_LOGI(TAG, "Latency %s: p50 %u / p90 %u / p99 %u / max %u uS",
+		         frame_latency_stage_name(i),
+		         frame_latency_percentile_usec(ls.hist[i], 500),
+		         frame_latency_percentile_usec(ls.hist[i], 900),
+		         frame_latency_percentile_usec(ls.hist[i], 990),
+		         ls.max_usec[i]);
+		
+		// Non-empty buckets as bucket:count for a host tool
+		n = 0;
+		hist_buf[0] = 0;
+		for (j=0; j<LAT_BUCKETS; j++) {
+			if (ls.hist[i][j] != 0) {
+				n += snprintf(&hist_buf[n], sizeof(hist_buf) - n, " %d:%u", j, ls.hist[i][j]);
+			}
+		}
+		ESP_LOGI(TAG, "Latency %s hist (%d x %d uS):%s", frame_latency_stage_name(i), LAT_BUCKETS, LAT_BUCKET_USEC, hist_buf);
+	}
+}
+#endif
@@ -32,9 +32,13 @@
 #define MON_SAMPLE_MSEC 5000
 #define MON_MAX_TASKS   20
 
-// Uncomment to enable monitoring of memory and/or tasks
+// Uncomment to enable monitoring of memory, tasks, video, lepton frame exchange and/or
+// frame latency (the latency histograms can be summarized with tools/latency_report.py)
 #define MON_MEM
 #define MON_TASKS
+//#define MON_VIDEO
+//#define MON_FRAMES
+//#define MON_LATENCY
 
 // Uncomment for a more verbose memory monitoring output
 //#define MON_MEM_VERBOSE
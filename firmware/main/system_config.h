@@ -83,5 +83,45 @@
 // System configuration
 //
 
+// Uncomment to run the Lepton with its AGC disabled and equalize the radiometric
+// image on the ESP32 instead.  Temperatures remain available from the same frame.
+//#define SYS_HEQ_AGC
+
+// Histogram equalization parameters
+//   SYS_HEQ_PLATEAU    : Maximum count in any of the LEP_HIST_BINS histogram bins.  Limits
+//                        how much contrast large uniform areas (e.g. background) get.
+//   SYS_HEQ_CLIP_LIMIT : Number of pixels ignored at each end of the histogram so a few
+//                        very hot or cold pixels don't use up output levels.
+#define SYS_HEQ_PLATEAU    150
+#define SYS_HEQ_CLIP_LIMIT 20
+
+// Uncomment (with SYS_HEQ_AGC) to equalize each tile of a SYS_CLAHE_TILES_X x
+// SYS_CLAHE_TILES_Y grid separately and blend between them instead of equalizing
+// the whole image (contrast limited adaptive histogram equalization).  Keeps detail
+// on both sides of a large temperature split such as sky and ground.
+//#define SYS_HEQ_CLAHE
+
+// CLAHE parameters
+//   SYS_CLAHE_TILES_X, SYS_CLAHE_TILES_Y : Tile grid, must evenly divide the 160x120 image
+//   SYS_CLAHE_CLIP_LIMIT : Maximum count in a tile's histogram bins as a multiple of the
+//                          average count.  Lower values add less noise in uniform areas.
+#define SYS_CLAHE_TILES_X    8
+#define SYS_CLAHE_TILES_Y    6
+#define SYS_CLAHE_CLIP_LIMIT 3
+
+// Uncomment to run each lepton frame through a per-pixel recursive temporal filter
+// before it is displayed.  Reduces frame to frame noise on low contrast scenes.  Pixels
+// changing by more than the noise level are filtered less so moving objects don't smear.
+//#define SYS_TEMPORAL_FILTER
+
+// Temporal filter parameters
+//   SYS_TF_STRENGTH  : Weight (of 256) of a new pixel that is within the noise level.
+//                      Smaller values filter more (64 averages roughly the last 7 frames).
+//   SYS_TF_NOISE_AGC : Frame to frame pixel difference considered noise with 8-bit AGC data
+//   SYS_TF_NOISE_RAD : Frame to frame pixel difference considered noise with radiometric
+//                      data (TLinear counts)
+#define SYS_TF_STRENGTH  64
+#define SYS_TF_NOISE_AGC 4
+#define SYS_TF_NOISE_RAD 12
 
 #endif // SYSTEM_CONFIG_H
\ No newline at end of file
@@ -25,6 +25,8 @@
 #include <string.h>
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ctrl_task.h"
@@ -89,16 +91,28 @@ static const char* parm_u_name[] = {"Imperial", "Metric"};
 static const char* TAG = "vid_task";
 
 // Notifications (clear after use)
-static bool notify_image_1 = false;
-static bool notify_image_2 = false;
+static bool notify_image = false;
 static bool notify_parm_val_change = false;
 static bool notify_parm_sel_change = false;
 
 // Rendering GUI state
 static gui_state_t gui_state;
 
-// Video Driver Frame buffer pointer
-static uint8_t* drv_fbP;
+#ifdef VID_LINES_ON_DEMAND
+// 8-bit source images in internal RAM for the line callback
+static uint8_t* vid_srcP[2];
+static uint8_t* DRAM_ATTR vid_cur_srcP;            // Source the current field is rendered from
+static uint8_t* volatile DRAM_ATTR vid_next_srcP;  // Source for the next field, NULL if unchanged
+static bool DRAM_ATTR vid_line_interp;
+static lep_buffer_t* vid_overlay_lepP = NULL;      // Lepton frame the overlay was last built from
+static uint8_t* volatile DRAM_ATTR vid_flip_srcP;  // Source the line callback last switched to
+static volatile int64_t DRAM_ATTR vid_flip_usec;   //   and when
+#endif
+
+// Latency timestamps of the last frame given to the display, recorded once the display
+// shows it (vid_lat_shownP is its frame buffer or line callback source)
+static frame_stamps_t vid_lat_stamps;
+static uint8_t* vid_lat_shownP = NULL;
 
 // Parameter selection and modification
 static int cur_parm_index;
@@ -114,10 +128,17 @@ static char parm_string[80];
 // VID Task Forward Declarations for internal functions
 //
 static void _vid_handle_notifications();
-static void _vid_eval_parm_update();
+static bool _vid_eval_parm_update();
 static void _vid_render_image_pm554(bool pal_resolution);
-static void _vid_render_image(int render_buf_index);
-static void _vid_display_image(int render_buf_index);
+static void _vid_render_image(lep_buffer_t* lepP, uint8_t* rendP);
+static void _vid_build_overlay(lep_buffer_t* lepP);
+static void _vid_latency_rendered(lep_buffer_t* lepP, int64_t start_usec, uint8_t* shownP);
+static void _vid_latency_check();
+#ifdef VID_LINES_ON_DEMAND
+static bool _vid_init_lines_on_demand();
+static uint8_t* _vid_update_src(lep_buffer_t* lepP);
+static void _vid_line_callback(uint16_t y, uint8_t* line);
+#endif
 static int _vid_get_emissivity_index(int cur_e);
 static const char* _vid_get_parm_string();
 
@@ -129,6 +150,10 @@ static const char* _vid_get_parm_string();
 void vid_task()
 {
 	int vid_format;
+	uint16_t vid_width, vid_height;
+	uint8_t* rendP;
+	lep_buffer_t* lepP;
+	int64_t t;
 	
 	ESP_LOGI(TAG, "Start task");
 	
@@ -144,43 +169,101 @@ void vid_task()
 	gui_state.spotmeter_enable = (cur_parm_value & M_PARM_MARKER_MASK) == M_PARM_MARKER_MASK;
 	gui_state.temp_unit_C = ps_get_parm(PS_PARM_UNITS) != 0;
 	
+	if (!render_init()) {
+		ESP_LOGE(TAG, "Could not allocate glyph atlas - text will not be displayed");
+	}
+	
+#ifdef VID_LINES_ON_DEMAND
+	if (!_vid_init_lines_on_demand()) {
+		ESP_LOGE(TAG, "Could not allocate source buffers - bailing");
+		vTaskDelete(NULL);
+	}
+	
+	// Start the video subsystem with the appropriate video format.  The display
+	// is black until the first lepton frame.
+	ctrl_get_if_mode(&vid_format);
+	video_set_line_callback(_vid_line_callback);
+	if (vid_format == CTRL_VID_FORMAT_NTSC) {
+		video_init(IMG_BUF_WIDTH, IMG_BUF_HEIGHT, FB_FORMAT_LINE_CALLBACK, VIDEO_MODE_NTSC, false);
+	} else {
+		video_init(IMG_BUF_WIDTH, IMG_BUF_HEIGHT, FB_FORMAT_LINE_CALLBACK, VIDEO_MODE_PAL, false);
+	}
+	
+	while (1) {
+		_vid_handle_notifications();
+		
+		if (_vid_eval_parm_update() && (vid_overlay_lepP != NULL)) {
+			// Show the parameter change from the next field
+			_vid_build_overlay(vid_overlay_lepP);
+		}
+		
+		// Record the latency of the last frame if the display has picked it up
+		_vid_latency_check();
+		
+		// Convert the current lepton data for the line callback to display from the next field
+		if (notify_image) {
+			notify_image = false;
+			if (tbuf_consume(&vid_lep_tbuf)) {
+				lepP = &vid_lep_buffer[tbuf_consumer_index(&vid_lep_tbuf)];
+				t = esp_timer_get_time();
+				_vid_latency_rendered(lepP, t, _vid_update_src(lepP));
+			}
+		}
+		
+		vTaskDelay(pdMS_TO_TICKS(VID_EVAL_MSEC));
+	}
+#else
 	// Start the video subsystem with the appropriate video format.
 	ctrl_get_if_mode(&vid_format);
+#ifdef VID_SCANOUT_SCALING
+	video_set_scaling(gui_state.display_interp_enable ? VIDEO_SCALE_X_INTERP : VIDEO_SCALE_X_DOUBLE, true);
+#endif
+#ifdef VID_FULL_RASTER
+	vid_width = (vid_format == CTRL_VID_FORMAT_NTSC) ? 360 : 384;
+	vid_height = (vid_format == CTRL_VID_FORMAT_NTSC) ? 240 : 288;
+#else
+	vid_width = IMG_BUF_WIDTH;
+	vid_height = IMG_BUF_HEIGHT;
+#endif
+	if (!render_set_image_size(vid_width, vid_height, VID_SCALE_KERNEL, VID_ZOOM_PCT)) {
+		ESP_LOGE(TAG, "Could not allocate scaler tables - using default image size");
+		vid_width = IMG_BUF_WIDTH;
+		vid_height = IMG_BUF_HEIGHT;
+	}
 	if (vid_format == CTRL_VID_FORMAT_NTSC) {
-		video_init(IMG_BUF_WIDTH, IMG_BUF_HEIGHT, FB_FORMAT_GREY_8BPP, VIDEO_MODE_NTSC, false);
+		video_init(vid_width, vid_height, FB_FORMAT_GREY_8BPP, VIDEO_MODE_NTSC, false);
 	} else {
-		video_init(IMG_BUF_WIDTH, IMG_BUF_HEIGHT, FB_FORMAT_GREY_8BPP, VIDEO_MODE_PAL, false);
+		video_init(vid_width, vid_height, FB_FORMAT_GREY_8BPP, VIDEO_MODE_PAL, false);
 	}
 	
 	// Setup a default image
 	_vid_render_image_pm554(vid_format == CTRL_VID_FORMAT_PAL);
 	
-	// Get a pointer to the frame buffer
-	drv_fbP = video_get_frame_buffer_address();
-	
 	while (1) {
 		_vid_handle_notifications();
 		
 		_vid_eval_parm_update();
 		
-		// Display the previously rendered image to minimize tearing then render the 
-		// current lepton data for next time
-		if (notify_image_1) {
-			notify_image_1 = false;
-			video_wait_frame();
-			_vid_display_image(1);
-			_vid_render_image(0);
-		}
+		// Record the latency of the last frame if the display has picked it up
+		_vid_latency_check();
 		
-		if (notify_image_2) {
-			notify_image_2 = false;
-			video_wait_frame();
-			_vid_display_image(0);
-			_vid_render_image(1);
+		// Render the current lepton data into a frame buffer not being displayed and
+		// have the video driver switch to it after the visible part of the field
+		if (notify_image) {
+			notify_image = false;
+			if (tbuf_consume(&vid_lep_tbuf)) {
+				lepP = &vid_lep_buffer[tbuf_consumer_index(&vid_lep_tbuf)];
+				rendP = video_get_back_buffer();
+				t = esp_timer_get_time();
+				_vid_render_image(lepP, rendP);
+				video_present(rendP);
+				_vid_latency_rendered(lepP, t, rendP);
+			}
 		}
 		
 		vTaskDelay(pdMS_TO_TICKS(VID_EVAL_MSEC));
 	}
+#endif
 }
 
 
@@ -193,12 +276,8 @@ static void _vid_handle_notifications()
 	
 	notification_value = 0;
 	if (xTaskNotifyWait(0x00, 0xFFFFFFFF, &notification_value, 0)) {
-		if (Notification(notification_value, VID_NOTIFY_LEP_FRAME_MASK_1)) {
-			notify_image_1 = true;
-		}
-		
-		if (Notification(notification_value, VID_NOTIFY_LEP_FRAME_MASK_2)) {
-			notify_image_2 = true;
+		if (Notification(notification_value, VID_NOTIFY_LEP_FRAME_MASK)) {
+			notify_image = true;
 		}
 		
 		if (Notification(notification_value, VID_NOTIFY_PARM_CHANGE_MASK)) {
@@ -212,10 +291,15 @@ static void _vid_handle_notifications()
 }
 
 
-static void _vid_eval_parm_update()
+/**
+ * Handle parameter button presses and the parameter entry timeout.  Returns true if
+ * the displayed parameter changed.
+ */
+static bool _vid_eval_parm_update()
 {
 	int64_t cur_time;
 	static int64_t prev_time;
+	bool changed = true;
 	
 	if (notify_parm_val_change) {
 		notify_parm_val_change = false;
@@ -309,8 +393,14 @@ static void _vid_eval_parm_update()
 			cur_parm_value = ps_get_parm(PS_PARM_PALETTE_MARKER);
 			prev_parm_value = cur_parm_value;
 			parm_entry_timeout = 0;
+		} else {
+			changed = false;
 		}
+	} else {
+		changed = false;
 	}
+	
+	return changed;
 }
 
 
@@ -322,10 +412,23 @@ static void _vid_render_image_pm554(bool pal_resolution)
 
     const char* p= pal_resolution ? pm5544_320x240_data : pm5544_320x240_data;
     const size_t ratio = 8/g_video_signal.bits_per_pixel;
+    const unsigned int sx = g_video_signal.width_pixels/g_video_signal.fb_width_pixels;
+    const unsigned int sy = g_video_signal.height_pixels/g_video_signal.fb_height_pixels;
 
-    for(unsigned int y=0; y<g_video_signal.height_pixels; y++)
+    // test card is 320x240, centered in larger images
+    const unsigned int card_width = (g_video_signal.width_pixels < 320) ? g_video_signal.width_pixels : 320;
+    const unsigned int card_height = (g_video_signal.height_pixels < 240) ? g_video_signal.height_pixels : 240;
+    const unsigned int ox = (g_video_signal.bits_per_pixel == 8) ? (g_video_signal.width_pixels - card_width)/2 : 0;
+    const unsigned int oy = (g_video_signal.bits_per_pixel == 8) ? (g_video_signal.height_pixels - card_height)/2 : 0;
+
+    if( g_video_signal.bits_per_pixel == 8 && (ox != 0 || oy != 0) )
     {
-        for(unsigned int x=0;x<g_video_signal.width_pixels/ratio; x++)
+        memset(g_video_signal.frame_buffer, 0, g_video_signal.fb_width_pixels*g_video_signal.fb_height_pixels);
+    }
+
+    for(unsigned int y=0; y<card_height; y++)
+    {
+        for(unsigned int x=0;x<card_width/ratio; x++)
         {
             HEADER_PIXEL(p, pixel);
             grey1 = 0.30*pixel[0] + 0.59*pixel[1] + 0.11*pixel[2];
@@ -340,7 +443,11 @@ static void _vid_render_image_pm554(bool pal_resolution)
             }
             else if(g_video_signal.bits_per_pixel == 8)
             {
-                g_video_signal.frame_buffer[y*g_video_signal.width_pixels+x] = grey1;
+                // frame buffer may be smaller, scaled up again when sent
+                if( x%sx == 0 && y%sy == 0 )
+                {
+                    g_video_signal.frame_buffer[((y+oy)/sy)*g_video_signal.fb_width_pixels+(x+ox)/sx] = grey1;
+                }
             }
             else if(g_video_signal.bits_per_pixel == 1)
             {
@@ -371,42 +478,157 @@ static void _vid_render_image_pm554(bool pal_resolution)
 }
 
 
-static void _vid_render_image(int render_buf_index)
+static void _vid_render_image(lep_buffer_t* lepP, uint8_t* rendP)
 {
-	lep_buffer_t* lepP = (render_buf_index == 0) ? &vid_lep_buffer[0] : &vid_lep_buffer[1];
-	uint8_t* rendP = rend_fbP[render_buf_index];
-	
 	// Get some information from the image
 	gui_state.agc_enabled = (lepton_get_tel_status(lepP->lep_telemP) & LEP_STATUS_AGC_STATE) == LEP_STATUS_AGC_STATE;
 	gui_state.is_radiometric = lepton_is_radiometric();
 	gui_state.rad_high_res = lepP->lep_telemP[LEP_TEL_TLIN_RES] != 0;
 	
-	// Render the image into the frame buffer
+#ifdef VID_SCANOUT_SCALING
+	// Palette values at lepton resolution, the video driver scales them up
+	render_lep_data_src(lepP, rendP, &gui_state);
+#else
+	// Render the image into the frame buffer then composite the overlay on top of it
 	render_lep_data(lepP, rendP, &gui_state);
+	_vid_build_overlay(lepP);
+	render_overlay_draw(rendP);
+#endif
+}
+
+
+/**
+ * Build the overlay display list of markers, spotmeter and parameter string for a
+ * lepton frame
+ */
+static void _vid_build_overlay(lep_buffer_t* lepP)
+{
+	render_overlay_begin();
 	
 	if (gui_state.min_max_enable) {
-		render_min_max_markers(lepP, rendP);
+		render_min_max_markers(lepP);
 	}
 	
 	if (gui_state.spotmeter_enable && gui_state.is_radiometric) {
-		render_spotmeter(lepP, rendP, &gui_state);
+		render_spotmeter(lepP, &gui_state);
 	}
 	
 	if (cur_parm_index != PARM_INDEX_MARKER) {
-		render_parm_string(_vid_get_parm_string(), rendP);
+		render_parm_string(_vid_get_parm_string());
+	}
+	
+	render_overlay_end();
+}
+
+
+/**
+ * Note a frame has been given to the display.  Its latency is recorded by
+ * _vid_latency_check() once the display shows it.
+ *   start_usec is when rendering started
+ *   shownP is the frame buffer or line callback source the display will switch to
+ */
+static void _vid_latency_rendered(lep_buffer_t* lepP, int64_t start_usec, uint8_t* shownP)
+{
+	if (vid_lat_shownP != NULL) {
+		// The previous frame was replaced before the display switched to it
+		frame_latency_not_shown();
+	}
+	
+	vid_lat_stamps = lepP->lep_stamps;
+	vid_lat_stamps.render_start_usec = start_usec;
+	vid_lat_stamps.render_end_usec = esp_timer_get_time();
+	vid_lat_shownP = shownP;
+}
+
+
+/**
+ * Record the latency of the last frame given to the display if the display has
+ * switched to it.  Must be called before the next frame is given to the display.
+ */
+static void _vid_latency_check()
+{
+	uint8_t* shownP;
+	int64_t t;
+	
+	if (vid_lat_shownP == NULL) return;
+	
+#ifdef VID_LINES_ON_DEMAND
+	// The interrupt may switch in between, read until both are from the same switch
+	do {
+		shownP = vid_flip_srcP;
+		t = vid_flip_usec;
+	} while ((shownP != vid_flip_srcP) || (t != vid_flip_usec));
+#else
+	t = video_get_flip_time(&shownP);
+#endif
+	
+	// Buffers are reused so the switch must also be after the frame was started
+	if ((shownP == vid_lat_shownP) && (t >= vid_lat_stamps.render_start_usec)) {
+		vid_lat_stamps.scanout_usec = t;
+		frame_latency_record(&vid_lat_stamps);
+		vid_lat_shownP = NULL;
+	}
+}
+
+
+#ifdef VID_LINES_ON_DEMAND
+static bool _vid_init_lines_on_demand()
+{
+	for (int i=0; i<2; i++) {
+		vid_srcP[i] = heap_caps_calloc(LEP_WIDTH*LEP_HEIGHT, sizeof(uint8_t), MALLOC_CAP_INTERNAL);
+		if (vid_srcP[i] == NULL) {
+			return false;
+		}
 	}
+	vid_cur_srcP = vid_srcP[0];
+	vid_next_srcP = NULL;
+	vid_line_interp = gui_state.display_interp_enable;
+	
+	return true;
+}
+
+
+static uint8_t* _vid_update_src(lep_buffer_t* lepP)
+{
+	uint8_t* srcP;
+	
+	// Withdraw any source not yet picked up so the interrupt can't switch to it while
+	// we write, then use the one not being displayed
+	vid_next_srcP = NULL;
+	srcP = (vid_cur_srcP == vid_srcP[0]) ? vid_srcP[1] : vid_srcP[0];
+	
+	gui_state.agc_enabled = (lepton_get_tel_status(lepP->lep_telemP) & LEP_STATUS_AGC_STATE) == LEP_STATUS_AGC_STATE;
+	gui_state.is_radiometric = lepton_is_radiometric();
+	gui_state.rad_high_res = lepP->lep_telemP[LEP_TEL_TLIN_RES] != 0;
+	render_lep_data_src(lepP, srcP, &gui_state);
+	
+	vid_next_srcP = srcP;
+	
+	// The overlay is composited by the line callback
+	vid_overlay_lepP = lepP;
+	_vid_build_overlay(lepP);
+	
+	return srcP;
 }
 
 
-static void _vid_display_image(int render_buf_index)
+/**
+ * Called from the video interrupt for each visible line.  Switches source
+ * images only at the top of the field.
+ */
+static void IRAM_ATTR _vid_line_callback(uint16_t y, uint8_t* line)
 {
-	uint8_t* drvP = drv_fbP;
-	uint8_t* rendP = rend_fbP[render_buf_index];
-	uint8_t* rendEndP = rendP + IMG_BUF_WIDTH*IMG_BUF_HEIGHT;
+	if ((y == 0) && (vid_next_srcP != NULL)) {
+		vid_cur_srcP = vid_next_srcP;
+		vid_next_srcP = NULL;
+		vid_flip_usec = esp_timer_get_time();
+		vid_flip_srcP = vid_cur_srcP;
+	}
 	
-	// Quickly copy the previously rendered buffer to the video driver's buffer
-	while (rendP < rendEndP) *drvP++ = *rendP++;
+	render_src_line(vid_cur_srcP, y, line, vid_line_interp);
+	render_overlay_line(y, line);
 }
+#endif
 
 
 static int _vid_get_emissivity_index(int cur_e)
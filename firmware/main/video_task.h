@@ -35,12 +35,37 @@
 // Evaluation rate (mSec)
 #define VID_EVAL_MSEC  20
 
+// Uncomment to render display lines on demand from the video interrupt instead of
+// into frame buffers.  Lowers latency to one field and needs no frame buffer.  The
+// markers, spotmeter and parameter text are composited as each line is sent.
+//#define VID_LINES_ON_DEMAND
+
+// Uncomment to have the video driver scale a LEP_WIDTH x LEP_HEIGHT frame buffer up
+// while it is sent instead of rendering IMG_BUF_WIDTH x IMG_BUF_HEIGHT images.  Quarter
+// the frame buffer memory and render work but the markers, spotmeter and parameter text
+// are not displayed.
+//#define VID_SCANOUT_SCALING
+
+// Uncomment to render images that fill the visible raster (384x288 PAL, 360x240 NTSC)
+// instead of IMG_BUF_WIDTH x IMG_BUF_HEIGHT.  Uses the arbitrary ratio scaler which
+// costs more render time, and the larger frame buffers may leave room for only one.
+//#define VID_FULL_RASTER
+
+// Scaler kernel (RENDER_KERNEL_BILINEAR or RENDER_KERNEL_BICUBIC) and digital zoom
+// percent (100 = none).  Anything other than bilinear at 100% with the default image
+// size uses the arbitrary ratio scaler.
+#define VID_SCALE_KERNEL RENDER_KERNEL_BILINEAR
+#define VID_ZOOM_PCT     100
+
+#if defined(VID_FULL_RASTER) && (defined(VID_LINES_ON_DEMAND) || defined(VID_SCANOUT_SCALING))
+#error "VID_FULL_RASTER cannot be used with VID_LINES_ON_DEMAND or VID_SCANOUT_SCALING"
+#endif
+
 //
 // VID Task notifications
 //
 // From lep_task
-#define VID_NOTIFY_LEP_FRAME_MASK_1         0x00000001
-#define VID_NOTIFY_LEP_FRAME_MASK_2         0x00000002
+#define VID_NOTIFY_LEP_FRAME_MASK           0x00000001
 
 // From ctrl_task
 #define VID_NOTIFY_PARM_CHANGE_MASK         0x00000010
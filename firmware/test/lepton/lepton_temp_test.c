@@ -0,0 +1,285 @@
+/*
+ * Lepton temperature conversion test
+ *
+ * Checks the integer lepton_kelvin_to_temp() and lepton_temp_to_str() on the host
+ * against a floating point reference built from lepton_kelvin_to_C(), round() and
+ * sprintf() for every 16-bit TLinear reading at both resolutions, in C and F with 0 - 2
+ * decimals.  The strings for the int32_t extremes must fit LEP_TEMP_STR_LEN.
+ *
+ * Usage: lepton_temp_test [-q]
+ *   -q  only print errors
+ * Exits with 1 if a result differs from the reference.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "lepton_temp.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+//
+// Constants
+//
+
+// Most mismatches printed per case
+#define MAX_REPORTS       8
+
+// Filled in past the end of the string buffer to catch overruns
+#define CANARY            0x5A
+
+
+
+//
+// Typedefs
+//
+
+// Hand checked results, including the rounding of negative halves
+typedef struct {
+	uint32_t k;
+	bool high_res;
+	bool unit_C;
+	int decimals;
+	const char* s;
+} known_case_t;
+
+
+
+//
+// Variables
+//
+static bool quiet = false;
+
+static const known_case_t known[] = {
+	// k       high   C      dec  string
+	{27315,    true,  true,  0,   "0"},
+	{27365,    true,  true,  0,   "1"},         // 0.5 C rounds up
+	{27265,    true,  true,  0,   "-1"},        // -0.5 C rounds away from zero
+	{27266,    true,  true,  0,   "0"},         // -0.49 C is not "-0"
+	{27310,    true,  true,  0,   "0"},         // -0.05 C
+	{27310,    true,  true,  1,   "-0.1"},
+	{27310,    true,  true,  2,   "-0.05"},
+	{27314,    true,  true,  1,   "0.0"},       // -0.01 C
+	{27306,    true,  true,  1,   "-0.1"},      // -0.09 C
+	{2731,     false, true,  0,   "0"},         // -0.05 C at low resolution
+	{2731,     false, true,  1,   "-0.1"},
+	{2726,     false, true,  0,   "-1"},        // -0.55 C
+	{25537,    true,  false, 0,   "0"},         // -0.004 F
+	{25482,    true,  false, 0,   "-1"},        // -0.994 F
+	{25510,    true,  false, 1,   "-0.5"},      // -0.49 F
+	{25509,    true,  false, 2,   "-0.51"},     // -0.508 F
+	{0,        true,  true,  2,   "-273.15"},
+	{0,        true,  false, 2,   "-459.67"},
+	{31015,    true,  false, 1,   "98.6"},      // 37 C
+	{65535,    false, false, 2,   "11336.63"},
+};
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static bool check_conversion(bool high_res, bool unit_C, int decimals);
+static bool check_known(const known_case_t* c);
+static bool check_str(int32_t t, int decimals, const char* expected);
+static int32_t reference_temp(uint32_t k, bool high_res, bool unit_C, int decimals);
+
+
+
+//
+// Test
+//
+int main(int argc, char** argv)
+{
+	char s[LEP_TEMP_STR_LEN];
+	bool pass = true;
+	int hr, uc, d, i;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	
+	// Every reading at both resolutions, both units and all decimals
+	for (hr=0; hr<2; hr++) {
+		for (uc=0; uc<2; uc++) {
+			for (d=0; d<=2; d++) {
+				pass &= check_conversion(hr != 0, uc != 0, d);
+			}
+		}
+	}
+	
+	for (i=0; i<(int) (sizeof(known)/sizeof(known[0])); i++) {
+		pass &= check_known(&known[i]);
+	}
+	
+	// Longest strings
+	pass &= check_str(INT32_MIN, 2, "-21474836.48");
+	pass &= check_str(INT32_MAX, 2, "21474836.47");
+	pass &= check_str(INT32_MIN, 0, "-2147483648");
+	pass &= check_str(0, 2, "0.00");
+	if (lepton_temp_to_str(INT32_MIN, 2, s) != LEP_TEMP_STR_LEN - 1) {
+		printf("LEP_TEMP_STR_LEN is not the longest string plus terminator\n");
+		pass = false;
+	}
+	
+	// Out of range decimals are limited
+	if (lepton_kelvin_to_temp(27400, true, true, 3) != 85) {
+		printf("3 decimals are not limited to 2\n");
+		pass = false;
+	}
+	if (lepton_kelvin_to_temp(27400, true, true, -1) != 1) {
+		printf("-1 decimals are not limited to 0\n");
+		pass = false;
+	}
+	
+	if (!quiet || !pass) {
+		printf("Lepton temperature: %s\n", pass ? "pass" : "FAIL");
+	}
+	
+	return pass ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "q")) != -1) {
+		switch (c) {
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-q]\n", argv[0]);
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Compare the conversion and its string with the reference for every 16-bit reading
+ */
+static bool check_conversion(bool high_res, bool unit_C, int decimals)
+{
+	char s[LEP_TEMP_STR_LEN];
+	char ref_s[32];
+	int32_t t, ref;
+	uint32_t k;
+	int errors = 0;
+	
+	for (k=0; k<=0xFFFF; k++) {
+		t = lepton_kelvin_to_temp(k, high_res, unit_C, decimals);
+		ref = reference_temp(k, high_res, unit_C, decimals);
+		lepton_temp_to_str(t, decimals, s);
+		sprintf(ref_s, "%.*f", decimals, ref / pow(10, decimals));
+	
+		if ((t != ref) || (strcmp(s, ref_s) != 0)) {
+			if (++errors <= MAX_REPORTS) {
+				printf("%s res %s %d decimals: k %" PRIu32 " is %" PRId32 " \"%s\", expected %" PRId32 " \"%s\"\n",
+					high_res ? "high" : "low", unit_C ? "C" : "F", decimals,
+					k, t, s, ref, ref_s);
+			}
+		}
+	}
+	
+	if (!quiet || (errors != 0)) {
+		printf("%s res %s %d decimals: %d errors\n", high_res ? "high" : "low",
+			unit_C ? "C" : "F", decimals, errors);
+	}
+	
+	return errors == 0;
+}
+
+
+static bool check_known(const known_case_t* c)
+{
+	char s[LEP_TEMP_STR_LEN];
+	
+	lepton_temp_to_str(lepton_kelvin_to_temp(c->k, c->high_res, c->unit_C, c->decimals),
+		c->decimals, s);
+	if (strcmp(s, c->s) != 0) {
+		printf("%s res %s %d decimals: k %" PRIu32 " is \"%s\", expected \"%s\"\n",
+			c->high_res ? "high" : "low", c->unit_C ? "C" : "F", c->decimals,
+			c->k, s, c->s);
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Format t and check the string, its returned length and that nothing past
+ * LEP_TEMP_STR_LEN was written
+ */
+static bool check_str(int32_t t, int decimals, const char* expected)
+{
+	char s[LEP_TEMP_STR_LEN + 4];
+	int i, len;
+	
+	memset(s, CANARY, sizeof(s));
+	len = lepton_temp_to_str(t, decimals, s);
+	
+	for (i=LEP_TEMP_STR_LEN; i<(int) sizeof(s); i++) {
+		if (s[i] != CANARY) {
+			printf("%" PRId32 " with %d decimals writes past LEP_TEMP_STR_LEN\n", t, decimals);
+			return false;
+		}
+	}
+	if ((strcmp(s, expected) != 0) || (len != (int) strlen(expected))) {
+		printf("%" PRId32 " with %d decimals is \"%s\" (length %d), expected \"%s\"\n", t, decimals,
+			s, len, expected);
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Temperature * 10^decimals from lepton_kelvin_to_C(), rounded half away from zero.
+ *
+ * The float result is only good to about 0.001 C, too coarse to tell which way an exact
+ * half rounds.  Readings are whole 0.01 K so the result is first put back on that grid,
+ * and the scaled value on a 1e-6 grid so halves are exact in binary.
+ */
+static int32_t reference_temp(uint32_t k, bool high_res, bool unit_C, int decimals)
+{
+	double v;
+	
+	v = round(lepton_kelvin_to_C(k, high_res ? 0.01 : 0.1) * 100) / 100;
+	if (!unit_C) {
+		v = v * 9 / 5 + 32;
+	}
+	v = round(v * pow(10, decimals) * 1e6) / 1e6;
+	
+	return (int32_t) round(v);
+}
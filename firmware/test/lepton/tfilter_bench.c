@@ -0,0 +1,412 @@
+/*
+ * Lepton temporal filter benchmark
+ *
+ * Builds temporal_filter.c on the host and measures its noise reduction and cost on
+ * recorded lepton frames.  Each frame is used as a clean scene: TEST_FRAMES copies
+ * with synthetic noise at the filter's noise level are filtered and the reduction in
+ * the mean square error over the second half of them reported in dB, once with the
+ * scene held still and once moving one pixel right per frame (shows any ghosting).
+ * Files with more than one frame are also filtered as recorded and the reduction of the
+ * frame to frame difference reported, the sensor's own noise when the scene was still.
+ * Without files a synthetic scene is used.
+ *
+ * Frame files are raw little-endian 16-bit LEP_WIDTH x LEP_HEIGHT frames back to back
+ * (e.g. radiometric frames saved from a tCam or AGC frames for -a).
+ *
+ * Usage: tfilter_bench [-a] [-s STRENGTH] [-n NOISE] [-q] [FRAMEFILE ...]
+ *   -a  8-bit AGC data (default radiometric), selects the firmware's AGC settings
+ *   -s  weight (of 256) of a new pixel within the noise level (default SYS_TF_STRENGTH)
+ *   -n  noise level in lepton counts (default SYS_TF_NOISE_RAD or SYS_TF_NOISE_AGC)
+ *   -q  only print errors
+ * Exits with 1 if the filter does not reduce the noise of a still scene.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "system_config.h"
+#include "temporal_filter.h"
+#include "vospi.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+
+//
+// Constants
+//
+
+// Noisy copies of each scene filtered
+#define TEST_FRAMES       32
+
+// Synthetic scene range (radiometric 0.01 K units, about 20 - 40 C)
+#define SCENE_RAD_MIN     29300
+#define SCENE_RAD_MAX     31300
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	uint64_t in_err;             // Squared error (or frame difference) before filtering
+	uint64_t out_err;            // After filtering
+	uint64_t ns;                 // Host time in tfilter_frame()
+	uint64_t cycles;             // Host cycle counter in tfilter_frame(), 0 if unknown
+	uint32_t frames;             // Frames filtered
+} result_t;
+
+
+
+//
+// Variables
+//
+static bool agc = false;
+static int strength = SYS_TF_STRENGTH;
+static int noise = -1;
+static bool quiet = false;
+
+static uint16_t scene[LEP_NUM_PIXELS];
+static uint16_t work[LEP_NUM_PIXELS];
+static uint16_t prev_in[LEP_NUM_PIXELS];
+static uint16_t prev_out[LEP_NUM_PIXELS];
+
+static uint32_t seed = 1;
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static void synthetic_scene(uint16_t* buf);
+static bool read_frame(FILE* fp, uint16_t* buf);
+static void noise_test(const uint16_t* buf, bool moving, result_t* r);
+static void recorded_test(FILE* fp, result_t* r);
+static void timed_filter(uint16_t* buf, result_t* r);
+static void print_result(const char* name, const result_t* r);
+static double result_db(const result_t* r);
+static uint64_t host_ns();
+static uint64_t host_cycles();
+
+
+
+//
+// Benchmark
+//
+int main(int argc, char** argv)
+{
+	result_t still, moving, recorded;
+	FILE* fp;
+	int max_in;
+	int i, j, n;
+	bool pass = true;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	if (noise < 0) {
+		noise = agc ? SYS_TF_NOISE_AGC : SYS_TF_NOISE_RAD;
+	}
+	
+	// Same settings as lep_task
+	if (!tfilter_init(strength, noise, agc ? 8 : 0)) {
+		printf("tfilter_init failed\n");
+		exit(2);
+	}
+	max_in = agc ? 0xFF : 0xFFFF;
+	if (!quiet) {
+		printf("%s data, strength %d, noise %d\n", agc ? "AGC" : "Radiometric", strength, noise);
+	}
+	
+	if (optind == argc) {
+		synthetic_scene(scene);
+		noise_test(scene, false, &still);
+		noise_test(scene, true, &moving);
+		pass &= result_db(&still) > 0;
+		if (!quiet || !pass) {
+			print_result("Synthetic scene still", &still);
+			print_result("Synthetic scene moving", &moving);
+		}
+	}
+	
+	for (i=optind; i<argc; i++) {
+		fp = fopen(argv[i], "rb");
+		if (fp == NULL) {
+			printf("Could not open %s\n", argv[i]);
+			exit(2);
+		}
+		
+		// Noise added to each recorded frame
+		memset(&still, 0, sizeof(result_t));
+		memset(&moving, 0, sizeof(result_t));
+		for (n=0; read_frame(fp, scene); n++) {
+			for (j=0; j<LEP_NUM_PIXELS; j++) {
+				if (scene[j] > max_in) scene[j] = max_in;
+			}
+			noise_test(scene, false, &still);
+			noise_test(scene, true, &moving);
+		}
+		if (n == 0) {
+			printf("No %dx%d frames in %s\n", LEP_WIDTH, LEP_HEIGHT, argv[i]);
+			exit(2);
+		}
+		pass &= result_db(&still) > 0;
+		
+		// The recording itself
+		rewind(fp);
+		recorded_test(fp, &recorded);
+		fclose(fp);
+		
+		if (!quiet || !pass) {
+			printf("%s: %d frames\n", argv[i], n);
+			print_result("  Added noise still", &still);
+			print_result("  Added noise moving", &moving);
+			if (recorded.frames > 1) {
+				print_result("  Recorded frame to frame", &recorded);
+			}
+		}
+	}
+	
+	return pass ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "as:n:q")) != -1) {
+		switch (c) {
+			case 'a':
+				agc = true;
+				break;
+			case 's':
+				strength = atoi(optarg);
+				break;
+			case 'n':
+				noise = atoi(optarg);
+				break;
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-a] [-s STRENGTH] [-n NOISE] [-q] [FRAMEFILE ...]\n", argv[0]);
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * A horizontal gradient with a warm blob, scaled to 8 bits for AGC data
+ */
+static void synthetic_scene(uint16_t* buf)
+{
+	int32_t v, dx, dy;
+	int x, y;
+	
+	for (y=0; y<LEP_HEIGHT; y++) {
+		for (x=0; x<LEP_WIDTH; x++) {
+			dx = x - LEP_WIDTH / 3;
+			dy = y - LEP_HEIGHT / 2;
+			v = SCENE_RAD_MIN + x * 6;
+			if ((dx*dx + dy*dy) < 400) {
+				v += 1000 - (dx*dx + dy*dy) * 2;
+			}
+			if (agc) {
+				v = (v - SCENE_RAD_MIN) * 255 / (SCENE_RAD_MAX - SCENE_RAD_MIN);
+			}
+			buf[y*LEP_WIDTH + x] = (uint16_t) v;
+		}
+	}
+}
+
+
+static bool read_frame(FILE* fp, uint16_t* buf)
+{
+	uint8_t b[2];
+	int i;
+	
+	for (i=0; i<LEP_NUM_PIXELS; i++) {
+		if (fread(b, 1, 2, fp) != 2) {
+			return false;
+		}
+		buf[i] = b[0] | (b[1] << 8);
+	}
+	
+	return true;
+}
+
+
+/**
+ * Filter TEST_FRAMES copies of a clean scene with approximately gaussian noise
+ * (standard deviation of half the noise level) added, accumulating the squared error
+ * over the second half of the frames.  The scene is held still or moved one pixel
+ * right per frame.
+ */
+static void noise_test(const uint16_t* buf, bool moving, result_t* r)
+{
+	const int32_t max_in = agc ? 0xFF : 0xFFFF;
+	int32_t sigma = (noise + 1) / 2;
+	int32_t c, e, n;
+	int f, i, j, x, y;
+	
+	if (r->frames == 0) {
+		memset(r, 0, sizeof(result_t));
+	}
+	
+	tfilter_reset();
+	for (f=0; f<TEST_FRAMES; f++) {
+		// Noisy frame: sum of 12 uniform values has a standard deviation of one range
+		for (i=0; i<LEP_NUM_PIXELS; i++) {
+			x = moving ? ((i % LEP_WIDTH) + LEP_WIDTH - (f % LEP_WIDTH)) % LEP_WIDTH : i % LEP_WIDTH;
+			y = i / LEP_WIDTH;
+			c = buf[y*LEP_WIDTH + x];
+			n = 0;
+			for (j=0; j<12; j++) {
+				seed = seed * 1664525 + 1013904223;
+				n += seed >> 16;
+			}
+			n = (int32_t) (((int64_t) (n - 12*32768) * sigma) >> 16);
+			e = c + n;
+			if (e < 0) e = 0;
+			if (e > max_in) e = max_in;
+			work[i] = e;
+			if (f >= TEST_FRAMES/2) {
+				r->in_err += (uint64_t) ((e - c) * (e - c));
+			}
+		}
+		
+		timed_filter(work, r);
+		
+		if (f >= TEST_FRAMES/2) {
+			for (i=0; i<LEP_NUM_PIXELS; i++) {
+				x = moving ? ((i % LEP_WIDTH) + LEP_WIDTH - (f % LEP_WIDTH)) % LEP_WIDTH : i % LEP_WIDTH;
+				y = i / LEP_WIDTH;
+				e = (int32_t) work[i] - buf[y*LEP_WIDTH + x];
+				r->out_err += (uint64_t) (e * e);
+			}
+		}
+	}
+}
+
+
+/**
+ * Filter a recording as it is, accumulating the squared frame to frame differences of
+ * the input and output after the first TEST_FRAMES/2 frames have settled the filter
+ */
+static void recorded_test(FILE* fp, result_t* r)
+{
+	const int32_t max_in = agc ? 0xFF : 0xFFFF;
+	int32_t d;
+	int f, i;
+	
+	memset(r, 0, sizeof(result_t));
+	tfilter_reset();
+	for (f=0; read_frame(fp, work); f++) {
+		for (i=0; i<LEP_NUM_PIXELS; i++) {
+			if (work[i] > max_in) work[i] = max_in;
+			if (f > TEST_FRAMES/2) {
+				d = (int32_t) work[i] - prev_in[i];
+				r->in_err += (uint64_t) (d * d);
+			}
+			prev_in[i] = work[i];
+		}
+		
+		timed_filter(work, r);
+		
+		for (i=0; i<LEP_NUM_PIXELS; i++) {
+			if (f > TEST_FRAMES/2) {
+				d = (int32_t) work[i] - prev_out[i];
+				r->out_err += (uint64_t) (d * d);
+			}
+			prev_out[i] = work[i];
+		}
+	}
+	
+	// Only frames after the filter settled count
+	if (r->in_err == 0) {
+		r->frames = 0;
+	}
+}
+
+
+static void timed_filter(uint16_t* buf, result_t* r)
+{
+	uint64_t t, c;
+	
+	t = host_ns();
+	c = host_cycles();
+	tfilter_frame(buf);
+	r->cycles += host_cycles() - c;
+	r->ns += host_ns() - t;
+	r->frames++;
+}
+
+
+static void print_result(const char* name, const result_t* r)
+{
+	if (r->cycles != 0) {
+		printf("%s: %.1f dB, %.1f uS, %llu cycles (host) per frame\n", name, result_db(r),
+			r->ns / 1000.0 / r->frames, (unsigned long long) (r->cycles / r->frames));
+	} else {
+		printf("%s: %.1f dB, %.1f uS (host) per frame\n", name, result_db(r), r->ns / 1000.0 / r->frames);
+	}
+}
+
+
+static double result_db(const result_t* r)
+{
+	if (r->in_err == 0) {
+		return 0.0;
+	}
+	
+	return (r->out_err == 0) ? 99.9 : 10.0 * log10((double) r->in_err / (double) r->out_err);
+}
+
+
+static uint64_t host_ns()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static uint64_t host_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,266 @@
+/*
+ * Lepton VSYNC timing test
+ *
+ * Drives vsync_timing.c on the host with a simulated VSYNC source: edges with period
+ * jitter, lost edges and a task waking for them with varying and sometimes late
+ * delays.  The statistics from vsync_timing_get_stats() are checked against a reference
+ * computed in floating point from the same edges.
+ *
+ * Usage: vsync_timing_test [-q]
+ *   -q  only print errors
+ * Exits with 1 if a statistic differs from the reference.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "vospi.h"
+#include "vsync_timing.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+//
+// Constants
+//
+
+// Most edges a case sends
+#define MAX_EDGES         1000
+
+
+
+//
+// Typedefs
+//
+
+// Simulated VSYNC source and task
+typedef struct {
+	const char* name;
+	int64_t start_usec;          // Time of the first edge
+	int edges;                   // Edges sent (including lost ones)
+	int32_t jitter_usec;         // Each edge moves up to +/- this from its nominal time
+	int drop_every;              // Lose every nth edge after the first (0 for none)
+	int drop_run;                // Edges lost in a row each time
+	int32_t wake_max_usec;       // Task wakes up to this long after each edge
+	int late_every;              // Every nth wake is VSYNC_MAX_WAKE_USEC + 1 or more late
+} sim_case_t;
+
+
+
+//
+// Variables
+//
+static bool quiet = false;
+static uint32_t seed = 1;
+
+static int64_t sent_usec[MAX_EDGES];
+
+static const sim_case_t cases[] = {
+	// name                  start        edges jitter drop  run  wake  late
+	{"exact period",         1000,        20,   0,     0,    0,   0,    0},
+	{"jitter",               1000,        64,   150,   0,    0,   400,  0},
+	{"ring wrap",            1000,        500,  300,   0,    0,   900,  0},
+	{"missing edges",        1000,        200,  100,   7,    1,   200,  0},
+	{"missing runs",         1000,        300,  50,    11,   3,   200,  0},
+	{"late wakes",           1000,        100,  20,    0,    0,   800,  5},
+	{"everything",           1000,        MAX_EDGES, 400, 13, 2, 950,  3},
+	{"64-bit timestamps",    5000000000LL, 150, 200,   9,    1,   500,  4},
+};
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static bool run_case(const sim_case_t* c);
+static bool check(const char* case_name, const char* stat, int64_t got, int64_t expected, int64_t tol);
+static int32_t rand_range(int32_t max);
+
+
+
+//
+// Test
+//
+int main(int argc, char** argv)
+{
+	vsync_stats_t st;
+	bool pass = true;
+	int i;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	
+	for (i=0; i<(int) (sizeof(cases)/sizeof(cases[0])); i++) {
+		pass &= run_case(&cases[i]);
+	}
+	
+	// Reset starts over
+	vsync_timing_edge(1000);
+	vsync_timing_wake(1000, 1100);
+	vsync_timing_reset();
+	vsync_timing_get_stats(LEP_FRAME_USEC, &st);
+	pass &= check("reset", "edges", st.edges, 0, 0);
+	pass &= check("reset", "periods", st.num_periods, 0, 0);
+	pass &= check("reset", "wakes", st.wakes, 0, 0);
+	pass &= check("reset", "last edge", vsync_timing_last_edge(), 0, 0);
+	
+	if (!quiet || !pass) {
+		printf("VSYNC timing: %s\n", pass ? "pass" : "FAIL");
+	}
+	
+	return pass ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "q")) != -1) {
+		switch (c) {
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-q]\n", argv[0]);
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Send a case's edges and wakes, then compare the statistics with a reference computed
+ * from the edges that were not lost
+ */
+static bool run_case(const sim_case_t* c)
+{
+	vsync_stats_t st;
+	int64_t t, wake_sum = 0;
+	int32_t d, wake_max = 0;
+	double p, sum = 0, sum_sq = 0, mean, var;
+	int32_t p_min = 0, p_max = 0;
+	uint32_t wakes = 0, late = 0, missed = 0;
+	int num_periods = 0;
+	int n = 0;
+	int i, first;
+	bool ok, pass = true;
+	
+	vsync_timing_reset();
+	
+	for (i=0; i<c->edges; i++) {
+		if ((c->drop_every != 0) && (i != 0) && ((i % c->drop_every) < c->drop_run)) {
+			continue;
+		}
+		
+		t = c->start_usec + (int64_t) i * LEP_FRAME_USEC + rand_range(c->jitter_usec);
+		vsync_timing_edge(t);
+		sent_usec[n++] = t;
+		
+		// The task wakes for the edge
+		d = (c->wake_max_usec == 0) ? 0 : rand_range(c->wake_max_usec / 2) + c->wake_max_usec / 2;
+		if ((c->late_every != 0) && ((i % c->late_every) == 0)) {
+			d = VSYNC_MAX_WAKE_USEC + 1 + rand_range(500) + 500;
+		}
+		ok = vsync_timing_wake(vsync_timing_last_edge(), t + d);
+		pass &= check(c->name, "wake result", ok, d <= VSYNC_MAX_WAKE_USEC, 0);
+		wakes++;
+		wake_sum += d;
+		if (d > wake_max) wake_max = d;
+		if (d > VSYNC_MAX_WAKE_USEC) late++;
+	}
+	pass &= check(c->name, "last edge", vsync_timing_last_edge(), sent_usec[n-1], 0);
+	
+	// Reference: periods between the edges still in the ring
+	first = (n > VSYNC_TS_LEN) ? n - VSYNC_TS_LEN : 0;
+	for (i=first+1; i<n; i++) {
+		p = (double) (sent_usec[i] - sent_usec[i-1]);
+		if (p > 1.5 * LEP_FRAME_USEC) {
+			missed++;
+			continue;
+		}
+		if ((num_periods == 0) || (p < p_min)) p_min = (int32_t) p;
+		if ((num_periods == 0) || (p > p_max)) p_max = (int32_t) p;
+		sum += p;
+		sum_sq += p * p;
+		num_periods++;
+	}
+	mean = (num_periods == 0) ? 0 : sum / num_periods;
+	var = (num_periods == 0) ? 0 : sum_sq / num_periods - mean * mean;
+	
+	vsync_timing_get_stats(LEP_FRAME_USEC, &st);
+	pass &= check(c->name, "edges", st.edges, n, 0);
+	pass &= check(c->name, "periods", st.num_periods, num_periods, 0);
+	pass &= check(c->name, "missed", st.missed, missed, 0);
+	pass &= check(c->name, "period min", st.period_min_usec, p_min, 0);
+	pass &= check(c->name, "period max", st.period_max_usec, p_max, 0);
+	// Integer results are truncated
+	pass &= check(c->name, "period avg", st.period_avg_usec, (int64_t) round(mean), 1);
+	pass &= check(c->name, "jitter", st.jitter_usec, (int64_t) floor(sqrt((var > 0) ? var : 0)), 1);
+	pass &= check(c->name, "wakes", st.wakes, wakes, 0);
+	pass &= check(c->name, "wake avg", st.wake_avg_usec, wake_sum / wakes, 0);
+	pass &= check(c->name, "wake max", st.wake_max_usec, wake_max, 0);
+	pass &= check(c->name, "late", st.late, late, 0);
+	
+	// Wake statistics start over, the edges are kept
+	vsync_timing_get_stats(LEP_FRAME_USEC, &st);
+	pass &= check(c->name, "wakes after read", st.wakes, 0, 0);
+	pass &= check(c->name, "late after read", st.late, 0, 0);
+	pass &= check(c->name, "periods after read", st.num_periods, num_periods, 0);
+	
+	if (!quiet || !pass) {
+		printf("%s: %u edges, period %d (%d - %d) uS, jitter %d uS, %u missed, wake avg %d max %d uS, %u late: %s\n",
+			c->name, st.edges, st.period_avg_usec, st.period_min_usec, st.period_max_usec, st.jitter_usec,
+			st.missed, (int32_t) (wake_sum / wakes), wake_max, late, pass ? "pass" : "FAIL");
+	}
+	
+	return pass;
+}
+
+
+static bool check(const char* case_name, const char* stat, int64_t got, int64_t expected, int64_t tol)
+{
+	if ((got < expected - tol) || (got > expected + tol)) {
+		printf("%s: %s is %lld, expected %lld\n", case_name, stat, (long long) got, (long long) expected);
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+ * Uniform value in -max ... max
+ */
+static int32_t rand_range(int32_t max)
+{
+	seed = seed * 1664525 + 1013904223;
+	
+	return (max == 0) ? 0 : (int32_t) ((seed >> 8) % (uint32_t) (2 * max + 1)) - max;
+}
@@ -0,0 +1,211 @@
+/*
+ * Lepton render benchmark
+ *
+ * Builds render.c on the host and renders a synthetic lepton frame with each of the
+ * eight specialized white/black hot, double/interpolate, radiometric/AGC renderers and
+ * with the generic row stage path they replace.  Reports the host time per frame of
+ * both and checks that they make the same image.  Host times only show the relative
+ * cost, the ESP32 numbers come from RENDER_BENCHMARK on the target.
+ *
+ * Usage: render_bench [-n FRAMES] [-q]
+ *   -n  frames rendered by each renderer (default 200)
+ *   -q  only print errors
+ * Exits with 1 if a specialized renderer makes a different image.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// The renderers under test are static
+#include "render.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+//
+// Constants
+//
+
+// Radiometric frame range (0.01 K units, about 20 - 40 C)
+#define BENCH_RAD_MIN     29300
+#define BENCH_RAD_MAX     31300
+
+
+
+//
+// Variables
+//
+static int frames = 200;
+static bool quiet = false;
+
+static uint16_t rad_buf[LEP_NUM_PIXELS];
+static uint16_t agc_buf[LEP_NUM_PIXELS];
+static uint8_t gen_img[IMG_BUF_WIDTH * IMG_BUF_HEIGHT];
+static uint8_t var_img[IMG_BUF_WIDTH * IMG_BUF_HEIGHT];
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static void fill_frames(lep_buffer_t* rad, lep_buffer_t* agc);
+static uint64_t host_ns();
+
+
+
+//
+// Benchmark
+//
+int main(int argc, char** argv)
+{
+	static const char* pal_name[2] = {"white hot", "black hot"};
+	static const char* mode_name[2] = {"double", "interpolate"};
+	static const char* data_name[2] = {"radiometric", "AGC"};
+	lep_buffer_t lep[2];
+	render_norm_t norm;
+	render_row_func_t row_func;
+	uint64_t t, gen_ns, var_ns;
+	int errors = 0;
+	int p, i, a, f;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	
+	if (!render_init()) {
+		printf("render_init failed\n");
+		exit(2);
+	}
+	fill_frames(&lep[0], &lep[1]);
+	
+	for (p=0; p<2; p++) {
+		for (i=0; i<2; i++) {
+			for (a=0; a<2; a++) {
+				row_func = (a == 1) ? render_agc_row : render_norm_row;
+				render_palette_mod = (p == 1) ? 0xFF : 0x00;
+				render_norm_setup(&lep[a], &norm);
+				
+				t = host_ns();
+				for (f=0; f<frames; f++) {
+					if (i == 1) {
+						render_interp_data(&lep[a], gen_img, row_func, &norm);
+					} else {
+						render_double_data(&lep[a], gen_img, row_func, &norm);
+					}
+				}
+				gen_ns = (host_ns() - t) / frames;
+				
+				t = host_ns();
+				for (f=0; f<frames; f++) {
+					render_variants[p][i][a](&lep[a], var_img, &norm);
+				}
+				var_ns = (host_ns() - t) / frames;
+				
+				if (memcmp(gen_img, var_img, sizeof(var_img)) != 0) {
+					errors++;
+				}
+				if (!quiet || (memcmp(gen_img, var_img, sizeof(var_img)) != 0)) {
+					printf("%s %s %s: specialized %.1f uS, generic %.1f uS (%.2fx), %s\n",
+						pal_name[p], mode_name[i], data_name[a],
+						var_ns / 1000.0, gen_ns / 1000.0, (var_ns != 0) ? (double) gen_ns / var_ns : 0.0,
+						(memcmp(gen_img, var_img, sizeof(var_img)) == 0) ? "match" : "DIFFER");
+				}
+			}
+		}
+	}
+	
+	return (errors == 0) ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "n:q")) != -1) {
+		switch (c) {
+			case 'n':
+				frames = atoi(optarg);
+				break;
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-n FRAMES] [-q]\n", argv[0]);
+				return false;
+		}
+	}
+	
+	return frames > 0;
+}
+
+
+/**
+ * Scene-like frames: a horizontal gradient with a warm blob and some pixel noise, with
+ * a few pixels outside the range the statistics give to exercise the clamping
+ */
+static void fill_frames(lep_buffer_t* rad, lep_buffer_t* agc)
+{
+	uint32_t seed = 1;
+	int32_t v, dx, dy;
+	int x, y;
+	
+	for (y=0; y<LEP_HEIGHT; y++) {
+		for (x=0; x<LEP_WIDTH; x++) {
+			seed = seed * 1103515245 + 12345;
+			dx = x - LEP_WIDTH / 3;
+			dy = y - LEP_HEIGHT / 2;
+			v = BENCH_RAD_MIN + x * 6 + (int32_t) ((seed >> 16) % 40);
+			if ((dx*dx + dy*dy) < 400) {
+				v += 1000 - (dx*dx + dy*dy) * 2;
+			}
+			rad_buf[y*LEP_WIDTH + x] = (uint16_t) v;
+			agc_buf[y*LEP_WIDTH + x] = (uint16_t) ((v - BENCH_RAD_MIN) * 255 / (BENCH_RAD_MAX - BENCH_RAD_MIN + 100));
+		}
+	}
+	rad_buf[0] = BENCH_RAD_MIN - 500;
+	rad_buf[LEP_NUM_PIXELS - 1] = BENCH_RAD_MAX + 500;
+	
+	memset(rad, 0, sizeof(lep_buffer_t));
+	rad->lep_bufferP = rad_buf;
+	rad->lep_min_val = BENCH_RAD_MIN;
+	rad->lep_max_val = BENCH_RAD_MAX;
+	
+	memset(agc, 0, sizeof(lep_buffer_t));
+	agc->lep_bufferP = agc_buf;
+	agc->lep_min_val = 0;
+	agc->lep_max_val = 255;
+}
+
+
+static uint64_t host_ns()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,15 @@
+// Host shim: DAC output control, a no-op on the host
+#pragma once
+
+#include "esp_err.h"
+
+typedef enum {
+	DAC_CHANNEL_1 = 0,
+	DAC_CHANNEL_2,
+	DAC_CHANNEL_MAX,
+} dac_channel_t;
+
+esp_err_t dac_output_enable(dac_channel_t channel);
+esp_err_t dac_output_disable(dac_channel_t channel);
+esp_err_t dac_i2s_enable(void);
+esp_err_t dac_i2s_disable(void);
@@ -0,0 +1,30 @@
+// Host shim: GPIO, only what the composite video diagnostic pin uses
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+typedef enum {
+	GPIO_INTR_DISABLE = 0,
+	GPIO_INTR_POSEDGE,
+	GPIO_INTR_NEGEDGE,
+	GPIO_INTR_ANYEDGE,
+} gpio_int_type_t;
+
+#define GPIO_MODE_INPUT       1
+#define GPIO_MODE_OUTPUT      2
+#define GPIO_PULLUP_DISABLE   0
+#define GPIO_PULLDOWN_DISABLE 0
+
+typedef struct {
+	uint64_t pin_bit_mask;
+	int mode;
+	int pull_up_en;
+	int pull_down_en;
+	gpio_int_type_t intr_type;
+} gpio_config_t;
+
+esp_err_t gpio_config(const gpio_config_t* config);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
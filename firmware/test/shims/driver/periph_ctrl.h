@@ -0,0 +1,9 @@
+// Host shim: peripheral clock gating, a no-op on the host
+#pragma once
+
+typedef enum {
+	PERIPH_I2S0_MODULE = 8,
+} periph_module_t;
+
+void periph_module_enable(periph_module_t periph);
+void periph_module_disable(periph_module_t periph);
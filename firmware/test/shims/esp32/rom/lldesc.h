@@ -0,0 +1,20 @@
+// Host shim: DMA linked list descriptor, same layout as the ROM header.  Buffer and
+// next descriptor addresses are 32 bits so host test targets link without PIE and
+// allocate from the low host_shims.c heap pool.
+#pragma once
+
+#include <stdint.h>
+
+typedef struct lldesc_s {
+	volatile uint32_t size   : 12,
+	                  length : 12,
+	                  offset : 5,
+	                  sosf   : 1,
+	                  eof    : 1,
+	                  owner  : 1;
+	volatile const uint8_t* buf;
+	union {
+		volatile uint32_t empty;
+		struct lldesc_s* qe;
+	};
+} lldesc_t;
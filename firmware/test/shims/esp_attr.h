@@ -0,0 +1,6 @@
+// Host shim: code and data placement attributes have no meaning on the host
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
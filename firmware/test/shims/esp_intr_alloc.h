@@ -0,0 +1,18 @@
+// Host shim: interrupt allocation, host_intr_raise() calls the allocated handler
+#pragma once
+
+#include "esp_err.h"
+
+#define ESP_INTR_FLAG_LEVEL1 (1<<1)
+#define ESP_INTR_FLAG_LEVEL3 (1<<3)
+#define ESP_INTR_FLAG_IRAM   (1<<10)
+
+#define ETS_I2S0_INTR_SOURCE 32
+
+typedef void (*intr_handler_t)(void* arg);
+typedef struct host_intr* intr_handle_t;
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void* arg, intr_handle_t* ret_handle);
+esp_err_t esp_intr_enable(intr_handle_t handle);
+esp_err_t esp_intr_disable(intr_handle_t handle);
+esp_err_t esp_intr_free(intr_handle_t handle);
@@ -0,0 +1,16 @@
+// Host shim: log to stdout, levels above host_log_level are dropped
+#pragma once
+
+#include <stdio.h>
+
+extern int host_log_level;
+
+#define HOST_LOG(level, letter, tag, format, ...) do { \
+		if (host_log_level >= level) printf(letter " (%s) " format "\n", tag, ##__VA_ARGS__); \
+	} while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(4, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(5, "V", tag, format, ##__VA_ARGS__)
@@ -0,0 +1,6 @@
+// Host shim: esp_timer time follows the host_shims.c CPU cycle counter
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,16 @@
+// Host shim: FreeRTOS base types
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE            0
+#define pdTRUE             1
+#define pdPASS             pdTRUE
+#define portMAX_DELAY      ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS 10
+#define pdMS_TO_TICKS(ms)  ((TickType_t) (ms) / portTICK_PERIOD_MS)
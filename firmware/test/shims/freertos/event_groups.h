@@ -0,0 +1,15 @@
+// Host shim: event groups from host_shims.c.  Waiting never blocks, it returns the
+// bits set at the time of the call.
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+typedef struct host_event_group* EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bits, const BaseType_t clear_on_exit, const BaseType_t wait_for_all, TickType_t ticks_to_wait);
@@ -0,0 +1,6 @@
+// Host shim: semaphore handles only
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_semaphore* SemaphoreHandle_t;
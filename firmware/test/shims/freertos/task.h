@@ -0,0 +1,6 @@
+// Host shim: task handles only, tests use pthreads for tasks
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_task* TaskHandle_t;
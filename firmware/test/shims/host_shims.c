@@ -0,0 +1,444 @@
+/*
+ * Host shims
+ *
+ * Stand-ins for the ESP-IDF and FreeRTOS functions used by the firmware code built
+ * in the host test tree.
+ *
+ * The CPU cycle counter (esp_cpu_get_ccount(), esp_timer_get_time()) runs with host
+ * time scaled to CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ.  A simulation can hold it and
+ * move it forward to the simulated time of an event instead; raising an interrupt
+ * runs it for as long as the handler takes on the host.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "host_shims.h"
+#include "driver/dac.h"
+#include "driver/gpio.h"
+#include "driver/periph_ctrl.h"
+#include "esp_heap_caps.h"
+#include "esp_intr_alloc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
+#include "sdkconfig.h"
+#include "soc/cpu.h"
+#include "soc/i2s_struct.h"
+#include "soc/rtc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+
+//
+// Host Shims Constants
+//
+#define HOST_MAX_INTR     4
+#define HOST_HEAP_ALIGN   16
+
+
+
+//
+// Host Shims Typedefs
+//
+struct host_intr {
+	int source;
+	intr_handler_t handler;
+	void* arg;
+	bool enabled;
+};
+
+struct host_event_group {
+	EventBits_t bits;
+};
+
+typedef struct {
+	size_t size;
+	size_t pad;                  // Keeps the allocation HOST_HEAP_ALIGN aligned
+} host_heap_hdr_t;
+
+
+
+//
+// Host Shims Variables
+//
+int host_log_level = CONFIG_LOG_DEFAULT_LEVEL;
+
+i2s_dev_t I2S0;
+
+// CPU cycle counter
+static bool cpu_held = false;
+static bool cpu_started = false;
+static bool intr_host_time = true;
+static uint64_t cpu_base_cycles;
+static uint64_t cpu_run_start_ns;
+
+static struct host_intr intr_table[HOST_MAX_INTR];
+
+// Bump allocator that starts over when everything was freed
+static uint8_t heap_pool[HOST_HEAP_BYTES] __attribute__((aligned(HOST_HEAP_ALIGN)));
+static size_t heap_top;
+static int heap_live;
+
+
+
+//
+// Host Shims Forward Declarations for internal functions
+//
+static uint64_t host_ns();
+
+
+
+//
+// Host Shims API
+//
+
+/**
+ * Let the CPU cycle counter run with host time or hold it where it is
+ */
+void host_cpu_run(bool run)
+{
+	if (run && cpu_held) {
+		cpu_run_start_ns = host_ns();
+		cpu_held = false;
+	} else if (!run && !cpu_held) {
+		cpu_base_cycles = host_cpu_cycles();
+		cpu_held = true;
+	}
+}
+
+
+/**
+ * Move a held CPU cycle counter forward to cycles (it never goes back)
+ */
+void host_cpu_advance_to(uint64_t cycles)
+{
+	if (cpu_held && (cycles > cpu_base_cycles)) {
+		cpu_base_cycles = cycles;
+	}
+}
+
+
+/**
+ * Let cycles pass on the CPU cycle counter, held or running, like code taking that long
+ */
+void host_cpu_spend(uint32_t cycles)
+{
+	if (!cpu_started) {
+		(void) host_cpu_cycles();
+	}
+	cpu_base_cycles += cycles;
+}
+
+
+/**
+ * Return the 64-bit CPU cycle count
+ */
+uint64_t host_cpu_cycles()
+{
+	if (!cpu_started) {
+		cpu_run_start_ns = host_ns();
+		cpu_started = true;
+	}
+	
+	if (cpu_held) {
+		return cpu_base_cycles;
+	}
+	return cpu_base_cycles + (host_ns() - cpu_run_start_ns) * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ / 1000;
+}
+
+
+/**
+ * Select if the CPU cycle counter runs with host time while interrupt handlers run
+ * (default) or stays held so handlers only take the cycles spent with host_cpu_spend()
+ */
+void host_intr_use_host_time(bool enable)
+{
+	intr_host_time = enable;
+}
+
+
+/**
+ * Call the handler allocated for an interrupt source if it is enabled.  The CPU
+ * cycle counter runs while the handler does unless disabled with
+ * host_intr_use_host_time().
+ * Returns true if the handler was called
+ */
+bool host_intr_raise(int source)
+{
+	bool was_held = cpu_held;
+	int i;
+	
+	for (i=0; i<HOST_MAX_INTR; i++) {
+		if ((intr_table[i].handler != NULL) && (intr_table[i].source == source)) {
+			if (!intr_table[i].enabled) {
+				return false;
+			}
+			
+			host_cpu_run(intr_host_time || !was_held);
+			intr_table[i].handler(intr_table[i].arg);
+			host_cpu_run(!was_held);
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+
+//
+// ESP-IDF and FreeRTOS stand-ins
+//
+uint32_t esp_cpu_get_ccount(void)
+{
+	return (uint32_t) host_cpu_cycles();
+}
+
+
+int64_t esp_timer_get_time(void)
+{
+	return (int64_t) (host_cpu_cycles() / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+}
+
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void* arg, intr_handle_t* ret_handle)
+{
+	int i;
+	
+	for (i=0; i<HOST_MAX_INTR; i++) {
+		if (intr_table[i].handler == NULL) {
+			intr_table[i].source = source;
+			intr_table[i].handler = handler;
+			intr_table[i].arg = arg;
+			intr_table[i].enabled = true;
+			*ret_handle = &intr_table[i];
+			return ESP_OK;
+		}
+	}
+	
+	return ESP_ERR_NO_MEM;
+}
+
+
+esp_err_t esp_intr_enable(intr_handle_t handle)
+{
+	handle->enabled = true;
+	return ESP_OK;
+}
+
+
+esp_err_t esp_intr_disable(intr_handle_t handle)
+{
+	handle->enabled = false;
+	return ESP_OK;
+}
+
+
+esp_err_t esp_intr_free(intr_handle_t handle)
+{
+	memset(handle, 0, sizeof(struct host_intr));
+	return ESP_OK;
+}
+
+
+void* heap_caps_malloc(size_t size, uint32_t caps)
+{
+	host_heap_hdr_t* h;
+	size_t n;
+	
+	n = sizeof(host_heap_hdr_t) + ((size + HOST_HEAP_ALIGN - 1) & ~(size_t) (HOST_HEAP_ALIGN - 1));
+	if ((heap_top + n) > HOST_HEAP_BYTES) {
+		return NULL;
+	}
+	
+	h = (host_heap_hdr_t*) &heap_pool[heap_top];
+	h->size = n;
+	heap_top += n;
+	heap_live++;
+	
+	return h + 1;
+}
+
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+	void* p = heap_caps_malloc(n * size, caps);
+	
+	if (p != NULL) {
+		memset(p, 0, n * size);
+	}
+	return p;
+}
+
+
+void heap_caps_free(void* ptr)
+{
+	host_heap_hdr_t* h = (host_heap_hdr_t*) ptr - 1;
+	
+	if (ptr == NULL) return;
+	
+	if (((uint8_t*) h + h->size) == &heap_pool[heap_top]) {
+		// Last allocation
+		heap_top -= h->size;
+	}
+	if (--heap_live == 0) {
+		heap_top = 0;
+	}
+}
+
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+	return HOST_HEAP_BYTES - heap_top;
+}
+
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+	return HOST_HEAP_BYTES - heap_top;
+}
+
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+	return HOST_HEAP_BYTES - heap_top;
+}
+
+
+void heap_caps_print_heap_info(uint32_t caps)
+{
+	printf("Host heap: %zu of %d bytes used, %d allocations\n", heap_top, HOST_HEAP_BYTES, heap_live);
+}
+
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+	return calloc(1, sizeof(struct host_event_group));
+}
+
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+	free(group);
+}
+
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bits)
+{
+	group->bits |= bits;
+	return group->bits;
+}
+
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bits)
+{
+	EventBits_t prev = group->bits;
+	
+	group->bits &= ~bits;
+	return prev;
+}
+
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+	return group->bits;
+}
+
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bits, const BaseType_t clear_on_exit, const BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+	EventBits_t prev = group->bits;
+	
+	if (clear_on_exit) {
+		group->bits &= ~bits;
+	}
+	return prev;
+}
+
+
+void rtc_clk_apll_enable(bool enable, uint32_t sdm0, uint32_t sdm1, uint32_t sdm2, uint32_t o_div)
+{
+}
+
+
+int rtc_clk_xtal_freq_get(void)
+{
+	return 40;
+}
+
+
+esp_err_t dac_output_enable(dac_channel_t channel)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t dac_output_disable(dac_channel_t channel)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t dac_i2s_enable(void)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t dac_i2s_disable(void)
+{
+	return ESP_OK;
+}
+
+
+void periph_module_enable(periph_module_t periph)
+{
+}
+
+
+void periph_module_disable(periph_module_t periph)
+{
+}
+
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+	return ESP_OK;
+}
+
+
+
+//
+// Host Shims internal functions
+//
+static uint64_t host_ns()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
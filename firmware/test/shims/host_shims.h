@@ -0,0 +1,62 @@
+/*
+ * Host shims
+ *
+ * Controls for the ESP-IDF and FreeRTOS stand-ins in host_shims.c that host tests use
+ * to drive the firmware code: a CPU cycle counter that a simulation can hold and move
+ * forward, raising an allocated interrupt and the driver log level.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef HOST_SHIMS_H
+#define HOST_SHIMS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//
+// Host Shims Constants
+//
+
+// Heap pool for heap_caps_malloc() and friends, statically allocated so host test
+// targets linked without PIE get addresses that fit the 32 bit DMA descriptor fields
+#define HOST_HEAP_BYTES (16*1024*1024)
+
+
+
+//
+// Host Shims Variables
+//
+
+// ESP_LOGx levels printed (1 error ... 5 verbose), default 3 like CONFIG_LOG_DEFAULT_LEVEL
+extern int host_log_level;
+
+
+
+//
+// Host Shims API
+//
+void host_cpu_run(bool run);
+void host_cpu_advance_to(uint64_t cycles);
+void host_cpu_spend(uint32_t cycles);
+uint64_t host_cpu_cycles();
+void host_intr_use_host_time(bool enable);
+bool host_intr_raise(int source);
+
+#endif /* HOST_SHIMS_H */
@@ -0,0 +1,28 @@
+// Host shim: project configuration, same values as firmware/sdkconfig unless a test
+// target defines them on the compiler command line
+#pragma once
+
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ 240
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+
+#ifndef CONFIG_VIDEO_USE_FS_DC
+#define CONFIG_VIDEO_USE_FS_DC 1
+#endif
+#ifndef CONFIG_VIDEO_PAL_OFFSET_Y
+#define CONFIG_VIDEO_PAL_OFFSET_Y 11
+#endif
+#ifndef CONFIG_VIDEO_NTSC_OFFSET_Y
+#define CONFIG_VIDEO_NTSC_OFFSET_Y 7
+#endif
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+#define CONFIG_VIDEO_DMA_MODE_LINE 1
+#endif
+#ifndef CONFIG_VIDEO_DMA_RING_LINES
+#define CONFIG_VIDEO_DMA_RING_LINES 2
+#endif
+#ifndef CONFIG_VIDEO_FRAME_BUFFER_COUNT
+#define CONFIG_VIDEO_FRAME_BUFFER_COUNT 2
+#endif
+#ifndef CONFIG_VIDEO_DIAG_ISR_NEAR_UNDERRUN_US
+#define CONFIG_VIDEO_DIAG_ISR_NEAR_UNDERRUN_US 8
+#endif
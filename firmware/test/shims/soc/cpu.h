@@ -0,0 +1,6 @@
+// Host shim: CPU cycle counter from host_shims.c
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_cpu_get_ccount(void);
@@ -0,0 +1,2 @@
+// Host shim: nothing from this header is used by the code built on the host
+#pragma once
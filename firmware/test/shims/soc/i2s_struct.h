@@ -0,0 +1,123 @@
+// Host shim: the I2S0 register fields used by the composite video driver.  Writes
+// are only stored; the DMA stand-in of the test reads out_link and sets the
+// interrupt status and out_eof_des_addr.
+#pragma once
+
+#include <stdint.h>
+
+typedef volatile struct {
+	union {
+		struct {
+			uint32_t tx_reset:1;
+			uint32_t rx_reset:1;
+			uint32_t tx_fifo_reset:1;
+			uint32_t rx_fifo_reset:1;
+			uint32_t tx_start:1;
+			uint32_t rx_start:1;
+			uint32_t tx_slave_mod:1;
+			uint32_t rx_slave_mod:1;
+			uint32_t tx_right_first:1;
+			uint32_t rx_right_first:1;
+			uint32_t tx_msb_shift:1;
+			uint32_t rx_msb_shift:1;
+			uint32_t tx_short_sync:1;
+			uint32_t rx_short_sync:1;
+			uint32_t tx_mono:1;
+			uint32_t rx_mono:1;
+			uint32_t tx_msb_right:1;
+			uint32_t rx_msb_right:1;
+			uint32_t sig_loopback:1;
+			uint32_t reserved19:13;
+		};
+		uint32_t val;
+	} conf;
+	union {
+		struct {
+			uint32_t camera_en:1;
+			uint32_t lcd_tx_wrx2_en:1;
+			uint32_t lcd_tx_sdx2_en:1;
+			uint32_t data_enable_test_en:1;
+			uint32_t data_enable:1;
+			uint32_t lcd_en:1;
+			uint32_t ext_adc_start_en:1;
+			uint32_t inter_valid_en:1;
+			uint32_t reserved8:24;
+		};
+		uint32_t val;
+	} conf2;
+	union {
+		struct {
+			uint32_t rx_data_num:6;
+			uint32_t tx_data_num:6;
+			uint32_t dscr_en:1;
+			uint32_t tx_fifo_mod:3;
+			uint32_t rx_fifo_mod:3;
+			uint32_t tx_fifo_mod_force_en:1;
+			uint32_t rx_fifo_mod_force_en:1;
+			uint32_t reserved21:11;
+		};
+		uint32_t val;
+	} fifo_conf;
+	union {
+		struct {
+			uint32_t tx_bck_div_num:6;
+			uint32_t rx_bck_div_num:6;
+			uint32_t tx_bits_mod:6;
+			uint32_t rx_bits_mod:6;
+			uint32_t reserved24:8;
+		};
+		uint32_t val;
+	} sample_rate_conf;
+	union {
+		struct {
+			uint32_t tx_chan_mod:3;
+			uint32_t rx_chan_mod:2;
+			uint32_t reserved5:27;
+		};
+		uint32_t val;
+	} conf_chan;
+	union {
+		struct {
+			uint32_t clkm_div_num:8;
+			uint32_t clkm_div_b:6;
+			uint32_t clkm_div_a:6;
+			uint32_t clk_en:1;
+			uint32_t clka_en:1;
+			uint32_t reserved22:10;
+		};
+		uint32_t val;
+	} clkm_conf;
+	struct {
+		uint32_t addr;               // 20 bits on the chip, the whole address on the host
+		uint32_t stop:1;
+		uint32_t start:1;
+		uint32_t restart:1;
+		uint32_t park:1;
+	} out_link;
+	union {
+		struct {
+			uint32_t rx_take_data:1;
+			uint32_t tx_put_data:1;
+			uint32_t rx_wfull:1;
+			uint32_t rx_rempty:1;
+			uint32_t tx_wfull:1;
+			uint32_t tx_rempty:1;
+			uint32_t rx_hung:1;
+			uint32_t tx_hung:1;
+			uint32_t in_done:1;
+			uint32_t in_suc_eof:1;
+			uint32_t in_err_eof:1;
+			uint32_t out_done:1;
+			uint32_t out_eof:1;
+			uint32_t in_dscr_err:1;
+			uint32_t out_dscr_err:1;
+			uint32_t in_dscr_empty:1;
+			uint32_t out_total_eof:1;
+			uint32_t reserved17:15;
+		};
+		uint32_t val;
+	} int_raw, int_st, int_ena, int_clr;
+	uint32_t out_eof_des_addr;
+} i2s_dev_t;
+
+extern i2s_dev_t I2S0;
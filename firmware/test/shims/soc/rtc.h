@@ -0,0 +1,8 @@
+// Host shim: audio PLL setup, a no-op on the host
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void rtc_clk_apll_enable(bool enable, uint32_t sdm0, uint32_t sdm1, uint32_t sdm2, uint32_t o_div);
+int rtc_clk_xtal_freq_get(void);
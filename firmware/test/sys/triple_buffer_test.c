@@ -0,0 +1,316 @@
+/*
+ * Triple buffer test
+ *
+ * Runs the triple buffer index exchange between a producer and a consumer thread on
+ * the host.  The producer numbers its frames and fills them with the frame number; the
+ * consumer checks that every frame it takes is complete (no buffer written while it
+ * reads it) and newer than the last one.  At the end all frames must be accounted for:
+ * produced == consumed + dropped.  Runs with the producer faster, the consumer faster
+ * and both running flat out.  The threads give up the CPU every few frames so they also
+ * interleave on a single core host.
+ *
+ * Usage: triple_buffer_test [-n FRAMES] [-q]
+ *   -n  frames produced in each run (default 200000)
+ *   -q  only print errors
+ * Exits with 1 if a check fails.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "triple_buffer.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+
+//
+// Constants
+//
+
+// Words in each frame, all set to the frame number
+#define FRAME_WORDS       256
+
+
+
+//
+// Typedefs
+//
+typedef struct {
+	const char* name;
+	int producer_work;           // Busy loop iterations per frame
+	int producer_yield;          // Give up the CPU every this many frames (0 never)
+	int consumer_work;
+	int consumer_yield;
+} run_case_t;
+
+typedef struct {
+	uint32_t taken;              // Frames taken by the consumer
+	uint32_t last;               // Number of the last frame taken
+	uint32_t out_of_order;       // Frames not newer than the previous one
+	uint32_t torn;               // Frames changed while the consumer read them
+} consumer_result_t;
+
+
+
+//
+// Variables
+//
+static uint32_t frames = 200000;
+static bool quiet = false;
+
+static tbuf_t tb;
+static volatile uint32_t buffers[TBUF_NUM_BUFFERS][FRAME_WORDS];
+static atomic_bool producer_done;
+static const run_case_t* cur_case;
+
+static const run_case_t cases[] = {
+	// name              producer     consumer
+	{"producer faster", 0,    4, 2000, 1},
+	{"consumer faster", 2000, 1, 0,    0},
+	{"flat out",        0,    0, 0,    0},
+};
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static bool single_thread_test();
+static bool run(const run_case_t* c);
+static void* producer(void* arg);
+static void* consumer(void* arg);
+static void take_frame(consumer_result_t* r);
+static void work(int n);
+
+
+
+//
+// Test
+//
+int main(int argc, char** argv)
+{
+	bool pass;
+	int i;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	
+	pass = single_thread_test();
+	for (i=0; i<(int) (sizeof(cases)/sizeof(cases[0])); i++) {
+		pass &= run(&cases[i]);
+	}
+	
+	if (!quiet || !pass) {
+		printf("Triple buffer: %s\n", pass ? "pass" : "FAIL");
+	}
+	
+	return pass ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "n:q")) != -1) {
+		switch (c) {
+			case 'n':
+				frames = (uint32_t) atoi(optarg);
+				break;
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-n FRAMES] [-q]\n", argv[0]);
+				return false;
+		}
+	}
+	
+	return frames > 0;
+}
+
+
+/**
+ * Exchange sequence from one thread: the three buffers are always distinct, a frame
+ * replaced before it was taken is dropped and the consumer keeps its buffer when
+ * there is nothing new
+ */
+static bool single_thread_test()
+{
+	tbuf_counts_t c;
+	int first, second;
+	bool pass = true;
+	
+	tbuf_init(&tb);
+	pass &= !tbuf_consume(&tb);
+	pass &= tbuf_producer_index(&tb) != tbuf_consumer_index(&tb);
+	
+	first = tbuf_producer_index(&tb);
+	tbuf_publish(&tb);
+	pass &= tbuf_producer_index(&tb) != first;
+	second = tbuf_producer_index(&tb);
+	tbuf_publish(&tb);
+	pass &= tbuf_producer_index(&tb) != second;
+	
+	// Only the newest frame is taken, the first was dropped
+	pass &= tbuf_consume(&tb);
+	pass &= tbuf_consumer_index(&tb) == second;
+	pass &= tbuf_producer_index(&tb) != tbuf_consumer_index(&tb);
+	pass &= !tbuf_consume(&tb);
+	pass &= tbuf_consumer_index(&tb) == second;
+	
+	tbuf_get_counts(&tb, &c);
+	pass &= (c.produced == 2) && (c.consumed == 1) && (c.dropped == 1);
+	
+	if (!quiet || !pass) {
+		printf("Single thread: produced %u / consumed %u / dropped %u: %s\n", c.produced, c.consumed, c.dropped,
+			pass ? "pass" : "FAIL");
+	}
+	
+	return pass;
+}
+
+
+static bool run(const run_case_t* c)
+{
+	pthread_t prod, cons;
+	consumer_result_t r;
+	tbuf_counts_t counts;
+	bool pass;
+	
+	tbuf_init(&tb);
+	atomic_store(&producer_done, false);
+	cur_case = c;
+	
+	pthread_create(&cons, NULL, consumer, &r);
+	pthread_create(&prod, NULL, producer, NULL);
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+	
+	tbuf_get_counts(&tb, &counts);
+	pass = (counts.produced == frames) && (counts.produced == counts.consumed + counts.dropped);
+	pass &= (counts.consumed == r.taken) && (r.last == frames);
+	pass &= (r.out_of_order == 0) && (r.torn == 0);
+	
+	if (!quiet || !pass) {
+		printf("%s: produced %u / consumed %u / dropped %u, last frame %u, %u out of order, %u torn: %s\n",
+			c->name, counts.produced, counts.consumed, counts.dropped, r.last, r.out_of_order, r.torn,
+			pass ? "pass" : "FAIL");
+	}
+	
+	return pass;
+}
+
+
+/**
+ * Fill frames 1 ... frames and publish each
+ */
+static void* producer(void* arg)
+{
+	volatile uint32_t* b;
+	uint32_t n;
+	int i;
+	
+	for (n=1; n<=frames; n++) {
+		b = buffers[tbuf_producer_index(&tb)];
+		for (i=0; i<FRAME_WORDS; i++) {
+			b[i] = n;
+		}
+		work(cur_case->producer_work);
+		tbuf_publish(&tb);
+		if ((cur_case->producer_yield != 0) && ((n % cur_case->producer_yield) == 0)) {
+			sched_yield();
+		}
+	}
+	
+	atomic_store(&producer_done, true);
+	return NULL;
+}
+
+
+/**
+ * Take frames until the producer is done, then the one it may have left
+ */
+static void* consumer(void* arg)
+{
+	consumer_result_t* r = (consumer_result_t*) arg;
+	
+	r->taken = 0;
+	r->last = 0;
+	r->out_of_order = 0;
+	r->torn = 0;
+	
+	while (!atomic_load(&producer_done)) {
+		if (tbuf_consume(&tb)) {
+			take_frame(r);
+			if ((cur_case->consumer_yield != 0) && ((r->taken % cur_case->consumer_yield) == 0)) {
+				sched_yield();
+			}
+		} else {
+			sched_yield();
+		}
+	}
+	if (tbuf_consume(&tb)) {
+		take_frame(r);
+	}
+	
+	return NULL;
+}
+
+
+/**
+ * Check the frame at the consumer index before and after working on it
+ */
+static void take_frame(consumer_result_t* r)
+{
+	volatile uint32_t* b = buffers[tbuf_consumer_index(&tb)];
+	uint32_t n = b[0];
+	int i;
+	
+	r->taken++;
+	if (n <= r->last) {
+		r->out_of_order++;
+	}
+	r->last = n;
+	
+	work(cur_case->consumer_work);
+	for (i=0; i<FRAME_WORDS; i++) {
+		if (b[i] != n) {
+			r->torn++;
+			break;
+		}
+	}
+}
+
+
+static void work(int n)
+{
+	volatile int i;
+	
+	for (i=0; i<n; i++) {
+	}
+}
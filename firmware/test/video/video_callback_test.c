@@ -0,0 +1,232 @@
+/*
+ * Composite video line callback test
+ *
+ * Runs the composite video driver in FB_FORMAT_LINE_CALLBACK format on the host with
+ * the I2S DMA replaced by video_sim.  The callback draws a test pattern and takes a
+ * given time per line on the simulated CPU.  Checks that the decoded signal shows the
+ * pattern and that the driver's line callback statistics report the line budget,
+ * the callback cost and the overruns.
+ *
+ * Usage: video_callback_test [-n] [-c USEC] [-o] [-f FIELDS] [-q]
+ *   -n  NTSC (default PAL)
+ *   -c  time the callback takes per line (default 0)
+ *   -o  expect every line to overrun the budget
+ *   -f  fields to check (default 2)
+ *   -q  only print errors
+ * Exits with 1 if a check failed.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "host_shims.h"
+#include "video.h"
+#include "video_decode.h"
+#include "video_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+//
+// Constants
+//
+
+// Displayed image, the size vid_task uses in line-on-demand mode
+#define TEST_WIDTH        320
+#define TEST_HEIGHT       240
+
+// Fields sent before checking so the DMA buffers are filled by the callback
+#define WARMUP_FIELDS     2
+
+
+
+//
+// Variables
+//
+static bool ntsc = false;
+static double callback_us = 0;
+static bool expect_overruns = false;
+static int fields = 2;
+static bool quiet = false;
+
+static uint32_t callback_cycles;
+static uint32_t callback_lines;
+static bool callback_bad_y;
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static uint8_t pattern(int x, int y);
+static void test_callback(uint16_t y, uint8_t* line);
+
+
+
+//
+// Test
+//
+int main(int argc, char** argv)
+{
+	VIDEO_LINE_CALLBACK_STATS stats;
+	vdec_params_t params;
+	vdec_result_t result;
+	uint8_t* samples;
+	uint8_t* expected;
+	size_t max_samples, n;
+	double budget_us;
+	double line_us;
+	int lines;
+	int x, y;
+	bool pass;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	host_log_level = quiet ? 1 : 2;
+	
+	// The callback cost is exactly what it spends on the simulated CPU
+	host_intr_use_host_time(false);
+	callback_cycles = (uint32_t) (callback_us * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+	
+	video_set_line_callback(test_callback);
+	video_init(TEST_WIDTH, TEST_HEIGHT, FB_FORMAT_LINE_CALLBACK, ntsc ? VIDEO_MODE_NTSC : VIDEO_MODE_PAL, false);
+	
+	expected = malloc(TEST_WIDTH * TEST_HEIGHT);
+	for (y=0; y<TEST_HEIGHT; y++) {
+		for (x=0; x<TEST_WIDTH; x++) {
+			expected[y*TEST_WIDTH + x] = VSIM_DAC_LEVEL(pattern(x, y));
+		}
+	}
+	
+	// Capture from the middle of a field, one more field than checked
+	lines = g_video_signal.number_of_lines;
+	max_samples = (size_t) (fields + 1) * lines * g_video_signal.samples_per_line;
+	samples = malloc(max_samples);
+	
+	video_sim_start(g_video_signal.dac_frequency);
+	video_sim_send(WARMUP_FIELDS * lines + lines / 2, NULL, 0);
+	video_get_line_callback_stats(NULL, true);
+	callback_lines = 0;
+	n = video_sim_send((fields + 1) * lines, samples, max_samples);
+	video_get_line_callback_stats(&stats, false);
+	
+	params.sample_hz = g_video_signal.dac_frequency;
+	params.ntsc = ntsc;
+	params.sync_level = VSIM_LEVEL_SYNC;
+	params.black_level = VSIM_LEVEL_BLACK;
+	params.white_level = VSIM_LEVEL_WHITE;
+	params.first_active_line = g_video_signal.offset_y_lines;
+	params.active_lines = TEST_HEIGHT;
+	params.active_start = g_video_signal.offset_x_samples;
+	params.active_width = TEST_WIDTH;
+	params.expected = expected;
+	params.image_fields = 0;
+	vdec_decode(&params, samples, n, &result, NULL);
+	
+	// The budget is one line, not truncated to whole uSec
+	line_us = ntsc ? VDEC_NTSC_LINE_US : VDEC_PAL_LINE_US;
+	budget_us = (double) stats.budget_cycles / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+	pass = (vdec_errors(&result) == 0) && (result.fields >= fields);
+	pass &= (budget_us >= (line_us - VDEC_LINE_TOL_US)) && (budget_us <= (line_us + VDEC_LINE_TOL_US));
+	pass &= !callback_bad_y && (stats.lines == callback_lines) && (stats.lines >= (uint32_t) (fields * TEST_HEIGHT));
+	pass &= stats.max_cycles == callback_cycles;
+	pass &= stats.overruns == (expect_overruns ? stats.lines : 0);
+	
+	if (!quiet || !pass) {
+		printf("%s line callback %.2f uS: %s\n", ntsc ? "NTSC" : "PAL", callback_us, pass ? "pass" : "FAIL");
+		vdec_print(&result);
+		printf("  Budget %u cycles (%.3f uS), %u lines, max %u cycles, %u overruns%s\n",
+			stats.budget_cycles, budget_us, stats.lines, stats.max_cycles, stats.overruns,
+			callback_bad_y ? ", callback line out of range" : "");
+	}
+	
+	video_stop();
+	free(samples);
+	free(expected);
+	
+	return pass ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "nc:of:q")) != -1) {
+		switch (c) {
+			case 'n':
+				ntsc = true;
+				break;
+			case 'c':
+				callback_us = atof(optarg);
+				break;
+			case 'o':
+				expect_overruns = true;
+				break;
+			case 'f':
+				fields = atoi(optarg);
+				break;
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-n] [-c USEC] [-o] [-f FIELDS] [-q]\n", argv[0]);
+				return false;
+		}
+	}
+	
+	return fields > 0;
+}
+
+
+/**
+ * White border around ramps so the first and last active samples are lit
+ */
+static uint8_t pattern(int x, int y)
+{
+	if ((x == 0) || (y == 0) || (x == TEST_WIDTH-1) || (y == TEST_HEIGHT-1)) {
+		return 255;
+	}
+	return (x * 5 + y * 11) & 0xFF;
+}
+
+
+static void test_callback(uint16_t y, uint8_t* line)
+{
+	int x;
+	
+	if (y >= TEST_HEIGHT) {
+		callback_bad_y = true;
+		return;
+	}
+	
+	for (x=0; x<TEST_WIDTH; x++) {
+		line[x] = pattern(x, y);
+	}
+	callback_lines++;
+	
+	host_cpu_spend(callback_cycles);
+}
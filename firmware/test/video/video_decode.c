@@ -0,0 +1,384 @@
+/*
+ * Composite video waveform decoder
+ *
+ * Decodes captured DAC samples like a monitor would: locks to the field from the
+ * vertical sync pulses, then checks every line's period, the number, position and width
+ * of its sync pulses, the porches and blanking against the PAL and NTSC timing and that
+ * active video stays between black and white.  Optionally compares active video with
+ * the expected levels.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "video_decode.h"
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+//
+// Video Decode Constants
+//
+
+// Line types by their sync pulses
+#define VDEC_LINE_HSYNC          0
+#define VDEC_LINE_LONG_LONG      1
+#define VDEC_LINE_LONG_SHORT     2
+#define VDEC_LINE_SHORT_SHORT    3
+
+// Pulse classes
+#define VDEC_PULSE_BAD           0
+#define VDEC_PULSE_HSYNC         1
+#define VDEC_PULSE_SHORT         2
+#define VDEC_PULSE_LONG          3
+
+
+
+//
+// Video Decode Typedefs
+//
+typedef struct {
+	size_t start;
+	int width;
+	int class;
+} vdec_pulse_t;
+
+
+
+//
+// Video Decode Forward Declarations for internal functions
+//
+static int find_pulses(const vdec_params_t* p, const uint8_t* samples, size_t n, vdec_pulse_t** pulses);
+static int find_field_start(const vdec_params_t* p, const vdec_pulse_t* pulses, int num_pulses, int from);
+static int line_type(const vdec_params_t* p, int line);
+static void check_line(const vdec_params_t* p, const uint8_t* s, int len, int line, const vdec_pulse_t* pulses, int num_pulses, vdec_result_t* r, uint8_t* image);
+static inline double to_us(const vdec_params_t* p, double samples);
+static inline bool in_range_us(const vdec_params_t* p, int samples, double min_us, double max_us);
+
+
+
+//
+// Video Decode API
+//
+
+/**
+ * Decode captured samples
+ *   p describes the signal
+ *   samples has one DAC level per sample, n long
+ *   r receives the results
+ *   image receives the active video of the first p->image_fields fields decoded, one
+ *   after the other (may be NULL)
+ */
+void vdec_decode(const vdec_params_t* p, const uint8_t* samples, size_t n, vdec_result_t* r, uint8_t* image)
+{
+	vdec_pulse_t* pulses;
+	double nominal;
+	size_t min_next, max_next;
+	int num_pulses;
+	int num_lines;
+	int line;
+	int pi, j;
+	
+	memset(r, 0, sizeof(vdec_result_t));
+	r->line_min_us = DBL_MAX;
+	r->hsync_min_us = DBL_MAX;
+	r->front_porch_min_us = DBL_MAX;
+	r->back_porch_min_us = DBL_MAX;
+	
+	nominal = (p->ntsc ? VDEC_NTSC_LINE_US : VDEC_PAL_LINE_US) * p->sample_hz / 1000000.0;
+	num_lines = p->ntsc ? VDEC_NTSC_LINES : VDEC_PAL_LINES;
+	num_pulses = find_pulses(p, samples, n, &pulses);
+	
+	pi = find_field_start(p, pulses, num_pulses, 0);
+	line = 1;
+	while (pi >= 0) {
+		// The next line starts with the first sync leading edge around one line later
+		min_next = pulses[pi].start + (size_t) (nominal * 0.75);
+		max_next = pulses[pi].start + (size_t) (nominal * 1.25);
+		if (max_next >= n) {
+			// Last line not complete
+			break;
+		}
+		for (j=pi+1; j<num_pulses; j++) {
+			if (pulses[j].start >= min_next) break;
+		}
+		if ((j == num_pulses) || (pulses[j].start > max_next)) {
+			// Lost the line sync, wait for the next field
+			r->line_period++;
+			r->resyncs++;
+			pi = find_field_start(p, pulses, num_pulses, pi + 1);
+			line = 1;
+			continue;
+		}
+		
+		check_line(p, &samples[pulses[pi].start], pulses[j].start - pulses[pi].start, line, &pulses[pi], j - pi, r, image);
+		
+		pi = j;
+		if (++line > num_lines) {
+			line = 1;
+			r->fields++;
+		}
+	}
+	
+	free(pulses);
+}
+
+
+/**
+ * Return the total count of bad lines
+ */
+int vdec_errors(const vdec_result_t* r)
+{
+	return r->line_period + r->sync_pulses + r->sync_width + r->porches + r->blanking + r->active_level;
+}
+
+
+/**
+ * Print the results
+ */
+void vdec_print(const vdec_result_t* r)
+{
+	printf("Decoded %d fields, %d lines, %d resyncs\n", r->fields, r->lines, r->resyncs);
+	if (r->lines != 0) {
+		printf("  Line %.3f - %.3f uS, hsync %.3f - %.3f uS\n", r->line_min_us, r->line_max_us, r->hsync_min_us, r->hsync_max_us);
+	}
+	if (r->front_porch_min_us != DBL_MAX) {
+		printf("  Front porch min %.3f uS, back porch min %.3f uS\n", r->front_porch_min_us, r->back_porch_min_us);
+	}
+	printf("  Bad lines - period %d, sync pulses %d, sync width %d, porches %d, blanking %d, active level %d\n",
+		r->line_period, r->sync_pulses, r->sync_width, r->porches, r->blanking, r->active_level);
+}
+
+
+
+//
+// Video Decode internal functions
+//
+
+/**
+ * Find all sync pulses (samples closer to the sync level than to black) and classify
+ * them by width
+ * Returns the number of pulses found, *pulses must be freed
+ */
+static int find_pulses(const vdec_params_t* p, const uint8_t* samples, size_t n, vdec_pulse_t** pulses)
+{
+	const uint8_t threshold = (p->sync_level + p->black_level) / 2;
+	vdec_pulse_t* list = NULL;
+	int num = 0;
+	int max = 0;
+	size_t k, start;
+	
+	k = 0;
+	while (k < n) {
+		if (samples[k] > threshold) {
+			k++;
+			continue;
+		}
+		
+		start = k;
+		while ((k < n) && (samples[k] <= threshold)) k++;
+		
+		if (num == max) {
+			max = (max == 0) ? 1024 : max * 2;
+			list = realloc(list, max * sizeof(vdec_pulse_t));
+		}
+		list[num].start = start;
+		list[num].width = k - start;
+		if (in_range_us(p, k - start, VDEC_HSYNC_MIN_US, VDEC_HSYNC_MAX_US)) {
+			list[num].class = VDEC_PULSE_HSYNC;
+		} else if (in_range_us(p, k - start, VDEC_VSYNC_SHORT_MIN_US, VDEC_VSYNC_SHORT_MAX_US)) {
+			list[num].class = VDEC_PULSE_SHORT;
+		} else if (in_range_us(p, k - start, VDEC_VSYNC_LONG_MIN_US, VDEC_VSYNC_LONG_MAX_US)) {
+			list[num].class = VDEC_PULSE_LONG;
+		} else {
+			list[num].class = VDEC_PULSE_BAD;
+		}
+		num++;
+	}
+	
+	*pulses = list;
+	return num;
+}
+
+
+/**
+ * Find the pulse starting line 1 of a field: the first broad (long) pulse after a
+ * short one starts line 1 in PAL and line 4 in NTSC
+ * Returns the pulse index or -1 if there is none
+ */
+static int find_field_start(const vdec_params_t* p, const vdec_pulse_t* pulses, int num_pulses, int from)
+{
+	const int back = p->ntsc ? 6 : 0;    // NTSC lines 1-3 have two short pulses each
+	int i;
+	
+	for (i=from+1; i<num_pulses; i++) {
+		if ((pulses[i].class == VDEC_PULSE_LONG) && (pulses[i-1].class == VDEC_PULSE_SHORT) && ((i - back) >= from)) {
+			return i - back;
+		}
+	}
+	
+	return -1;
+}
+
+
+/**
+ * Return the standard type of a field line (1-based)
+ */
+static int line_type(const vdec_params_t* p, int line)
+{
+	if (p->ntsc) {
+		if ((line <= 3) || ((line >= 7) && (line <= 9))) return VDEC_LINE_SHORT_SHORT;
+		if (line <= 6) return VDEC_LINE_LONG_LONG;
+	} else {
+		if (line <= 2) return VDEC_LINE_LONG_LONG;
+		if (line == 3) return VDEC_LINE_LONG_SHORT;
+		if ((line <= 5) || (line > (VDEC_PAL_LINES - 3))) return VDEC_LINE_SHORT_SHORT;
+	}
+	
+	return VDEC_LINE_HSYNC;
+}
+
+
+/**
+ * Check one line
+ *   s points to the line's first sample (the leading edge of its first sync pulse)
+ *   len is the line period in samples
+ *   pulses are the line's sync pulses
+ */
+static void check_line(const vdec_params_t* p, const uint8_t* s, int len, int line, const vdec_pulse_t* pulses, int num_pulses, vdec_result_t* r, uint8_t* image)
+{
+	const double nominal_us = p->ntsc ? VDEC_NTSC_LINE_US : VDEC_PAL_LINE_US;
+	const uint8_t threshold = (p->sync_level + p->black_level) / 2;
+	const int type = line_type(p, line);
+	const bool active = (line >= p->first_active_line) && (line < (p->first_active_line + p->active_lines));
+	const uint8_t* expected = NULL;
+	int first_lit = -1;
+	int last_lit = -1;
+	int hsync_end;
+	int i, k;
+	bool bad;
+	
+	r->lines++;
+	
+	// Period
+	if (to_us(p, len) < r->line_min_us) r->line_min_us = to_us(p, len);
+	if (to_us(p, len) > r->line_max_us) r->line_max_us = to_us(p, len);
+	if ((to_us(p, len) < (nominal_us - VDEC_LINE_TOL_US)) || (to_us(p, len) > (nominal_us + VDEC_LINE_TOL_US))) {
+		r->line_period++;
+	}
+	
+	// Sync pulses
+	if (type == VDEC_LINE_HSYNC) {
+		if (num_pulses != 1) {
+			r->sync_pulses++;
+			return;
+		}
+		if (to_us(p, pulses[0].width) < r->hsync_min_us) r->hsync_min_us = to_us(p, pulses[0].width);
+		if (to_us(p, pulses[0].width) > r->hsync_max_us) r->hsync_max_us = to_us(p, pulses[0].width);
+		if (pulses[0].class != VDEC_PULSE_HSYNC) {
+			r->sync_width++;
+		}
+	} else {
+		// Two equalizing or broad pulses half a line apart
+		if ((num_pulses != 2) || (to_us(p, abs((int) (pulses[1].start - pulses[0].start) - len / 2)) > VDEC_HALF_LINE_TOL_US)) {
+			r->sync_pulses++;
+			return;
+		}
+		bad = false;
+		for (i=0; i<2; i++) {
+			if ((type == VDEC_LINE_LONG_LONG) || ((type == VDEC_LINE_LONG_SHORT) && (i == 0))) {
+				bad |= pulses[i].class != VDEC_PULSE_LONG;
+			} else {
+				bad |= pulses[i].class != VDEC_PULSE_SHORT;
+			}
+		}
+		if (bad) {
+			r->sync_width++;
+		}
+	}
+	
+	// Everything but sync and active video is black
+	if (active && (type == VDEC_LINE_HSYNC)) {
+		expected = (p->expected != NULL) ? &p->expected[(line - p->first_active_line) * p->active_width] : NULL;
+	}
+	bad = false;
+	for (k=0; k<len; k++) {
+		if (s[k] <= threshold) continue;
+		
+		if (active && (type == VDEC_LINE_HSYNC) && (k >= p->active_start) && (k < (p->active_start + p->active_width))) {
+			if (s[k] != p->black_level) {
+				if (first_lit < 0) first_lit = k;
+				last_lit = k;
+			}
+			continue;
+		}
+		if (s[k] != p->black_level) {
+			bad = true;
+		}
+	}
+	if (bad) {
+		r->blanking++;
+	}
+	
+	if (!active || (type != VDEC_LINE_HSYNC)) {
+		return;
+	}
+	
+	// Porches, measured to the first and last non-black active samples
+	if (first_lit >= 0) {
+		hsync_end = pulses[0].width;
+		if (to_us(p, first_lit - hsync_end) < r->back_porch_min_us) r->back_porch_min_us = to_us(p, first_lit - hsync_end);
+		if (to_us(p, len - last_lit - 1) < r->front_porch_min_us) r->front_porch_min_us = to_us(p, len - last_lit - 1);
+		if ((to_us(p, first_lit - hsync_end) < VDEC_BACK_PORCH_MIN_US) || (to_us(p, len - last_lit - 1) < VDEC_FRONT_PORCH_MIN_US)) {
+			r->porches++;
+		}
+	}
+	
+	// Active video
+	bad = false;
+	for (k=0; k<p->active_width; k++) {
+		if ((p->active_start + k) >= len) {
+			bad = true;
+			break;
+		}
+		i = s[p->active_start + k];
+		if ((i < p->black_level) || (i > p->white_level) || ((expected != NULL) && (i != expected[k]))) {
+			bad = true;
+		}
+		if ((image != NULL) && (r->fields < p->image_fields)) {
+			image[((size_t) r->fields * p->active_lines + line - p->first_active_line) * p->active_width + k] = i;
+		}
+	}
+	if (bad) {
+		r->active_level++;
+	}
+}
+
+
+static inline double to_us(const vdec_params_t* p, double samples)
+{
+	return samples * 1000000.0 / p->sample_hz;
+}
+
+
+static inline bool in_range_us(const vdec_params_t* p, int samples, double min_us, double max_us)
+{
+	return (to_us(p, samples) >= min_us) && (to_us(p, samples) <= max_us);
+}
@@ -0,0 +1,110 @@
+/*
+ * Composite video waveform decoder
+ *
+ * Decodes captured DAC samples like a monitor would: locks to the field from the
+ * vertical sync pulses, then checks every line's period, the number, position and width
+ * of its sync pulses, the porches and blanking against the PAL and NTSC timing and that
+ * active video stays between black and white.  Optionally compares active video with
+ * the expected levels.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef VIDEO_DECODE_H
+#define VIDEO_DECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+//
+// Video Decode Constants
+//
+
+// Signal limits in uSec, standard values with margin for the DAC sample rounding
+#define VDEC_LINE_TOL_US        0.2
+#define VDEC_HSYNC_MIN_US       4.5
+#define VDEC_HSYNC_MAX_US       4.9
+#define VDEC_VSYNC_SHORT_MIN_US 2.2
+#define VDEC_VSYNC_SHORT_MAX_US 2.5
+#define VDEC_VSYNC_LONG_MIN_US  26.5
+#define VDEC_VSYNC_LONG_MAX_US  28.0
+#define VDEC_HALF_LINE_TOL_US   0.2
+#define VDEC_FRONT_PORCH_MIN_US 1.4
+#define VDEC_BACK_PORCH_MIN_US  4.4
+
+// Nominal line periods
+#define VDEC_PAL_LINE_US        64.0
+#define VDEC_NTSC_LINE_US       63.556
+
+// Lines per field (non-interlaced)
+#define VDEC_PAL_LINES          312
+#define VDEC_NTSC_LINES         262
+
+
+
+//
+// Video Decode Typedefs
+//
+typedef struct {
+	uint32_t sample_hz;
+	bool ntsc;
+	uint8_t sync_level;
+	uint8_t black_level;
+	uint8_t white_level;
+	int first_active_line;       // Field line (1-based) of the first active video line
+	int active_lines;
+	int active_start;            // Samples from the hsync leading edge to active video
+	int active_width;            // Samples
+	const uint8_t* expected;     // active_width x active_lines levels (may be NULL)
+	int image_fields;            // Fields of active video stored in the image
+} vdec_params_t;
+
+typedef struct {
+	// Counts of bad lines
+	int line_period;             // Period out of tolerance or the next sync missing
+	int sync_pulses;             // Wrong number or position of sync pulses for the line
+	int sync_width;              // A sync pulse out of limits
+	int porches;                 // Porch shorter than the minimum
+	int blanking;                // Not black outside of sync and active video
+	int active_level;            // Active video outside black...white or unexpected
+	
+	int fields;                  // Complete fields decoded
+	int lines;                   // Lines decoded
+	int resyncs;                 // Times the field lock was lost
+	
+	// Measured timing (uSec)
+	double line_min_us;
+	double line_max_us;
+	double hsync_min_us;
+	double hsync_max_us;
+	double front_porch_min_us;   // Last non-black active sample to the next hsync
+	double back_porch_min_us;    // Hsync trailing edge to the first non-black active sample
+} vdec_result_t;
+
+
+
+//
+// Video Decode API
+//
+void vdec_decode(const vdec_params_t* p, const uint8_t* samples, size_t n, vdec_result_t* r, uint8_t* image);
+int vdec_errors(const vdec_result_t* r);
+void vdec_print(const vdec_result_t* r);
+
+#endif /* VIDEO_DECODE_H */
@@ -0,0 +1,303 @@
+/*
+ * Composite video temporal dither test
+ *
+ * Runs the composite video driver built with CONFIG_VIDEO_DITHER on the host with the
+ * I2S DMA replaced by video_sim, decodes two consecutive fields of a frame buffer of
+ * 2x2 pixel blocks stepping through every grey level and checks them against a
+ * reference model of the ordered dither: every active sample must be the level the
+ * threshold for its field, line and column parity gives, consecutive fields must use
+ * opposite threshold sets and the mean of the eight samples of a block over the two
+ * fields must be within 1/16 DAC step of the exact grey level.
+ *
+ * Usage: video_dither_test [-n] [-x none|double] [-r] [-q]
+ *   -n  NTSC (default PAL)
+ *   -x  horizontal scaling (default none)
+ *   -r  repeat frame buffer lines
+ *   -q  only print errors
+ * Exits with 1 if the decoder found bad lines or a sample differs from the model.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "host_shims.h"
+#include "video.h"
+#include "video_decode.h"
+#include "video_sim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+//
+// Constants
+//
+
+// Displayed image, the size vid_task uses
+#define TEST_WIDTH        320
+#define TEST_HEIGHT       240
+
+// Fields sent before checking so the DMA buffers are filled from the frame buffer
+#define WARMUP_FIELDS     2
+
+// Consecutive fields checked (one full dither cycle)
+#define TEST_FIELDS       2
+
+// Reference thresholds in 1/8 DAC steps by [field parity][line parity][column parity],
+// a 2x2 Bayer pattern per field with the other field filling in the odd thresholds
+static const int ref_thresholds[2][2][2] = { {{0,4},{6,2}}, {{5,1},{3,7}} };
+
+
+
+//
+// Variables
+//
+static bool ntsc = false;
+static VIDEO_SCALE_X scale_x = VIDEO_SCALE_X_NONE;
+static bool repeat_lines = false;
+static bool quiet = false;
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static int display_grey(int x, int y);
+static void fill_pattern(uint8_t* fb, int w, int h);
+static int ref_level(int grey, int field_parity, int line, int x);
+static int check_field(const uint8_t* img, int field_parity, int first_line);
+static int check_block_means(const uint8_t* img, double* max_err);
+
+
+
+//
+// Test
+//
+int main(int argc, char** argv)
+{
+	vdec_params_t params;
+	vdec_result_t result;
+	uint8_t* samples;
+	uint8_t* image;
+	size_t max_samples, n;
+	double max_err = 0;
+	int first_parity;
+	int field_errors[TEST_FIELDS];
+	int mean_errors;
+	int lines;
+	int i;
+	bool pass;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	host_log_level = quiet ? 1 : 2;
+	// Simulated time only so host scheduling can't make the driver see late interrupts
+	host_intr_use_host_time(false);
+	
+	video_set_scaling(scale_x, repeat_lines);
+	video_init(TEST_WIDTH, TEST_HEIGHT, FB_FORMAT_GREY_8BPP, ntsc ? VIDEO_MODE_NTSC : VIDEO_MODE_PAL, false);
+	
+	fill_pattern(video_get_frame_buffer_address(), g_video_signal.fb_width_pixels, g_video_signal.fb_height_pixels);
+	fill_pattern(video_get_back_buffer(), g_video_signal.fb_width_pixels, g_video_signal.fb_height_pixels);
+	
+	// Capture from the middle of a field so the decoder sees the sync before the first
+	// field checked
+	lines = g_video_signal.number_of_lines;
+	max_samples = (size_t) (TEST_FIELDS + 1) * lines * g_video_signal.samples_per_line;
+	samples = malloc(max_samples);
+	image = calloc((size_t) TEST_FIELDS * TEST_WIDTH * TEST_HEIGHT, 1);
+	
+	video_sim_start(g_video_signal.dac_frequency);
+	video_sim_send(WARMUP_FIELDS * lines + lines / 2, NULL, 0);
+	n = video_sim_send((TEST_FIELDS + 1) * lines, samples, max_samples);
+	
+	params.sample_hz = g_video_signal.dac_frequency;
+	params.ntsc = ntsc;
+	params.sync_level = VSIM_LEVEL_SYNC;
+	params.black_level = VSIM_LEVEL_BLACK;
+	params.white_level = VSIM_LEVEL_WHITE;
+	params.first_active_line = g_video_signal.offset_y_lines;
+	params.active_lines = TEST_HEIGHT;
+	params.active_start = g_video_signal.offset_x_samples;
+	params.active_width = TEST_WIDTH;
+	params.expected = NULL;
+	params.image_fields = TEST_FIELDS;
+	vdec_decode(&params, samples, n, &result, image);
+	
+	// Which threshold set the driver started with depends on how many fields it has
+	// sent, take the one matching the first field checked
+	first_parity = (check_field(image, 0, params.first_active_line) <= check_field(image, 1, params.first_active_line)) ? 0 : 1;
+	for (i=0; i<TEST_FIELDS; i++) {
+		field_errors[i] = check_field(&image[(size_t) i * TEST_WIDTH * TEST_HEIGHT], (first_parity + i) & 1, params.first_active_line);
+	}
+	mean_errors = check_block_means(image, &max_err);
+	
+	pass = (vdec_errors(&result) == 0) && (result.fields >= TEST_FIELDS) && (mean_errors == 0);
+	for (i=0; i<TEST_FIELDS; i++) {
+		pass &= field_errors[i] == 0;
+	}
+	if (!quiet || !pass) {
+		printf("%s %dx%d scale %s%s dither: %s\n", ntsc ? "NTSC" : "PAL", TEST_WIDTH, TEST_HEIGHT,
+			(scale_x == VIDEO_SCALE_X_NONE) ? "none" : "double", repeat_lines ? " repeat lines" : "",
+			pass ? "pass" : "FAIL");
+		vdec_print(&result);
+		printf("  Samples differing from the model: %d (field parity %d), %d (field parity %d)\n",
+			field_errors[0], first_parity, field_errors[1], (first_parity + 1) & 1);
+		printf("  Two field block means off by more than 1/16 step: %d, max error %.4f step\n", mean_errors, max_err);
+	}
+	
+	video_stop();
+	free(samples);
+	free(image);
+	
+	return pass ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "nx:rq")) != -1) {
+		switch (c) {
+			case 'n':
+				ntsc = true;
+				break;
+			case 'x':
+				// Interpolation mixes neighbouring pixels so is not dithered
+				if (strcmp(optarg, "none") == 0) {
+					scale_x = VIDEO_SCALE_X_NONE;
+				} else if (strcmp(optarg, "double") == 0) {
+					scale_x = VIDEO_SCALE_X_DOUBLE;
+				} else {
+					printf("Unknown scaling %s\n", optarg);
+					return false;
+				}
+				break;
+			case 'r':
+				repeat_lines = true;
+				break;
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-n] [-x none|double] [-r] [-q]\n", argv[0]);
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+ * Grey level shown at a display position: 2x2 blocks stepping through all levels
+ */
+static int display_grey(int x, int y)
+{
+	return (x/2 + (y/2) * (TEST_WIDTH/2)) & 0xFF;
+}
+
+
+static void fill_pattern(uint8_t* fb, int w, int h)
+{
+	int sx = (scale_x == VIDEO_SCALE_X_NONE) ? 1 : 2;
+	int sy = repeat_lines ? 2 : 1;
+	int x, y;
+	
+	for (y=0; y<h; y++) {
+		for (x=0; x<w; x++) {
+			fb[y*w + x] = display_grey(x * sx, y * sy);
+		}
+	}
+}
+
+
+/**
+ * Reference dithered level: floor(exact level + (threshold + 0.5)/8)
+ *   line is the field line (1-based), x the display column
+ */
+static int ref_level(int grey, int field_parity, int line, int x)
+{
+	int t = ref_thresholds[field_parity][line & 1][x & 1];
+	double exact = grey * (double) (VSIM_LEVEL_WHITE - VSIM_LEVEL_BLACK) / 255.0;
+	
+	return VSIM_LEVEL_BLACK + (int) floor(exact + (t + 0.5) / 8.0);
+}
+
+
+/**
+ * Returns the number of samples of a decoded field differing from the model
+ */
+static int check_field(const uint8_t* img, int field_parity, int first_line)
+{
+	int errors = 0;
+	int x, y;
+	
+	for (y=0; y<TEST_HEIGHT; y++) {
+		for (x=0; x<TEST_WIDTH; x++) {
+			if (img[y*TEST_WIDTH + x] != ref_level(display_grey(x, y), field_parity, first_line + y, x)) {
+				errors++;
+			}
+		}
+	}
+	
+	return errors;
+}
+
+
+/**
+ * Returns the number of 2x2 blocks whose mean over both fields is more than 1/16 DAC
+ * step from the exact level
+ */
+static int check_block_means(const uint8_t* img, double* max_err)
+{
+	const uint8_t* f;
+	double exact, err;
+	int errors = 0;
+	int sum;
+	int i, x, y;
+	
+	for (y=0; y<TEST_HEIGHT; y+=2) {
+		for (x=0; x<TEST_WIDTH; x+=2) {
+			sum = 0;
+			for (i=0; i<TEST_FIELDS; i++) {
+				f = &img[(size_t) i * TEST_WIDTH * TEST_HEIGHT];
+				sum += f[y*TEST_WIDTH + x] + f[y*TEST_WIDTH + x+1] + f[(y+1)*TEST_WIDTH + x] + f[(y+1)*TEST_WIDTH + x+1];
+			}
+			exact = VSIM_LEVEL_BLACK + display_grey(x, y) * (double) (VSIM_LEVEL_WHITE - VSIM_LEVEL_BLACK) / 255.0;
+			err = fabs(sum / (4.0 * TEST_FIELDS) - exact);
+			if (err > *max_err) {
+				*max_err = err;
+			}
+			if (err > (1.0 / 16.0)) {
+				errors++;
+			}
+		}
+	}
+	
+	return errors;
+}
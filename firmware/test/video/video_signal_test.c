@@ -0,0 +1,429 @@
+/*
+ * Composite video signal test
+ *
+ * Runs the composite video driver on the host with the I2S DMA replaced by video_sim
+ * and decodes the generated waveform with video_decode: sync and porch timing of every
+ * line of PAL or NTSC fields and the active video levels against a test pattern shown
+ * from an 8-bit or DAC native frame buffer with the selected scaling.  With -p the
+ * other frame buffer is presented in the first field checked and the old one drawn over
+ * as soon as video_get_back_buffer() returns it, which must not show.  Also reports the
+ * interrupt rate and handler cost of the DMA mode it is built with.  Built with
+ * CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM it also checks that the histogram expected
+ * every interrupt when the simulated DMA raised it.
+ *
+ * Usage: video_signal_test [-n] [-D] [-x none|double|interp] [-r] [-p] [-f FIELDS]
+ *                          [-l LINES] [-d USEC] [-w WAVFILE] [-i PGMFILE] [-q]
+ *   -n  NTSC (default PAL)
+ *   -D  FB_FORMAT_DAC_NATIVE frame buffers (default FB_FORMAT_GREY_8BPP)
+ *   -x  horizontal scaling (default none, not with -D)
+ *   -r  repeat frame buffer lines (not with -D)
+ *   -p  flip the frame buffers in the first field checked
+ *   -f  fields to check (default 3)
+ *   -l  hold the interrupt back for LINES lines in the first field checked
+ *   -d  let one interrupt in the first field checked enter USEC late
+ *   -w  write the captured samples as an 8-bit WAV file at the DAC rate
+ *   -i  write the decoded active video of the first field checked as a PGM image
+ *   -q  only print errors
+ * Exits with 1 if the decoder found bad lines.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "host_shims.h"
+#include "video.h"
+#include "video_decode.h"
+#include "video_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+//
+// Constants
+//
+
+// Displayed image, the size vid_task uses
+#define TEST_WIDTH        320
+#define TEST_HEIGHT       240
+
+// Fields sent before checking so the DMA buffers are filled from the frame buffer
+#define WARMUP_FIELDS     2
+
+
+
+//
+// Variables
+//
+static bool ntsc = false;
+static bool native = false;
+static VIDEO_SCALE_X scale_x = VIDEO_SCALE_X_NONE;
+static bool repeat_lines = false;
+static bool flip = false;
+static int fields = 3;
+static int hold_lines = 0;
+static double delay_us = 0;
+static char* wav_file = NULL;
+static char* pgm_file = NULL;
+static bool quiet = false;
+
+
+
+//
+// Forward Declarations
+//
+static bool parse_args(int argc, char** argv);
+static void fill_pattern(uint8_t* fb, int w, int h);
+static void expected_image(const uint8_t* fb, int fb_w, uint8_t* img);
+static bool write_pgm(const char* path, const uint8_t* img, int w, int h);
+
+
+
+//
+// Test
+//
+int main(int argc, char** argv)
+{
+	vdec_params_t params;
+	vdec_result_t result;
+	video_sim_stats_t stats;
+	VIDEO_ISR_STATS isr_stats;
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+	VIDEO_RING_STATS ring_stats;
+	double line_us;
+#endif
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+	VIDEO_ISR_HISTOGRAM histogram;
+	uint32_t jitter_samples = 0;
+	uint32_t late_samples = 0;
+	int t, b;
+#endif
+	uint8_t* samples;
+	uint8_t* front;
+	uint8_t* pattern = NULL;
+	uint8_t* expected;
+	uint8_t* image;
+	size_t max_samples, n;
+	double sec;
+	int lines;
+	int spl;
+	int y;
+	bool pass_flip = true;
+	bool pass;
+	
+	if (!parse_args(argc, argv)) {
+		exit(2);
+	}
+	host_log_level = quiet ? 1 : 2;
+	// Simulated time only so host scheduling can't make the driver see late interrupts
+	host_intr_use_host_time(false);
+	
+	expected = malloc(TEST_WIDTH * TEST_HEIGHT);
+	if (native) {
+		video_init(TEST_WIDTH, TEST_HEIGHT, FB_FORMAT_DAC_NATIVE, ntsc ? VIDEO_MODE_NTSC : VIDEO_MODE_PAL, false);
+		
+		// The driver converts the lines into the scanned frame buffer, the other one is a
+		// copy including the sync and porches
+		pattern = malloc(TEST_WIDTH * TEST_HEIGHT);
+		fill_pattern(pattern, TEST_WIDTH, TEST_HEIGHT);
+		for (y=0; y<TEST_HEIGHT; y++) {
+			video_native_put_line(y, &pattern[y * TEST_WIDTH]);
+		}
+		memcpy(video_get_back_buffer(), video_get_frame_buffer_address(), g_video_signal.frame_buffer_size_bytes);
+		expected_image(pattern, TEST_WIDTH, expected);
+	} else {
+		video_set_scaling(scale_x, repeat_lines);
+		video_init(TEST_WIDTH, TEST_HEIGHT, FB_FORMAT_GREY_8BPP, ntsc ? VIDEO_MODE_NTSC : VIDEO_MODE_PAL, false);
+		
+		// Same image in all frame buffers
+		fill_pattern(video_get_frame_buffer_address(), g_video_signal.fb_width_pixels, g_video_signal.fb_height_pixels);
+		fill_pattern(video_get_back_buffer(), g_video_signal.fb_width_pixels, g_video_signal.fb_height_pixels);
+		expected_image(video_get_frame_buffer_address(), g_video_signal.fb_width_pixels, expected);
+	}
+	
+	// Capture from the middle of a field so the decoder sees the sync before the first
+	// field checked, one more field than checked
+	lines = g_video_signal.number_of_lines;
+	spl = g_video_signal.samples_per_line;
+	max_samples = (size_t) (fields + 1) * lines * spl;
+	samples = malloc(max_samples);
+	image = calloc(TEST_WIDTH * TEST_HEIGHT, 1);
+	
+	video_sim_start(g_video_signal.dac_frequency);
+	video_sim_send(WARMUP_FIELDS * lines + lines / 2, NULL, 0);
+	video_sim_get_stats(NULL, true);
+	video_get_isr_stats(NULL, true);
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+	video_get_ring_stats(NULL, true);
+#endif
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+	video_get_isr_histogram(NULL, true);
+#endif
+	if (flip) {
+		// In the visible lines of the first field checked, a line at a time until the
+		// frame buffers flipped at its end
+		n = video_sim_send(lines, samples, max_samples);
+		front = video_get_frame_buffer_address();
+		video_present(video_get_back_buffer());
+		for (y=0; (y < lines) && (video_get_frame_buffer_address() == front); y++) {
+			n += video_sim_send(1, &samples[n], max_samples - n);
+		}
+		pass_flip = video_get_frame_buffer_address() != front;
+		
+		// The old image must not be read any more
+		memset(video_get_back_buffer(), 0, g_video_signal.frame_buffer_size_bytes);
+		n += video_sim_send(fields * lines - y, &samples[n], max_samples - n);
+	} else if ((hold_lines > 0) || (delay_us > 0)) {
+		// In the visible lines of the first field checked
+		n = video_sim_send(lines, samples, max_samples);
+		video_sim_hold_interrupt(hold_lines);
+		video_sim_delay_interrupt((uint32_t) (delay_us * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ));
+		n += video_sim_send(fields * lines, &samples[n], max_samples - n);
+	} else {
+		n = video_sim_send((fields + 1) * lines, samples, max_samples);
+	}
+	video_sim_get_stats(&stats, false);
+	video_get_isr_stats(&isr_stats, false);
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+	video_get_ring_stats(&ring_stats, false);
+#endif
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+	video_get_isr_histogram(&histogram, false);
+	for (t=0; t<VIDEO_ISR_LINE_TYPES; t++) {
+		for (b=0; b<VIDEO_ISR_HISTOGRAM_BUCKETS; b++) {
+			jitter_samples += histogram.jitter[t][b];
+			if (b != 0) {
+				late_samples += histogram.jitter[t][b];
+			}
+		}
+	}
+#endif
+	
+	params.sample_hz = g_video_signal.dac_frequency;
+	params.ntsc = ntsc;
+	params.sync_level = VSIM_LEVEL_SYNC;
+	params.black_level = VSIM_LEVEL_BLACK;
+	params.white_level = VSIM_LEVEL_WHITE;
+	params.first_active_line = g_video_signal.offset_y_lines;
+	params.active_lines = TEST_HEIGHT;
+	params.active_start = g_video_signal.offset_x_samples;
+	params.active_width = TEST_WIDTH;
+	params.expected = expected;
+	params.image_fields = 1;
+	vdec_decode(&params, samples, n, &result, image);
+	
+	pass = (vdec_errors(&result) == 0) && (result.fields >= fields) && pass_flip;
+	
+	// The driver's own counter, logged by mon_task on the target, must see every interrupt
+	pass &= isr_stats.interrupts == stats.interrupts;
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+	// The driver must see an interrupt held back for the whole ring but nothing when
+	// the interrupt entered while lines were still queued
+	line_us = (double) spl * 1000000.0 / g_video_signal.dac_frequency;
+	if (hold_lines >= ring_stats.ring_lines) {
+		pass &= ring_stats.underruns != 0;
+	} else if ((hold_lines == 0) && (delay_us < ((ring_stats.ring_lines - ring_stats.batch_lines) * line_us))) {
+		pass &= ring_stats.underruns == 0;
+	}
+#endif
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+	// The simulated DMA raises every interrupt on time, any jitter means the driver
+	// expected it after the wrong number of lines
+	if ((hold_lines == 0) && (delay_us == 0)) {
+		pass &= (jitter_samples != 0) && (late_samples == 0);
+	}
+#endif
+	if (!quiet || !pass) {
+		printf("%s %dx%d %s scale %s%s%s, %s DMA: %s\n", ntsc ? "NTSC" : "PAL", TEST_WIDTH, TEST_HEIGHT,
+			native ? "native" : "8bpp",
+			(scale_x == VIDEO_SCALE_X_NONE) ? "none" : ((scale_x == VIDEO_SCALE_X_DOUBLE) ? "double" : "interp"),
+			repeat_lines ? " repeat lines" : "", flip ? " flip" : "",
+#if CONFIG_VIDEO_DMA_MODE_FIELD
+			"field",
+#else
+			"line ring",
+#endif
+			pass ? "pass" : "FAIL");
+		if (!pass_flip) {
+			printf("  The frame buffers did not flip\n");
+		}
+		vdec_print(&result);
+#if !CONFIG_VIDEO_DMA_MODE_FIELD
+		printf("  Ring %u lines: min lead %u lines, %u underruns\n", ring_stats.ring_lines, ring_stats.min_lead_lines, ring_stats.underruns);
+#endif
+#if CONFIG_VIDEO_DIAG_ENABLE_ISR_HISTOGRAM
+		printf("  ISR histogram: %u of %u entries off by %u ns or more\n", late_samples, jitter_samples, VIDEO_ISR_HISTOGRAM_BUCKET_NS);
+#endif
+	}
+	if (!quiet) {
+		sec = (double) stats.samples / g_video_signal.dac_frequency;
+		printf("  %u interrupts/sec, %.1f interrupts/line, handler avg %llu max %u cycles (host), %.2f%% load (host)\n",
+			(uint32_t) (stats.interrupts / sec), (double) stats.interrupts / stats.descriptors,
+			(stats.interrupts != 0) ? (unsigned long long) (stats.isr_cycles / stats.interrupts) : 0ULL,
+			stats.isr_max_cycles, 100.0 * stats.isr_cycles / (sec * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ * 1000000.0));
+		printf("  Driver counted %u interrupts\n", isr_stats.interrupts);
+	}
+	
+	if ((wav_file != NULL) && !video_sim_write_wav(wav_file, samples, n, g_video_signal.dac_frequency)) {
+		printf("Could not write %s\n", wav_file);
+		pass = false;
+	}
+	if ((pgm_file != NULL) && !write_pgm(pgm_file, image, TEST_WIDTH, TEST_HEIGHT)) {
+		printf("Could not write %s\n", pgm_file);
+		pass = false;
+	}
+	
+	video_stop();
+	free(samples);
+	free(pattern);
+	free(expected);
+	free(image);
+	
+	return pass ? 0 : 1;
+}
+
+
+
+//
+// Internal functions
+//
+static bool parse_args(int argc, char** argv)
+{
+	int c;
+	
+	while ((c = getopt(argc, argv, "nDx:rpf:l:d:w:i:q")) != -1) {
+		switch (c) {
+			case 'n':
+				ntsc = true;
+				break;
+			case 'D':
+				native = true;
+				break;
+			case 'x':
+				if (strcmp(optarg, "none") == 0) {
+					scale_x = VIDEO_SCALE_X_NONE;
+				} else if (strcmp(optarg, "double") == 0) {
+					scale_x = VIDEO_SCALE_X_DOUBLE;
+				} else if (strcmp(optarg, "interp") == 0) {
+					scale_x = VIDEO_SCALE_X_INTERP;
+				} else {
+					printf("Unknown scaling %s\n", optarg);
+					return false;
+				}
+				break;
+			case 'r':
+				repeat_lines = true;
+				break;
+			case 'p':
+				flip = true;
+				break;
+			case 'f':
+				fields = atoi(optarg);
+				break;
+			case 'l':
+				hold_lines = atoi(optarg);
+				break;
+			case 'd':
+				delay_us = atof(optarg);
+				break;
+			case 'w':
+				wav_file = optarg;
+				break;
+			case 'i':
+				pgm_file = optarg;
+				break;
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				printf("Usage: %s [-n] [-D] [-x none|double|interp] [-r] [-p] [-f FIELDS] [-l LINES] [-d USEC] [-w WAVFILE] [-i PGMFILE] [-q]\n", argv[0]);
+				return false;
+		}
+	}
+	if (native && ((scale_x != VIDEO_SCALE_X_NONE) || repeat_lines)) {
+		printf("Scaling is only done for 8-bit frame buffers\n");
+		return false;
+	}
+	
+	return fields > 0;
+}
+
+
+/**
+ * White border around diagonal ramps so the first and last active samples are lit
+ */
+static void fill_pattern(uint8_t* fb, int w, int h)
+{
+	int x, y;
+	
+	for (y=0; y<h; y++) {
+		for (x=0; x<w; x++) {
+			if ((x == 0) || (y == 0) || (x == w-1) || (y == h-1)) {
+				fb[y*w + x] = 255;
+			} else {
+				fb[y*w + x] = (x * 7 + y * 3) & 0xFF;
+			}
+		}
+	}
+}
+
+
+/**
+ * Levels expected on screen for a frame buffer after scaling
+ */
+static void expected_image(const uint8_t* fb, int fb_w, uint8_t* img)
+{
+	const uint8_t* row;
+	int a, b;
+	int x, y;
+	
+	for (y=0; y<TEST_HEIGHT; y++) {
+		row = &fb[(repeat_lines ? y/2 : y) * fb_w];
+		for (x=0; x<TEST_WIDTH; x++) {
+			if (scale_x == VIDEO_SCALE_X_NONE) {
+				img[y*TEST_WIDTH + x] = VSIM_DAC_LEVEL(row[x]);
+			} else if ((scale_x == VIDEO_SCALE_X_DOUBLE) || ((x & 1) == 0)) {
+				img[y*TEST_WIDTH + x] = VSIM_DAC_LEVEL(row[x/2]);
+			} else {
+				// Interpolated pixel, the last one repeats its left neighbour
+				a = VSIM_DAC_LEVEL(row[x/2]);
+				b = ((x/2 + 1) < fb_w) ? VSIM_DAC_LEVEL(row[x/2 + 1]) : a;
+				img[y*TEST_WIDTH + x] = (a + b + 1) / 2;
+			}
+		}
+	}
+}
+
+
+static bool write_pgm(const char* path, const uint8_t* img, int w, int h)
+{
+	FILE* fp;
+	bool ok;
+	
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		return false;
+	}
+	
+	// Raw DAC levels, white is the maximum
+	fprintf(fp, "P5\n%d %d\n%d\n", w, h, VSIM_LEVEL_WHITE);
+	ok = fwrite(img, 1, w * h, fp) == (size_t) (w * h);
+	
+	return (fclose(fp) == 0) && ok;
+}
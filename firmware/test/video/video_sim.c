@@ -0,0 +1,294 @@
+/*
+ * Composite video DMA stand-in
+ *
+ * Replaces the I2S0 DMA for a host build of the composite video driver.  Follows the
+ * driver's lldesc_t chain from I2S0.out_link, captures the DAC samples of every
+ * descriptor in the order the I2S sends them and raises the I2S0 interrupt after each
+ * descriptor with the eof flag, at the simulated time it was sent.
+ *
+ * The DMA never waits for the CPU.  The CPU cycle counter is held at the DMA time and
+ * runs on host time while the interrupt handler does unless the test holds it with
+ * host_intr_use_host_time(false), then the simulation does not depend on host
+ * scheduling.  The handler cost is always measured with the host clock.  Lines the
+ * handler hasn't refilled in time are only sent stale when an interrupt is held back
+ * with video_sim_hold_interrupt() since the handler runs between two descriptors.  video_sim_delay_interrupt() lets the handler enter late while the DMA
+ * keeps sending.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "video_sim.h"
+#include "host_shims.h"
+#include "esp_intr_alloc.h"
+#include "esp32/rom/lldesc.h"
+#include "sdkconfig.h"
+#include "soc/i2s_struct.h"
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+
+
+
+//
+// Video Sim Variables
+//
+static uint32_t sim_dac_frequency;
+static uint64_t sim_base_cycles;         // CPU cycle count when sending started
+static uint64_t sim_samples;             // Samples sent since sending started
+static const lldesc_t* sim_desc;         // Next descriptor to send
+static const lldesc_t* sim_eof_desc;     // Last eof descriptor sent, interrupt pending
+static int sim_hold;                     // Descriptors to send before raising the interrupt
+static uint32_t sim_delay;               // Entry delay of the next interrupt (CPU cycles)
+static uint64_t sim_entry_cycles;        // DMA time the delayed interrupt enters, 0 for none
+static video_sim_stats_t sim_stats;
+
+
+
+//
+// Video Sim Forward Declarations for internal functions
+//
+static void sim_raise_interrupt(uint64_t entry_cycles);
+static uint64_t sim_cycles(uint64_t samples);
+static uint64_t sim_host_ns();
+static void write_le(FILE* fp, uint32_t v, int bytes);
+
+
+
+//
+// Video Sim API
+//
+
+/**
+ * Start sending from the descriptor in I2S0.out_link.  Call after the driver started
+ * the I2S (video_init()).  Holds the CPU cycle counter at the DMA time.
+ *   dac_frequency is the sample rate
+ */
+void video_sim_start(uint32_t dac_frequency)
+{
+	sim_dac_frequency = dac_frequency;
+	sim_desc = (const lldesc_t*) (uintptr_t) I2S0.out_link.addr;
+	sim_eof_desc = NULL;
+	sim_hold = 0;
+	sim_delay = 0;
+	sim_entry_cycles = 0;
+	sim_samples = 0;
+	memset(&sim_stats, 0, sizeof(sim_stats));
+	
+	host_cpu_run(false);
+	sim_base_cycles = host_cpu_cycles();
+}
+
+
+/**
+ * Send descriptors, capturing their samples (one DAC level per sample) and raising the
+ * interrupt after eof descriptors.
+ *   samples receives the samples (may be NULL)
+ *   max_samples is the size of samples, further samples are sent but not stored
+ * Returns the number of samples stored
+ */
+size_t video_sim_send(int descriptors, uint8_t* samples, size_t max_samples)
+{
+	size_t stored = 0;
+	int i, k, n;
+	
+	for (i=0; i<descriptors; i++) {
+		n = sim_desc->length / sizeof(uint16_t);
+		
+		if ((sim_entry_cycles != 0) && (sim_cycles(sim_samples + n) > sim_entry_cycles)) {
+			// A delayed handler enters while this descriptor is sent
+			sim_raise_interrupt(sim_entry_cycles);
+			sim_entry_cycles = 0;
+		}
+		
+		for (k=0; k<n; k++) {
+			if ((samples != NULL) && (stored < max_samples)) {
+				// The DAC uses the upper byte of each 16-bit sample and the upper half
+				// of each 32-bit word is sent first
+				samples[stored++] = sim_desc->buf[(k ^ 1) * sizeof(uint16_t) + 1];
+			}
+		}
+		sim_samples += n;
+		sim_stats.samples += n;
+		sim_stats.descriptors++;
+		
+		if (sim_desc->eof) {
+			sim_eof_desc = sim_desc;
+		}
+		sim_desc = (const lldesc_t*) (uintptr_t) sim_desc->empty;
+		
+		if (sim_hold > 0) {
+			sim_hold--;
+		} else if ((sim_eof_desc != NULL) && (sim_entry_cycles == 0)) {
+			if (sim_delay != 0) {
+				// The DMA goes on with the next descriptors until the handler enters
+				sim_entry_cycles = video_sim_cycles() + sim_delay;
+				sim_delay = 0;
+			} else {
+				sim_raise_interrupt(video_sim_cycles());
+			}
+		}
+	}
+	
+	return stored;
+}
+
+
+/**
+ * Hold back the interrupt for the next descriptors sent, as if interrupts were disabled.
+ * The hardware then interrupts once for the last eof descriptor sent.
+ */
+void video_sim_hold_interrupt(int descriptors)
+{
+	sim_hold = descriptors;
+}
+
+
+/**
+ * Let the next interrupt enter cycles late, as if the CPU were busy.  The DMA keeps
+ * sending meanwhile, eof descriptors sent before the handler enters are covered by the
+ * same interrupt.
+ */
+void video_sim_delay_interrupt(uint32_t cycles)
+{
+	sim_delay = cycles;
+}
+
+
+/**
+ * Return the DMA time in CPU cycles since video_sim_start()
+ */
+uint64_t video_sim_cycles()
+{
+	return sim_cycles(sim_samples);
+}
+
+
+/**
+ * Get the counts since video_sim_start() or the last reset
+ */
+void video_sim_get_stats(video_sim_stats_t* stats, bool reset)
+{
+	if (stats != NULL) {
+		*stats = sim_stats;
+	}
+	
+	if (reset) {
+		memset(&sim_stats, 0, sizeof(sim_stats));
+	}
+}
+
+
+/**
+ * Write samples as an 8-bit mono WAV file at the DAC frequency so a waveform can be
+ * looked at like on a scope with any audio editor
+ * Returns false if the file could not be written
+ */
+bool video_sim_write_wav(const char* path, const uint8_t* samples, size_t n, uint32_t dac_frequency)
+{
+	FILE* fp;
+	bool ok;
+	
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		return false;
+	}
+	
+	fwrite("RIFF", 1, 4, fp);
+	write_le(fp, 36 + n, 4);
+	fwrite("WAVEfmt ", 1, 8, fp);
+	write_le(fp, 16, 4);                 // Format chunk size
+	write_le(fp, 1, 2);                  // PCM
+	write_le(fp, 1, 2);                  // Mono
+	write_le(fp, dac_frequency, 4);
+	write_le(fp, dac_frequency, 4);      // Bytes per second
+	write_le(fp, 1, 2);                  // Block align
+	write_le(fp, 8, 2);                  // Bits per sample
+	fwrite("data", 1, 4, fp);
+	write_le(fp, n, 4);
+	ok = fwrite(samples, 1, n, fp) == n;
+	
+	return (fclose(fp) == 0) && ok;
+}
+
+
+
+//
+// Video Sim internal functions
+//
+
+/**
+ * Raise the I2S0 out_eof interrupt for the last eof descriptor sent
+ *   entry_cycles is the DMA time the CPU takes the interrupt
+ */
+static void sim_raise_interrupt(uint64_t entry_cycles)
+{
+	uint64_t t;
+	uint32_t cycles;
+	
+	I2S0.out_eof_des_addr = (uint32_t) (uintptr_t) sim_eof_desc;
+	I2S0.int_raw.out_eof = 1;
+	I2S0.int_st.out_eof = 1;
+	sim_eof_desc = NULL;
+	
+	// The CPU is interrupted when the DMA finished the descriptor, or later if it is
+	// still busy with the previous interrupt
+	host_cpu_advance_to(sim_base_cycles + entry_cycles);
+	t = sim_host_ns();
+	if (host_intr_raise(ETS_I2S0_INTR_SOURCE)) {
+		cycles = (uint32_t) ((sim_host_ns() - t) * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ / 1000);
+		sim_stats.interrupts++;
+		sim_stats.isr_cycles += cycles;
+		if (cycles > sim_stats.isr_max_cycles) {
+			sim_stats.isr_max_cycles = cycles;
+		}
+	}
+	
+	// The driver clears what it handled, the stand-in has no write side effects
+	I2S0.int_raw.val = 0;
+	I2S0.int_st.val = 0;
+}
+
+
+/**
+ * Return the CPU cycles it takes to send samples
+ */
+static uint64_t sim_cycles(uint64_t samples)
+{
+	return samples * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ * 1000000ULL / sim_dac_frequency;
+}
+
+
+/**
+ * Return the host monotonic time in nSec
+ */
+static uint64_t sim_host_ns()
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static void write_le(FILE* fp, uint32_t v, int bytes)
+{
+	while (bytes--) {
+		fputc(v & 0xFF, fp);
+		v >>= 8;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ * Composite video DMA stand-in
+ *
+ * Replaces the I2S0 DMA for a host build of the composite video driver.  Follows the
+ * driver's lldesc_t chain from I2S0.out_link, captures the DAC samples of every
+ * descriptor in the order the I2S sends them and raises the I2S0 interrupt after each
+ * descriptor with the eof flag, at the simulated time it was sent.
+ *
+ * Copyright 2023 Dan Julio
+ *
+ * This file is part of tCamMiniAnalog.
+ *
+ * tCamMiniAnalog is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tCamMiniAnalog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef VIDEO_SIM_H
+#define VIDEO_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+
+//
+// Video Sim Constants
+//
+
+// DAC levels of the driver (see video.c), follow the configuration of the test including
+// this file
+#if CONFIG_VIDEO_USE_FS_DC
+#define VSIM_LEVEL_SYNC   0
+#define VSIM_LEVEL_BLACK  56
+#define VSIM_LEVEL_WHITE  182
+#else
+#define VSIM_LEVEL_SYNC   0
+#define VSIM_LEVEL_BLACK  23
+#define VSIM_LEVEL_WHITE  77
+#endif
+
+// DAC level the driver sends for a grey value (0 black to 255 white) without scaling or
+// dithering.  A macro so it follows the configuration of the test including it.
+#define VSIM_DAC_LEVEL(v) (VSIM_LEVEL_BLACK + ((v) * (((VSIM_LEVEL_WHITE - VSIM_LEVEL_BLACK) * 1000) / 255)) / 1000)
+
+
+
+//
+// Video Sim Typedefs
+//
+typedef struct {
+	uint64_t samples;            // Samples sent
+	uint32_t descriptors;        // Descriptors sent
+	uint32_t interrupts;         // Interrupt handler calls
+	uint64_t isr_cycles;         // CPU cycles in the interrupt handler (host clock)
+	uint32_t isr_max_cycles;
+} video_sim_stats_t;
+
+
+
+//
+// Video Sim API
+//
+void video_sim_start(uint32_t dac_frequency);
+size_t video_sim_send(int descriptors, uint8_t* samples, size_t max_samples);
+void video_sim_hold_interrupt(int descriptors);
+void video_sim_delay_interrupt(uint32_t cycles);
+uint64_t video_sim_cycles();
+void video_sim_get_stats(video_sim_stats_t* stats, bool reset);
+bool video_sim_write_wav(const char* path, const uint8_t* samples, size_t n, uint32_t dac_frequency);
+
+#endif /* VIDEO_SIM_H */
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+#
+# Summarize tCamMiniAnalog frame latency from a serial log
+#
+# Reads the monitor output of firmware built with INCLUDE_SYS_MON and MON_LATENCY
+# (e.g. captured with "idf.py monitor | tee latency.log"), adds up the per-stage
+# latency histograms mon_task logs every sample period and prints the percentiles
+# and a histogram of each stage.
+#
+# Usage: latency_report.py [-s STAGE] [-w WIDTH] [LOGFILE ...]
+#   With no LOGFILE the log is read from stdin.
+#
+# Copyright 2023 Dan Julio
+#
+# This file is part of tCamMiniAnalog.
+#
+# tCamMiniAnalog is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# tCamMiniAnalog is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with tCam.  If not, see <https://www.gnu.org/licenses/>.
+#
+import argparse
+import fileinput
+import re
+import sys
+
+# Stages in the order mon_task logs them
+STAGES = ["acquire", "handoff", "queue", "render", "scanout", "total"]
+
+ANSI_RE = re.compile(r"\x1b\[[0-9;]*m")
+HIST_RE = re.compile(r"Latency (\w+) hist \((\d+) x (\d+) uS\):(.*)$")
+COUNT_RE = re.compile(r"Frame latency: (\d+) frames - Late: (\d+) / Not shown: (\d+) / Dropped: (\d+)")
+BUCKET_RE = re.compile(r"(\d+):(\d+)$")
+MAX_RE = re.compile(r"Latency (\w+): p50 \d+ / p90 \d+ / p99 \d+ / max (\d+) uS")
+
+
+def percentile(hist, bucket_usec, per_mille):
+    """Upper edge (uS) of the bucket holding the percentile, as the firmware computes it"""
+    total = sum(hist.values())
+    if total == 0:
+        return 0
+    rank = (total * per_mille + 999) // 1000
+    count = 0
+    for b in sorted(hist):
+        count += hist[b]
+        if count >= rank:
+            return (b + 1) * bucket_usec
+    return (max(hist) + 1) * bucket_usec
+
+
+def print_stage(name, hist, num_buckets, bucket_usec, max_usec, width):
+    total = sum(hist.values())
+    print("%s: %d frames" % (name, total))
+    if total == 0:
+        print()
+        return
+    print("  p50 %.1f / p90 %.1f / p99 %.1f / max %.1f mS" %
+          (percentile(hist, bucket_usec, 500) / 1000.0,
+           percentile(hist, bucket_usec, 900) / 1000.0,
+           percentile(hist, bucket_usec, 990) / 1000.0,
+           max_usec / 1000.0))
+    peak = max(hist.values())
+    b = min(hist)
+    while b <= max(hist):
+        n = hist.get(b, 0)
+        if n == 0 and hist.get(b + 1, 0) == 0:
+            # Collapse runs of empty buckets
+            e = b
+            while hist.get(e + 1, 0) == 0:
+                e += 1
+            print("  %6.1f - %6.1f mS %7d" % (b * bucket_usec / 1000.0, (e + 1) * bucket_usec / 1000.0, 0))
+            b = e + 1
+            continue
+        bar = "#" * ((n * width + peak - 1) // peak)
+        if b == num_buckets - 1:
+            # The last bucket also holds everything above it
+            print("  %6.1f +        mS %7d %s" % (b * bucket_usec / 1000.0, n, bar))
+        else:
+            print("  %6.1f - %6.1f mS %7d %s" %
+                  (b * bucket_usec / 1000.0, (b + 1) * bucket_usec / 1000.0, n, bar))
+        b += 1
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Summarize frame latency histograms from a tCamMiniAnalog log")
+    parser.add_argument("-s", "--stage", choices=STAGES, help="only report one stage")
+    parser.add_argument("-w", "--width", type=int, default=50, help="histogram bar width (default 50)")
+    parser.add_argument("logs", nargs="*", help="log files (default stdin)")
+    args = parser.parse_args()
+
+    hists = {s: {} for s in STAGES}
+    max_usec = {s: 0 for s in STAGES}
+    num_buckets = None
+    bucket_usec = None
+    periods = 0
+    frames = late = not_shown = dropped = 0
+
+    for line in fileinput.input(args.logs, errors="replace"):
+        line = ANSI_RE.sub("", line.rstrip())
+
+        m = HIST_RE.search(line)
+        if m:
+            stage = m.group(1)
+            if stage not in hists:
+                continue
+            if bucket_usec is None:
+                num_buckets = int(m.group(2))
+                bucket_usec = int(m.group(3))
+            elif (num_buckets, bucket_usec) != (int(m.group(2)), int(m.group(3))):
+                sys.exit("Histogram buckets changed in the log (%s x %s uS, was %d x %d uS)" %
+                         (m.group(2), m.group(3), num_buckets, bucket_usec))
+            for item in m.group(4).split():
+                bn = BUCKET_RE.match(item)
+                if bn:
+                    b, n = int(bn.group(1)), int(bn.group(2))
+                    hists[stage][b] = hists[stage].get(b, 0) + n
+            continue
+
+        m = MAX_RE.search(line)
+        if m and m.group(1) in max_usec:
+            max_usec[m.group(1)] = max(max_usec[m.group(1)], int(m.group(2)))
+            continue
+
+        m = COUNT_RE.search(line)
+        if m:
+            periods += 1
+            frames += int(m.group(1))
+            late += int(m.group(2))
+            not_shown += int(m.group(3))
+            dropped += int(m.group(4))
+
+    if periods == 0:
+        sys.exit("No frame latency output found (build with INCLUDE_SYS_MON and MON_LATENCY)")
+
+    print("%d sample periods: %d frames shown - Late: %d / Not shown: %d / Dropped: %d" %
+          (periods, frames, late, not_shown, dropped))
+    print()
+    for s in STAGES:
+        if args.stage is None or args.stage == s:
+            print_stage(s, hists[s], num_buckets or 0, bucket_usec or 1000, max_usec[s], args.width)
+
+
+if __name__ == "__main__":
+    main()